@@ -0,0 +1,204 @@
+/*
+ * Copyright 2015-2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * benchmark_exec_tx.cpp -- measures the per-transaction overhead of
+ * transaction::exec_tx when the closure is passed directly and when it is
+ * wrapped in an std::function, as callers had to do before exec_tx
+ * was templated on the callable
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <new>
+#include <sys/stat.h>
+
+#define LAYOUT "benchmark_exec_tx"
+
+namespace
+{
+
+using namespace pmem::obj;
+
+struct root {
+	p<uint64_t> counter;
+};
+
+/* number of heap allocations, counted by the replaced operator new */
+std::atomic<uint64_t> allocations;
+
+/* keeps the closure from being optimized away */
+volatile uint64_t sink;
+
+struct result {
+	double ns_per_tx;
+	double allocs_per_tx;
+};
+
+/*
+ * run -- (internal) runs iterations transactions with a closure which
+ * captures more state than fits in the small buffer of std::function,
+ * passing it to exec_tx through wrap
+ */
+template <typename Wrap>
+result
+run(pool<root> &pop, uint64_t iterations, Wrap wrap)
+{
+	auto r = pop.get_root();
+	uint64_t a = 0, b = 0, c = 0, d = 0;
+
+	uint64_t allocs = allocations.load();
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint64_t i = 0; i < iterations; ++i) {
+		auto tx = [&r, &a, &b, &c, &d, i] {
+			r->counter = r->counter + 1;
+			a += i;
+			b ^= i;
+			c += a;
+			d += b;
+		};
+
+		transaction::exec_tx(pop, wrap(tx));
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	allocs = allocations.load() - allocs;
+
+	sink = a + b + c + d;
+
+	std::chrono::duration<double, std::nano> elapsed = end - start;
+
+	return {elapsed.count() / static_cast<double>(iterations),
+		static_cast<double>(allocs) / static_cast<double>(iterations)};
+}
+
+/*
+ * direct -- (internal) passes the closure to exec_tx as it is
+ */
+struct direct {
+	template <typename F>
+	F &
+	operator()(F &f) const
+	{
+		return f;
+	}
+};
+
+/*
+ * wrapped -- (internal) wraps the closure in an std::function, which
+ * allocates the captured state on the heap
+ */
+struct wrapped {
+	template <typename F>
+	std::function<void()>
+	operator()(F &f) const
+	{
+		return std::function<void()>(f);
+	}
+};
+
+void
+print(const char *name, const result &res)
+{
+	std::printf("%-16s %10.1f ns/tx %6.2f allocs/tx\n", name,
+		    res.ns_per_tx, res.allocs_per_tx);
+}
+}
+
+void *
+operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+
+	void *ptr = std::malloc(size ? size : 1);
+	if (ptr == nullptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void
+operator delete(void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s file-name [iterations]\n",
+			     argv[0]);
+		return 1;
+	}
+
+	const char *path = argv[1];
+	uint64_t iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+				       : 1000000;
+	if (iterations == 0)
+		iterations = 1;
+
+	pool<root> pop;
+
+	try {
+		pop = pool<root>::create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+					 S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		std::fprintf(stderr, "pool::create: %s\n", pe.what());
+		return 1;
+	}
+
+	/* warm up */
+	run(pop, iterations / 10 + 1, direct());
+
+	print("callable", run(pop, iterations, direct()));
+	print("std::function", run(pop, iterations, wrapped()));
+
+	pop.close();
+
+	return 0;
+}
@@ -300,6 +300,8 @@ point::point(position cor)
 void
 point::move_home()
 {
+	transaction::snapshot(x, y, prev_x, prev_y);
+
 	prev_x = x;
 	prev_y = y;
 
@@ -362,6 +364,8 @@ point::move()
 		default:
 			break;
 	}
+	transaction::snapshot(x, y, prev_x, prev_y);
+
 	prev_x = x;
 	prev_y = y;
 	x = x + tmp_x;
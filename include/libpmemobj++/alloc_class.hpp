@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Allocation classes of persistent objects.
+ */
+
+#ifndef LIBPMEMOBJ_ALLOC_CLASS_HPP
+#define LIBPMEMOBJ_ALLOC_CLASS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "libpmemobj/ctl.h"
+#include "libpmemobj/tx_base.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+/**
+ * Allocation class from which the objects of type T are allocated.
+ *
+ * By default objects are allocated from the default allocation classes
+ * of the pool, whose unit sizes do not fit all types and waste space on
+ * objects which fall just above a class size. A type allocated in large
+ * numbers, e.g. the node of a tree, can be given its own class by
+ * specializing this trait with an id of a custom class, which has to be
+ * registered with pool_base::register_alloc_class<T>() in every pool
+ * after it is created or opened:
+ *
+ * @code
+ * namespace pmem { namespace obj {
+ * template <>
+ * struct alloc_class_traits<node> {
+ *	static constexpr unsigned id = 200;
+ * };
+ * } }
+ *
+ * pop.register_alloc_class<node>();
+ * @endcode
+ *
+ * make_persistent, make_persistent_atomic and pmem::obj::allocator
+ * allocating a single object then use the class. Allocating T from
+ * a pool in which the class is not registered fails. Arrays of T are
+ * allocated from the default classes.
+ *
+ * The id has to be unique among the classes registered in the pool and
+ * lower than 255; the default classes use the lowest ids, so ids from 128
+ * up are recommended.
+ */
+template <typename T>
+struct alloc_class_traits {
+	/** The id of the allocation class of T, 0 for the default ones. */
+	static constexpr unsigned id = 0;
+};
+
+template <typename T>
+constexpr unsigned alloc_class_traits<T>::id;
+
+} /* namespace obj */
+
+namespace detail
+{
+
+/*
+ * Return the allocation flags selecting the allocation class of T.
+ */
+template <typename T>
+constexpr uint64_t
+alloc_class_flags()
+{
+	return pmem::obj::alloc_class_traits<T>::id == 0
+		? 0
+		: POBJ_CLASS_ID(pmem::obj::alloc_class_traits<T>::id);
+}
+
+/*
+ * Return the allocation flags of T combined with the given ones, a class
+ * given in flags taking precedence over the class of T.
+ */
+template <typename T>
+constexpr uint64_t
+alloc_class_flags(uint64_t flags)
+{
+	return (flags & POBJ_XALLOC_CLASS_MASK)
+		? flags
+		: flags | alloc_class_flags<T>();
+}
+
+/*
+ * Return the size of the object header of the given type.
+ */
+constexpr std::size_t
+alloc_header_size(pobj_header_type header_type)
+{
+	return header_type == POBJ_HEADER_LEGACY
+		? 64
+		: header_type == POBJ_HEADER_COMPACT ? 16 : 0;
+}
+
+} /* namespace detail */
+
+} /* namespace pmem */
+
+#endif /* LIBPMEMOBJ_ALLOC_CLASS_HPP */
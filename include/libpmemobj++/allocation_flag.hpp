@@ -0,0 +1,160 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Flags modifying persistent memory allocations.
+ */
+
+#ifndef LIBPMEMOBJ_ALLOCATION_FLAG_HPP
+#define LIBPMEMOBJ_ALLOCATION_FLAG_HPP
+
+#include <cstdint>
+
+#include "libpmemobj/tx_base.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+/**
+ * Flags passed to make_persistent and make_persistent_atomic, selecting
+ * where and how the object is allocated.
+ *
+ * Flags can be combined with operator|. A class id given with class_id()
+ * takes precedence over the class of alloc_class_traits.
+ */
+struct allocation_flag {
+	/**
+	 * Wraps libpmemobj allocation flags, e.g. POBJ_CLASS_ID.
+	 */
+	explicit constexpr allocation_flag(uint64_t val)
+	    : value(val), skip_zero(false)
+	{
+	}
+
+	/**
+	 * No flags, the object is allocated as without them.
+	 */
+	static constexpr allocation_flag
+	none()
+	{
+		return allocation_flag(0);
+	}
+
+	/**
+	 * Allocate the object from the allocation class with the given id,
+	 * see pool_base::register_alloc_class().
+	 */
+	static constexpr allocation_flag
+	class_id(unsigned id)
+	{
+		return allocation_flag(POBJ_CLASS_ID(id));
+	}
+
+	/**
+	 * Zero the allocated memory before the object is constructed.
+	 */
+	static constexpr allocation_flag
+	zero()
+	{
+		return allocation_flag(POBJ_XALLOC_ZERO);
+	}
+
+	/**
+	 * Leave arrays of trivially default constructible objects
+	 * uninitialized instead of zeroing them, the fastest way to
+	 * allocate large buffers which are going to be overwritten anyway.
+	 * Has no effect on other allocations.
+	 */
+	static constexpr allocation_flag
+	no_zero()
+	{
+		return allocation_flag(0, true);
+	}
+
+	/**
+	 * Do not flush the allocated memory when the transaction commits,
+	 * e.g. for scratch buffers whose contents need not survive
+	 * a crash. Valid only for transactional allocations. Writes into
+	 * the memory through p<> or persistent containers are still added
+	 * to their transactions, as for memory allocated earlier, so they
+	 * are flushed on commit.
+	 */
+	static constexpr allocation_flag
+	no_flush()
+	{
+		return allocation_flag(POBJ_XALLOC_NO_FLUSH);
+	}
+
+#ifdef POBJ_ARENA_ID
+	/**
+	 * Allocate the object from the arena with the given id, instead of
+	 * the arena of the calling thread, see pool_base::create_arena().
+	 */
+	static constexpr allocation_flag
+	arena_id(unsigned id)
+	{
+		return allocation_flag(POBJ_ARENA_ID(id));
+	}
+#endif
+
+	/**
+	 * Combines two sets of flags.
+	 */
+	constexpr allocation_flag
+	operator|(const allocation_flag &rhs) const
+	{
+		return allocation_flag(value | rhs.value,
+				       skip_zero || rhs.skip_zero);
+	}
+
+	/** The libpmemobj allocation flags. */
+	uint64_t value;
+
+	/** Whether no_zero() was given. */
+	bool skip_zero;
+
+private:
+	constexpr allocation_flag(uint64_t val, bool skip)
+	    : value(val), skip_zero(skip)
+	{
+	}
+};
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* LIBPMEMOBJ_ALLOCATION_FLAG_HPP */
@@ -256,9 +256,16 @@ public:
 				"refusing to allocate "
 				"memory outside of transaction scope");
 
+		/* single objects come from the allocation class of T */
+		uint64_t flags = cnt == 1 ? detail::alloc_class_flags<T>() : 0;
+
 		/* allocate raw memory, no object construction */
-		return pmemobj_tx_alloc(sizeof(value_type) * cnt,
-					detail::type_num<T>());
+		pointer p = pmemobj_tx_xalloc(sizeof(value_type) * cnt,
+					      detail::type_num<T>(), flags);
+		if (p != nullptr)
+			detail::tx_allocated(p.get(), sizeof(value_type) * cnt);
+
+		return p;
 	}
 
 	/**
@@ -276,6 +283,8 @@ public:
 				"refusing to free "
 				"memory outside of transaction scope");
 
+		detail::tx_freeing(*p.raw_ptr());
+
 		if (pmemobj_tx_free(*p.raw_ptr()) != 0)
 			throw transaction_free_error(
 				"failed to delete "
@@ -360,7 +369,11 @@ public:
 				"memory outside of transaction scope");
 
 		/* allocate raw memory, no object construction */
-		return pmemobj_tx_alloc(1 /* void size */ * cnt, 0);
+		pointer p = pmemobj_tx_alloc(1 /* void size */ * cnt, 0);
+		if (p != nullptr)
+			detail::tx_allocated(p.get(), cnt);
+
+		return p;
 	}
 
 	/**
@@ -378,6 +391,8 @@ public:
 				"refusing to free "
 				"memory outside of transaction scope");
 
+		detail::tx_freeing(p.raw());
+
 		if (pmemobj_tx_free(p.raw()) != 0)
 			throw transaction_free_error(
 				"failed to delete "
@@ -472,6 +487,14 @@ public:
 	{
 	}
 
+	/**
+	 * Constructs the allocator with the given allocation policy, e.g.
+	 * one referring to persistent allocator state.
+	 */
+	explicit allocator(Policy const &policy) : Policy(policy)
+	{
+	}
+
 	/**
 	 * Type converting constructor.
 	 */
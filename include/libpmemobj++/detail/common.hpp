@@ -38,9 +38,15 @@
 #ifndef PMEMOBJ_COMMON_HPP
 #define PMEMOBJ_COMMON_HPP
 
+#include "libpmemobj++/alloc_class.hpp"
 #include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/detail/snapshot_cache.hpp"
+#include "libpmemobj++/detail/tx_stats.hpp"
+#include "libpmemobj++/type_num.hpp"
 #include "libpmemobj/tx_base.h"
-#include <typeinfo>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 
 namespace pmem
 {
@@ -59,7 +65,8 @@ namespace detail
  *
  * Adds count objects starting from `that` to the transaction if '*that' is
  * within a pmemobj pool and there is an active transaction.
- * Does nothing otherwise.
+ * Does nothing otherwise. Ranges already added to the transaction are
+ * skipped without calling into the library, see snapshot_cache.
  *
  * @param[in] that pointer to the first object being added to the transaction.
  * @param[in] count number of elements to be added to the transaction.
@@ -71,6 +78,14 @@ conditional_add_to_tx(const T *that, std::size_t count = 1)
 	if (count == 0)
 		return;
 
+	auto &cache = snapshot_cache::get();
+	std::size_t size = sizeof(*that) * count;
+
+	if (cache.contains(that, size)) {
+		tx_stats_add(tx_counter_snapshot_hits);
+		return;
+	}
+
 	if (pmemobj_tx_stage() != TX_STAGE_WORK)
 		return;
 
@@ -78,19 +93,146 @@ conditional_add_to_tx(const T *that, std::size_t count = 1)
 	if (!pmemobj_pool_by_ptr(that))
 		return;
 
-	if (pmemobj_tx_add_range_direct(that, sizeof(*that) * count))
+	if (pmemobj_tx_add_range_direct(that, size))
 		throw transaction_error("Could not add object(s) to the"
 					" transaction.");
+
+	tx_stats_add(tx_counter_snapshots);
+	tx_stats_add(tx_counter_snapshot_bytes, size);
+
+	cache.insert(that, size);
+}
+
+/*
+ * A range of memory to be added to a transaction.
+ */
+struct tx_range {
+	std::uintptr_t begin;
+	std::uintptr_t end;
+};
+
+/*
+ * Return the range of memory occupied by an object.
+ */
+template <typename T>
+inline tx_range
+make_tx_range(const T &obj) noexcept
+{
+	auto begin = reinterpret_cast<std::uintptr_t>(std::addressof(obj));
+
+	return tx_range{begin, begin + sizeof(T)};
+}
+
+/*
+ * Add the ranges [first, last) to the active transaction.
+ *
+ * The ranges are sorted and the adjacent or overlapping ones are merged,
+ * so that the undo log gets as few entries as possible. Merged ranges
+ * already added to the transaction are skipped. The ranges have to be
+ * within the pool of the transaction. Does nothing outside of
+ * a transaction. The array is reordered.
+ *
+ * @param[in,out] first the first range.
+ * @param[in,out] last the end of the ranges.
+ */
+inline void
+add_ranges_to_tx(tx_range *first, tx_range *last)
+{
+	if (first == last || pmemobj_tx_stage() != TX_STAGE_WORK)
+		return;
+
+	std::sort(first, last, [](const tx_range &a, const tx_range &b) {
+		return a.begin < b.begin;
+	});
+
+	auto &cache = snapshot_cache::get();
+	auto add = [&](const tx_range &r) {
+		auto ptr = reinterpret_cast<const void *>(r.begin);
+		std::size_t size = r.end - r.begin;
+
+		if (cache.contains(ptr, size)) {
+			tx_stats_add(tx_counter_snapshot_hits);
+			return;
+		}
+
+		if (pmemobj_tx_add_range_direct(ptr, size))
+			throw transaction_error("Could not add object(s) to"
+						" the transaction.");
+
+		tx_stats_add(tx_counter_snapshots);
+		tx_stats_add(tx_counter_snapshot_bytes, size);
+
+		cache.insert(ptr, size);
+	};
+
+	tx_range cur = *first;
+	for (++first; first != last; ++first) {
+		if (first->begin <= cur.end) {
+			cur.end = (std::max)(cur.end, first->end);
+		} else {
+			add(cur);
+			cur = *first;
+		}
+	}
+
+	add(cur);
+}
+
+/*
+ * Record memory allocated in the active transaction, so that writes into
+ * it are not snapshotted.
+ *
+ * @param[in] ptr pointer to the allocated memory.
+ * @param[in] size size of the allocation.
+ */
+inline void
+tx_allocated(const void *ptr, std::size_t size) noexcept
+{
+	snapshot_cache::get().insert(ptr, size);
+}
+
+/*
+ * Record memory allocated in the active transaction with the given
+ * libpmemobj flags. Memory allocated with POBJ_XALLOC_NO_FLUSH is not
+ * recorded: libpmemobj does not flush it on commit, so writes into it
+ * have to be added to the transaction like writes anywhere else.
+ *
+ * @param[in] ptr pointer to the allocated memory.
+ * @param[in] size size of the allocation.
+ * @param[in] flags the flags of the allocation.
+ */
+inline void
+tx_allocated(const void *ptr, std::size_t size, uint64_t flags) noexcept
+{
+	if ((flags & POBJ_XALLOC_NO_FLUSH) == 0)
+		tx_allocated(ptr, size);
+}
+
+/*
+ * Forget an allocation which is about to be freed in the active
+ * transaction, as the memory may be reused by an allocation which has to
+ * be snapshotted.
+ *
+ * @param[in] oid the object being freed.
+ */
+inline void
+tx_freeing(PMEMoid oid) noexcept
+{
+	auto &cache = snapshot_cache::get();
+	if (!cache.is_active())
+		return;
+
+	cache.erase(pmemobj_direct(oid), pmemobj_alloc_usable_size(oid));
 }
 
 /*
- * Return type number for given type.
+ * Return type number for given type, see pmem::obj::type_num_traits.
  */
 template <typename T>
-uint64_t
+constexpr uint64_t
 type_num()
 {
-	return typeid(T).hash_code();
+	return pmem::obj::type_num_traits<T>::value;
 }
 
 } /* namespace detail */
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Type-erased callable kept in fixed-size inline storage.
+ */
+
+#ifndef PMEMOBJ_INLINE_CALLBACK_HPP
+#define PMEMOBJ_INLINE_CALLBACK_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace pmem
+{
+
+namespace detail
+{
+
+/*
+ * Callable taking no arguments, stored inside the object rather than on
+ * the heap. Unlike std::function, which allocates once the captures do
+ * not fit its small internal buffer, it rejects at compile time the
+ * callables which are larger than Size bytes.
+ */
+template <std::size_t Size>
+class inline_callback {
+public:
+	template <typename F,
+		  typename Fn = typename std::decay<F>::type,
+		  typename = typename std::enable_if<
+			  !std::is_same<Fn, inline_callback>::value>::type>
+	inline_callback(F &&f) : ops(&ops_for<Fn>::table)
+	{
+		static_assert(sizeof(Fn) <= Size,
+			      "callable too large to be stored inline");
+		static_assert(alignof(Fn) <= alignof(storage_type),
+			      "callable alignment not supported");
+		static_assert(std::is_nothrow_move_constructible<Fn>::value,
+			      "callable must be nothrow move constructible");
+
+		new (&storage) Fn(std::forward<F>(f));
+	}
+
+	inline_callback(inline_callback &&other) noexcept : ops(other.ops)
+	{
+		ops->move(&storage, &other.storage);
+	}
+
+	inline_callback(const inline_callback &) = delete;
+	inline_callback &operator=(const inline_callback &) = delete;
+	inline_callback &operator=(inline_callback &&) = delete;
+
+	~inline_callback()
+	{
+		ops->destroy(&storage);
+	}
+
+	void
+	operator()()
+	{
+		ops->call(&storage);
+	}
+
+private:
+	using storage_type = typename std::aligned_storage<Size>::type;
+
+	struct operations {
+		void (*call)(void *);
+		void (*move)(void *, void *);
+		void (*destroy)(void *);
+	};
+
+	template <typename Fn>
+	struct ops_for {
+		static void
+		call(void *f)
+		{
+			(*static_cast<Fn *>(f))();
+		}
+
+		static void
+		move(void *dest, void *src)
+		{
+			new (dest) Fn(std::move(*static_cast<Fn *>(src)));
+		}
+
+		static void
+		destroy(void *f)
+		{
+			static_cast<Fn *>(f)->~Fn();
+		}
+
+		static constexpr operations table = {call, move, destroy};
+	};
+
+	const operations *ops;
+	storage_type storage;
+};
+
+template <std::size_t Size>
+template <typename Fn>
+constexpr typename inline_callback<Size>::operations
+	inline_callback<Size>::ops_for<Fn>::table;
+
+} /* namespace detail */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_INLINE_CALLBACK_HPP */
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Vector with inline storage for a few elements.
+ */
+
+#ifndef PMEMOBJ_SMALL_VECTOR_HPP
+#define PMEMOBJ_SMALL_VECTOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pmem
+{
+
+namespace detail
+{
+
+/*
+ * Volatile vector which keeps its first N elements inline and only
+ * allocates memory for the ones which follow.
+ */
+template <typename T, std::size_t N>
+class small_vector {
+public:
+	small_vector() noexcept : count(0)
+	{
+	}
+
+	small_vector(small_vector &&other) : count(0)
+	{
+		for (std::size_t i = 0; i < other.count; ++i)
+			new (&storage[i]) T(std::move(other.inline_at(i)));
+		count = other.count;
+		overflow = std::move(other.overflow);
+
+		other.clear();
+	}
+
+	small_vector(const small_vector &) = delete;
+	small_vector &operator=(const small_vector &) = delete;
+
+	~small_vector()
+	{
+		clear();
+	}
+
+	void
+	push_back(T &&value)
+	{
+		if (count < N) {
+			new (&storage[count]) T(std::move(value));
+			++count;
+		} else {
+			overflow.push_back(std::move(value));
+		}
+	}
+
+	T &operator[](std::size_t i) noexcept
+	{
+		return i < N ? inline_at(i) : overflow[i - N];
+	}
+
+	std::size_t
+	size() const noexcept
+	{
+		return count + overflow.size();
+	}
+
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	void
+	clear() noexcept
+	{
+		for (std::size_t i = 0; i < count; ++i)
+			inline_at(i).~T();
+		count = 0;
+		overflow.clear();
+	}
+
+private:
+	T &
+	inline_at(std::size_t i) noexcept
+	{
+		return *reinterpret_cast<T *>(&storage[i]);
+	}
+
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[N];
+	std::size_t count;
+	std::vector<T> overflow;
+};
+
+} /* namespace detail */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_SMALL_VECTOR_HPP */
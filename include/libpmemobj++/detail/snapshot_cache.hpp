@@ -0,0 +1,261 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Per-thread cache of the ranges snapshotted in the current transaction.
+ */
+
+#ifndef PMEMOBJ_SNAPSHOT_CACHE_HPP
+#define PMEMOBJ_SNAPSHOT_CACHE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "libpmemobj/tx_base.h"
+
+namespace pmem
+{
+
+namespace detail
+{
+
+/*
+ * Set of the memory ranges already added to the active transaction of the
+ * calling thread, kept as sorted, disjoint and non-adjacent intervals.
+ *
+ * It lets conditional_add_to_tx skip all library calls for ranges that
+ * are already snapshotted, e.g. when a loop writes the same field many
+ * times. Memory allocated in the transaction is recorded as well, as it
+ * needs no snapshot: the allocation is undone on abort and the object is
+ * flushed on commit. The cache is only active in transactions started by
+ * pmem::obj::transaction, which clear it when the outermost transaction
+ * begins and ends. Transactions started directly with the C API are never
+ * cached, as there is no way to tell when they end.
+ */
+class snapshot_cache {
+public:
+	/*
+	 * Returns the cache of the calling thread.
+	 */
+	static snapshot_cache &
+	get() noexcept
+	{
+		static thread_local snapshot_cache cache;
+
+		return cache;
+	}
+
+	/*
+	 * Called after a transaction began. outermost tells whether there
+	 * was no transaction before.
+	 */
+	void
+	tx_begin(bool outermost) noexcept
+	{
+		if (!outermost)
+			return;
+
+		ranges.clear();
+		hint = 0;
+		active = true;
+	}
+
+	/*
+	 * Called after a transaction ended. Clears the cache if it was the
+	 * outermost one.
+	 */
+	void
+	tx_end() noexcept
+	{
+		if (!active || pmemobj_tx_stage() != TX_STAGE_NONE)
+			return;
+
+		ranges.clear();
+		hint = 0;
+		active = false;
+	}
+
+	/*
+	 * Checks whether the whole range was already snapshotted.
+	 */
+	bool
+	contains(const void *ptr, std::size_t size) const noexcept
+	{
+		if (!active || ranges.empty())
+			return false;
+
+		auto b = reinterpret_cast<uintptr_t>(ptr);
+		auto e = b + size;
+
+		/* repeated writes usually hit the last range used */
+		if (hint < ranges.size() && ranges[hint].covers(b, e))
+			return true;
+
+		auto it = std::upper_bound(ranges.begin(), ranges.end(), b,
+					   [](uintptr_t v, const range &r) {
+						   return v < r.begin;
+					   });
+		if (it == ranges.begin())
+			return false;
+		--it;
+
+		if (!it->covers(b, e))
+			return false;
+
+		hint = static_cast<std::size_t>(it - ranges.begin());
+
+		return true;
+	}
+
+	/*
+	 * Records a snapshotted range, merging it with the ranges it
+	 * overlaps or touches. The range is not recorded if memory cannot be
+	 * allocated, it is then just snapshotted again.
+	 */
+	void
+	insert(const void *ptr, std::size_t size) noexcept
+	{
+		if (!active)
+			return;
+
+		auto b = reinterpret_cast<uintptr_t>(ptr);
+		auto e = b + size;
+
+		/* first range which ends at or after b */
+		auto first = std::lower_bound(
+			ranges.begin(), ranges.end(), b,
+			[](const range &r, uintptr_t v) { return r.end < v; });
+
+		auto last = first;
+		while (last != ranges.end() && last->begin <= e) {
+			b = (std::min)(b, last->begin);
+			e = (std::max)(e, last->end);
+			++last;
+		}
+
+		if (first == last) {
+			try {
+				first = ranges.insert(first, range{b, e});
+			} catch (std::bad_alloc &) {
+				return;
+			}
+		} else {
+			*first = range{b, e};
+			first = ranges.erase(first + 1, last) - 1;
+		}
+
+		hint = static_cast<std::size_t>(first - ranges.begin());
+	}
+
+	/*
+	 * Forgets the range, e.g. when the memory is freed. Parts of the
+	 * recorded ranges outside of it are kept if memory allows.
+	 */
+	void
+	erase(const void *ptr, std::size_t size) noexcept
+	{
+		if (!active)
+			return;
+
+		auto b = reinterpret_cast<uintptr_t>(ptr);
+		auto e = b + size;
+
+		/* first range which ends after b */
+		auto first = std::lower_bound(
+			ranges.begin(), ranges.end(), b,
+			[](const range &r, uintptr_t v) { return r.end <= v; });
+
+		auto last = first;
+		while (last != ranges.end() && last->begin < e)
+			++last;
+
+		if (first == last)
+			return;
+
+		range left{first->begin, b};
+		range right{e, (last - 1)->end};
+
+		auto pos = ranges.erase(first, last);
+		hint = 0;
+
+		try {
+			if (right.begin < right.end)
+				pos = ranges.insert(pos, right);
+			if (left.begin < left.end)
+				ranges.insert(pos, left);
+		} catch (std::bad_alloc &) {
+		}
+	}
+
+	/*
+	 * Checks whether the cache is used in the current transaction.
+	 */
+	bool
+	is_active() const noexcept
+	{
+		return active;
+	}
+
+private:
+	struct range {
+		uintptr_t begin;
+		uintptr_t end;
+
+		bool
+		covers(uintptr_t b, uintptr_t e) const noexcept
+		{
+			return begin <= b && e <= end;
+		}
+	};
+
+	snapshot_cache() : hint(0), active(false)
+	{
+	}
+
+	std::vector<range> ranges;
+
+	/* index of the range used last */
+	mutable std::size_t hint;
+
+	/* whether the transaction was started by the bindings */
+	bool active;
+};
+
+} /* namespace detail */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_SNAPSHOT_CACHE_HPP */
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Optional per-thread transaction statistics.
+ */
+
+#ifndef PMEMOBJ_TX_STATS_DETAIL_HPP
+#define PMEMOBJ_TX_STATS_DETAIL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef LIBPMEMOBJ_CPP_TX_STATS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace pmem
+{
+
+namespace detail
+{
+
+/*
+ * Counters of the transaction statistics.
+ */
+enum tx_counter : std::size_t {
+	tx_counter_transactions, /* outermost transactions */
+	tx_counter_nested,	 /* nested transactions */
+	tx_counter_commits,
+	tx_counter_aborts,
+	tx_counter_snapshots,	  /* ranges added to the undo log */
+	tx_counter_snapshot_bytes, /* bytes added to the undo log */
+	tx_counter_snapshot_hits,  /* snapshots skipped by the cache */
+	tx_counter_allocations,
+	tx_counter_allocation_bytes,
+	tx_counter_frees,
+	tx_counter_max
+};
+
+/* Number of buckets of the latency histograms */
+const std::size_t tx_histogram_buckets = 32;
+
+/*
+ * Histograms of the transaction statistics.
+ */
+enum tx_histogram : std::size_t {
+	tx_histogram_commit,	  /* time spent in pmemobj_tx_commit */
+	tx_histogram_transaction, /* duration of outermost transactions */
+	tx_histogram_max
+};
+
+#ifdef LIBPMEMOBJ_CPP_TX_STATS
+
+/*
+ * Statistics of a thread. They are only written by the owning thread,
+ * but may be read by any, hence the relaxed atomics.
+ */
+struct tx_thread_stats {
+	tx_thread_stats() noexcept
+	{
+		reset();
+	}
+
+	void
+	add(tx_counter c, uint64_t v) noexcept
+	{
+		counters[c].store(counters[c].load(std::memory_order_relaxed) +
+					  v,
+				  std::memory_order_relaxed);
+	}
+
+	/*
+	 * Records a latency in the bucket of its binary logarithm.
+	 */
+	void
+	record(tx_histogram h, uint64_t ns) noexcept
+	{
+		std::size_t b = 0;
+		while (ns != 0 && b < tx_histogram_buckets - 1) {
+			ns >>= 1;
+			++b;
+		}
+
+		auto &bucket = histograms[h][b];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+			     std::memory_order_relaxed);
+	}
+
+	void
+	reset() noexcept
+	{
+		for (auto &c : counters)
+			c.store(0, std::memory_order_relaxed);
+		for (auto &h : histograms)
+			for (auto &b : h)
+				b.store(0, std::memory_order_relaxed);
+	}
+
+	std::atomic<uint64_t> counters[tx_counter_max];
+	std::atomic<uint64_t> histograms[tx_histogram_max]
+					[tx_histogram_buckets];
+
+	/* start of the current outermost transaction */
+	std::chrono::steady_clock::time_point tx_start;
+};
+
+/*
+ * Statistics of all live threads, and the sum of the exited ones.
+ */
+struct tx_stats_registry {
+	static tx_stats_registry &
+	get()
+	{
+		static tx_stats_registry registry;
+
+		return registry;
+	}
+
+	std::mutex mtx;
+	std::vector<tx_thread_stats *> threads;
+	tx_thread_stats exited;
+};
+
+/*
+ * Registers the statistics of a thread for its lifetime.
+ *
+ * It is created by the first transaction of a thread, from the noexcept
+ * transaction hooks, so a failure to lock the registry or to grow it is
+ * swallowed. The statistics of such a thread are still counted, but are
+ * only visible in the totals once the thread exits.
+ */
+struct tx_thread_stats_holder {
+	tx_thread_stats_holder() noexcept : registered(false)
+	{
+		try {
+			auto &r = tx_stats_registry::get();
+			std::lock_guard<std::mutex> lock(r.mtx);
+			r.threads.push_back(&stats);
+			registered = true;
+		} catch (...) {
+		}
+	}
+
+	~tx_thread_stats_holder()
+	{
+		try {
+			auto &r = tx_stats_registry::get();
+			std::lock_guard<std::mutex> lock(r.mtx);
+
+			for (std::size_t c = 0; c < tx_counter_max; ++c)
+				r.exited.add(static_cast<tx_counter>(c),
+					     stats.counters[c].load());
+			for (std::size_t h = 0; h < tx_histogram_max; ++h)
+				for (std::size_t b = 0;
+				     b < tx_histogram_buckets; ++b)
+					r.exited.histograms[h][b].fetch_add(
+						stats.histograms[h][b].load());
+
+			if (registered)
+				r.threads.erase(std::find(r.threads.begin(),
+							  r.threads.end(),
+							  &stats));
+		} catch (...) {
+		}
+	}
+
+	tx_thread_stats stats;
+	bool registered;
+};
+
+inline tx_thread_stats &
+tx_stats_of_thread() noexcept
+{
+	static thread_local tx_thread_stats_holder holder;
+
+	return holder.stats;
+}
+
+/*
+ * Time measured by the statistics.
+ */
+using tx_stats_time = std::chrono::steady_clock::time_point;
+
+inline tx_stats_time
+tx_stats_now() noexcept
+{
+	return std::chrono::steady_clock::now();
+}
+
+inline uint64_t
+tx_stats_ns(tx_stats_time start, tx_stats_time end) noexcept
+{
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(end -
+								     start)
+			.count());
+}
+
+inline void
+tx_stats_begin(bool outermost) noexcept
+{
+	auto &s = tx_stats_of_thread();
+
+	if (outermost) {
+		s.add(tx_counter_transactions, 1);
+		s.tx_start = tx_stats_now();
+	} else {
+		s.add(tx_counter_nested, 1);
+	}
+}
+
+inline void
+tx_stats_end(int err) noexcept
+{
+	auto &s = tx_stats_of_thread();
+
+	s.add(err == 0 ? tx_counter_commits : tx_counter_aborts, 1);
+	s.record(tx_histogram_transaction,
+		 tx_stats_ns(s.tx_start, tx_stats_now()));
+}
+
+inline void
+tx_stats_commit(tx_stats_time start) noexcept
+{
+	tx_stats_of_thread().record(tx_histogram_commit,
+				    tx_stats_ns(start, tx_stats_now()));
+}
+
+inline void
+tx_stats_add(tx_counter c, uint64_t v = 1) noexcept
+{
+	tx_stats_of_thread().add(c, v);
+}
+
+#else /* LIBPMEMOBJ_CPP_TX_STATS */
+
+/*
+ * Without LIBPMEMOBJ_CPP_TX_STATS all hooks are empty.
+ */
+struct tx_stats_time {
+};
+
+inline tx_stats_time
+tx_stats_now() noexcept
+{
+	return tx_stats_time();
+}
+
+inline void
+tx_stats_begin(bool) noexcept
+{
+}
+
+inline void
+tx_stats_end(int) noexcept
+{
+}
+
+inline void
+tx_stats_commit(tx_stats_time) noexcept
+{
+}
+
+inline void
+tx_stats_add(tx_counter, uint64_t = 1) noexcept
+{
+}
+
+#endif /* LIBPMEMOBJ_CPP_TX_STATS */
+
+} /* namespace detail */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_TX_STATS_DETAIL_HPP */
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Volatile buffer of writes to be applied with the pmemobj action API.
+ */
+
+#ifndef PMEMOBJ_WRITE_SET_HPP
+#define PMEMOBJ_WRITE_SET_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "libpmemobj/action_base.h"
+
+namespace pmem
+{
+
+namespace detail
+{
+
+/*
+ * Set of buffered writes to persistent memory, kept as aligned 8-byte
+ * words, which is the granularity of pmemobj_set_value. The bytes of
+ * a word which were not written keep the value they had when the word
+ * was first written.
+ */
+class write_set {
+public:
+	/*
+	 * Copies size bytes from src to the buffered words of dst.
+	 */
+	void
+	write(const void *dst, const void *src, std::size_t size)
+	{
+		auto addr = reinterpret_cast<uintptr_t>(dst);
+		auto bytes = static_cast<const char *>(src);
+
+		while (size > 0) {
+			uint64_t *w = word_of(addr);
+			std::size_t off = addr - uintptr_t(w);
+			std::size_t len =
+				(std::min)(sizeof(uint64_t) - off, size);
+
+			auto it = index.find(w);
+			if (it == index.end()) {
+				it = index.emplace(w, words.size()).first;
+				words.push_back(word{w, *w});
+			}
+
+			std::memcpy(reinterpret_cast<char *>(
+					    &words[it->second].value) +
+					    off,
+				    bytes, len);
+
+			addr += len;
+			bytes += len;
+			size -= len;
+		}
+	}
+
+	/*
+	 * Copies size bytes from the buffered words of src, or from src
+	 * itself, to dst.
+	 */
+	void
+	read(void *dst, const void *src, std::size_t size) const
+	{
+		auto addr = reinterpret_cast<uintptr_t>(src);
+		auto bytes = static_cast<char *>(dst);
+
+		while (size > 0) {
+			uint64_t *w = word_of(addr);
+			std::size_t off = addr - uintptr_t(w);
+			std::size_t len =
+				(std::min)(sizeof(uint64_t) - off, size);
+
+			auto it = index.find(w);
+			const uint64_t *value = it == index.end()
+				? w
+				: &words[it->second].value;
+
+			std::memcpy(bytes,
+				    reinterpret_cast<const char *>(value) + off,
+				    len);
+
+			addr += len;
+			bytes += len;
+			size -= len;
+		}
+	}
+
+	/*
+	 * Fills size() actions starting at actv with the buffered words.
+	 */
+	void
+	set_values(PMEMobjpool *pop, pobj_action *actv) const
+	{
+		for (auto &w : words)
+			pmemobj_set_value(pop, actv++, w.addr, w.value);
+	}
+
+	/*
+	 * Returns the number of buffered words.
+	 */
+	std::size_t
+	size() const noexcept
+	{
+		return words.size();
+	}
+
+	bool
+	empty() const noexcept
+	{
+		return words.empty();
+	}
+
+	void
+	clear() noexcept
+	{
+		words.clear();
+		index.clear();
+	}
+
+private:
+	struct word {
+		uint64_t *addr;
+		uint64_t value;
+	};
+
+	static uint64_t *
+	word_of(uintptr_t addr) noexcept
+	{
+		return reinterpret_cast<uint64_t *>(
+			addr & ~uintptr_t(sizeof(uint64_t) - 1));
+	}
+
+	/* buffered words, in the order of their first write */
+	std::vector<word> words;
+
+	/* position of each buffered word in words */
+	std::unordered_map<uint64_t *, std::size_t> index;
+};
+
+} /* namespace detail */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_WRITE_SET_HPP */
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * C++ wrapper for the pmemobj action API.
+ */
+
+#ifndef PMEMOBJ_ACTION_BATCH_HPP
+#define PMEMOBJ_ACTION_BATCH_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/life.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/detail/write_set.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::action_batch - EXPERIMENTAL batch of
+ * reservations and writes published atomically.
+ *
+ * reserve() allocates and constructs an object which does not become
+ * a part of the heap until publish(), so it can be built without
+ * a transaction and without logging. set_value() buffers writes to
+ * existing p<> properties and persistent_ptrs, e.g. the one linking the
+ * new object into a data structure. publish() persists the reserved
+ * objects and applies everything with a single redo log; cancel(), or
+ * destroying the batch unpublished, releases the reservations and drops
+ * the writes.
+ *
+ * set_value() buffers aligned 8-byte words, the bytes of a word it does
+ * not cover keep the value they had at the first write to the word.
+ * If published in an active transaction, the batch becomes a part of it.
+ *
+ * The class is not thread-safe.
+ */
+class action_batch {
+public:
+	/**
+	 * Creates an empty batch for the pool.
+	 *
+	 * @param[in,out] pop pool object.
+	 */
+	explicit action_batch(pool_base &pop) : pop(pop.get_handle())
+	{
+	}
+
+	/**
+	 * Cancels the unpublished actions.
+	 */
+	~action_batch()
+	{
+		cancel();
+	}
+
+	action_batch(const action_batch &) = delete;
+	action_batch &operator=(const action_batch &) = delete;
+
+	/**
+	 * Reserves and constructs an object of type T.
+	 *
+	 * The object can be freely modified until publish(), which
+	 * persists it.
+	 *
+	 * @param[in,out] args a list of parameters passed to the
+	 *	constructor.
+	 *
+	 * @return pointer to the reserved object.
+	 *
+	 * @throw transaction_alloc_error if the reservation failed.
+	 * @throw rethrows the exception of the constructor.
+	 */
+	template <typename T, typename... Args>
+	persistent_ptr<T>
+	reserve(Args &&... args)
+	{
+		reservations.emplace_back();
+		PMEMoid oid = pmemobj_reserve(pop, &reservations.back(),
+					      sizeof(T), detail::type_num<T>());
+		if (OID_IS_NULL(oid)) {
+			reservations.pop_back();
+			throw transaction_alloc_error(
+				"failed to reserve persistent memory object");
+		}
+
+		persistent_ptr<T> ptr(oid);
+		try {
+			detail::create<T>(ptr.get(),
+					  std::forward<Args>(args)...);
+		} catch (...) {
+			pmemobj_cancel(pop, &reservations.back(), 1);
+			reservations.pop_back();
+			throw;
+		}
+
+		objects.emplace_back(ptr.get(), sizeof(T));
+
+		return ptr;
+	}
+
+	/**
+	 * Buffers a write of value to field.
+	 *
+	 * @param[in,out] field the property to be written.
+	 * @param[in] value the new value.
+	 *
+	 * @throw pool_error if field is not in the pool of the batch.
+	 */
+	template <typename T>
+	void
+	set_value(p<T> &field, const T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+			      "T has to be trivially copyable");
+
+		write(&field.get_ro(), &value, sizeof(T));
+	}
+
+	/**
+	 * Buffers a write of value to the pointer field.
+	 *
+	 * @param[in,out] field the pointer to be written.
+	 * @param[in] value the new value.
+	 *
+	 * @throw pool_error if field is not in the pool of the batch.
+	 */
+	template <typename T>
+	void
+	set_value(persistent_ptr<T> &field, const persistent_ptr<T> &value)
+	{
+		PMEMoid oid = value.raw();
+
+		write(&field.raw(), &oid, sizeof(oid));
+	}
+
+	/**
+	 * Returns the number of actions in the batch.
+	 */
+	std::size_t
+	size() const noexcept
+	{
+		return reservations.size() + writes.size();
+	}
+
+	/**
+	 * Checks whether the batch is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * Atomically publishes all reservations and writes.
+	 *
+	 * The reserved objects are persisted first. The batch is empty
+	 * afterwards and can be reused.
+	 *
+	 * @throw transaction_error if the actions could not be published,
+	 *	the batch is left unchanged then.
+	 */
+	void
+	publish()
+	{
+		if (empty())
+			return;
+
+#ifdef POBJ_MAX_ACTIONS
+		if (size() > POBJ_MAX_ACTIONS)
+			throw transaction_error("too many actions in batch");
+#endif
+
+		pool_base pb(pop);
+		for (auto &o : objects)
+			pb.flush(o.first, o.second);
+		pb.drain();
+
+		std::size_t nreserved = reservations.size();
+		reservations.resize(size());
+		writes.set_values(pop, &reservations[nreserved]);
+
+		int ret;
+		if (pmemobj_tx_stage() == TX_STAGE_WORK)
+			ret = pmemobj_tx_publish(reservations.data(),
+						 reservations.size());
+		else
+			ret = pmemobj_publish(pop, reservations.data(),
+					      reservations.size());
+
+		if (ret != 0) {
+			reservations.resize(nreserved);
+			throw transaction_error("failed to publish actions");
+		}
+
+		clear();
+	}
+
+	/**
+	 * Releases all reservations and drops the buffered writes.
+	 */
+	void
+	cancel() noexcept
+	{
+		if (!reservations.empty())
+			pmemobj_cancel(pop, reservations.data(),
+				       reservations.size());
+
+		clear();
+	}
+
+private:
+	/*
+	 * Buffers a write of size bytes from src to dst.
+	 */
+	void
+	write(const void *dst, const void *src, std::size_t size)
+	{
+		if (pmemobj_pool_by_ptr(dst) != pop)
+			throw pool_error("Object outside of the batch's pool.");
+
+		writes.write(dst, src, size);
+	}
+
+	void
+	clear() noexcept
+	{
+		reservations.clear();
+		objects.clear();
+		writes.clear();
+	}
+
+	PMEMobjpool *pop;
+
+	/* reservation actions, followed by the writes while publishing */
+	std::vector<pobj_action> reservations;
+
+	/* reserved objects, to be persisted before publishing */
+	std::vector<std::pair<void *, std::size_t>> objects;
+
+	detail::write_set writes;
+};
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_ACTION_BATCH_HPP */
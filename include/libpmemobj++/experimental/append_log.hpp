@@ -0,0 +1,587 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Persistent append-only log of variable-sized records.
+ */
+
+#ifndef PMEMOBJ_APPEND_LOG_HPP
+#define PMEMOBJ_APPEND_LOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/make_persistent.hpp"
+#include "libpmemobj++/make_persistent_array.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::append_log - EXPERIMENTAL persistent log of
+ * variable-sized records, which can only be appended to.
+ *
+ * Records are stored one after another in large extents, each preceded
+ * by its 8 byte length and padded to a multiple of 8 bytes. The log is
+ * valid up to a tail offset, which is published with a single persisted
+ * 8 byte store after the records below it are durable. Records are
+ * written beyond the tail without transactions or undo logging, so a
+ * crash before the tail is published simply leaves them unused. Only
+ * the allocation of a new extent, once per extent_size bytes, runs in
+ * a transaction.
+ *
+ * A batch writes any number of records and makes them durable with one
+ * drain before publishing the tail, so the whole batch costs two fences.
+ *
+ * The log must reside in persistent memory, i.e. it has to be created
+ * with make_persistent or be a member of an object which was. Only one
+ * thread at a time may append, while any number of threads may read the
+ * records already published.
+ */
+class append_log {
+	struct extent;
+
+public:
+	using size_type = std::size_t;
+
+	/**
+	 * Record stored in the log.
+	 */
+	struct record {
+		const char *data;
+		size_type size;
+	};
+
+	/**
+	 * Default size of an extent.
+	 */
+	static constexpr size_type default_extent_size = 1 << 20;
+
+	/**
+	 * Forward iterator over the published records.
+	 */
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = record;
+		using difference_type = std::ptrdiff_t;
+		using reference = record;
+		using pointer = const record *;
+
+		/**
+		 * Constructs end iterator.
+		 */
+		const_iterator() : e(nullptr), pos(0), tail(0)
+		{
+		}
+
+		reference operator*() const
+		{
+			const char *header = e->data.get() + (pos - e->start);
+			uint64_t size;
+			std::memcpy(&size, header, sizeof(size));
+
+			return record{header + sizeof(size),
+				      static_cast<size_type>(size)};
+		}
+
+		const_iterator &operator++()
+		{
+			pos += record_space((**this).size);
+			skip();
+
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator tmp(*this);
+			++(*this);
+
+			return tmp;
+		}
+
+		bool
+		operator==(const const_iterator &rhs) const
+		{
+			return e == rhs.e && (e == nullptr || pos == rhs.pos);
+		}
+
+		bool
+		operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+
+	private:
+		friend class append_log;
+
+		const_iterator(const extent *e, uint64_t tail)
+		    : e(e), pos(0), tail(tail)
+		{
+			skip();
+		}
+
+		/*
+		 * Moves to the next extent if there are no more records in
+		 * the current one and to the end at the tail.
+		 */
+		void
+		skip()
+		{
+			while (e != nullptr && pos < tail) {
+				uint64_t local = pos - e->start;
+
+				if (local + header_size <= e->capacity &&
+				    length_at(e, local) != padding)
+					return;
+
+				e = e->next.get();
+				if (e != nullptr)
+					pos = e->start;
+			}
+
+			e = nullptr;
+		}
+
+		const extent *e;
+		uint64_t pos;
+		uint64_t tail;
+	};
+
+	/**
+	 * Volatile helper which appends a group of records and publishes
+	 * them together.
+	 *
+	 * Records added to a batch are copied to the log and flushed right
+	 * away, but they become part of the log only when commit is called.
+	 * A batch destroyed without commit leaves the log unchanged.
+	 */
+	class batch {
+	public:
+		/**
+		 * Starts a batch of appends to log.
+		 *
+		 * @throw pmem::transaction_scope_error if called within a
+		 *	transaction.
+		 */
+		explicit batch(append_log &log) : log(log)
+		{
+			log.check_tx_stage();
+
+			pos = log.tail();
+			e = log.extent_of(pos);
+		}
+
+		/**
+		 * Appends a record with a copy of size bytes of data.
+		 *
+		 * @throw pmem::transaction_error when allocating a new
+		 *	extent failed.
+		 */
+		void
+		append(const void *data, size_type size)
+		{
+			pos = log.write(e, pos, data, size);
+		}
+
+		/**
+		 * Makes all records appended so far durable with a single
+		 * drain and publishes them. The batch may be used further.
+		 */
+		void
+		commit()
+		{
+			log.publish(pos);
+		}
+
+	private:
+		append_log &log;
+		extent *e;
+		uint64_t pos;
+	};
+
+	/**
+	 * Constructs an empty log with a first extent of extent_size bytes.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the log doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating the extent
+	 *	failed.
+	 * @throw std::invalid_argument if extent_size is not a positive
+	 *	multiple of 8.
+	 */
+	explicit append_log(size_type extent_size = default_extent_size)
+	    : _extent_size(extent_size), _tail(0)
+	{
+		check_pmem_tx();
+
+		if (extent_size == 0 || extent_size % header_size != 0)
+			throw std::invalid_argument(
+				"extent size has to be a positive multiple "
+				"of 8");
+
+		_head = make_persistent<extent>(uint64_t(0),
+						uint64_t(extent_size));
+		_current = _head;
+	}
+
+	/**
+	 * Destructor. Frees all extents.
+	 */
+	~append_log()
+	{
+		try {
+			pool_base pb = get_pool();
+			transaction::exec_tx(pb, [&] {
+				free_extents(_head);
+				_head = nullptr;
+				_current = nullptr;
+			});
+		} catch (...) {
+			std::terminate();
+		}
+	}
+
+	append_log(const append_log &) = delete;
+	append_log &operator=(const append_log &) = delete;
+
+	/**
+	 * Appends a single record and publishes it.
+	 *
+	 * @throw pmem::transaction_scope_error if called within a
+	 *	transaction.
+	 * @throw pmem::transaction_error when allocating a new extent
+	 *	failed.
+	 */
+	void
+	append(const void *data, size_type size)
+	{
+		batch b(*this);
+		b.append(data, size);
+		b.commit();
+	}
+
+	/**
+	 * Removes all records and frees all extents but the first one.
+	 * Cannot be called concurrently with readers.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	clear()
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			free_extents(_head->next);
+			_head->next = nullptr;
+			_current = _head;
+
+			detail::conditional_add_to_tx(&_tail);
+			_tail.store(0, std::memory_order_relaxed);
+		});
+	}
+
+	/**
+	 * Returns the published tail, the number of bytes used by the
+	 * records, their headers and the space skipped at extent ends.
+	 */
+	uint64_t
+	tail() const noexcept
+	{
+		return _tail.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Checks whether the log has no records.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return tail() == 0;
+	}
+
+	/**
+	 * Returns an iterator to the oldest record. Records published
+	 * later are not visited.
+	 */
+	const_iterator
+	begin() const
+	{
+		return const_iterator(_head.get(), tail());
+	}
+
+	/**
+	 * Returns an iterator past the records.
+	 */
+	const_iterator
+	end() const
+	{
+		return const_iterator();
+	}
+
+private:
+	static constexpr uint64_t header_size = sizeof(uint64_t);
+
+	/* Length written at the end of an extent which has no more records */
+	static constexpr uint64_t padding = ~uint64_t(0);
+
+	struct extent {
+		extent(uint64_t start, uint64_t capacity)
+		    : start(start), capacity(capacity)
+		{
+			data = make_persistent<char[]>(capacity);
+		}
+
+		~extent()
+		{
+			delete_persistent<char[]>(data, capacity);
+		}
+
+		persistent_ptr<char[]> data;
+
+		/* Offset in the log of the first byte of the extent */
+		p<uint64_t> start;
+		p<uint64_t> capacity;
+
+		persistent_ptr<extent> next;
+	};
+
+	static uint64_t
+	record_space(uint64_t size) noexcept
+	{
+		return header_size + (size + header_size - 1) / header_size *
+			header_size;
+	}
+
+	static uint64_t
+	length_at(const extent *e, uint64_t local) noexcept
+	{
+		uint64_t size;
+		std::memcpy(&size, e->data.get() + local, sizeof(size));
+
+		return size;
+	}
+
+	/*
+	 * Returns the extent to which records following pos are written.
+	 * If a batch moved to a new extent and was not committed, the
+	 * extent is looked up from the first one.
+	 */
+	extent *
+	extent_of(uint64_t pos) const
+	{
+		extent *e = _current.get();
+		if (e->start <= pos)
+			return e;
+
+		e = _head.get();
+		while (e->next != nullptr && e->next->start <= pos)
+			e = e->next.get();
+
+		return e;
+	}
+
+	/*
+	 * Copies a record to the log at pos in extent e and flushes it.
+	 * If the record does not fit, the rest of the extent is marked
+	 * with padding and the record goes to the following extent, which
+	 * is allocated unless an uncommitted batch left one. Returns the
+	 * position following the record.
+	 */
+	uint64_t
+	write(extent *&e, uint64_t pos, const void *data, size_type size)
+	{
+		pool_base pb = get_pool();
+		uint64_t space = record_space(size);
+		uint64_t local = pos - e->start;
+
+		while (local + space > e->capacity) {
+			if (local + header_size <= e->capacity) {
+				char *end = e->data.get() + local;
+				uint64_t marker = padding;
+				std::memcpy(end, &marker, sizeof(marker));
+				pb.flush(end, sizeof(marker));
+			}
+
+			/* the padding is drained when the transaction ends */
+			transaction::exec_tx(pb, [&] {
+				if (e->next == nullptr) {
+					uint64_t capacity = (std::max)(
+						space, uint64_t(_extent_size));
+					e->next = make_persistent<extent>(
+						e->start + e->capacity,
+						capacity);
+				}
+
+				_current = e->next;
+			});
+
+			e = e->next.get();
+			pos = e->start;
+			local = 0;
+		}
+
+		char *dest = e->data.get() + local;
+		uint64_t length = size;
+		std::memcpy(dest, &length, sizeof(length));
+		pb.flush(dest, sizeof(length));
+		copy(pb, dest + header_size, data, size);
+
+		return pos + space;
+	}
+
+	/*
+	 * Copies and flushes a record, without draining.
+	 */
+	static void
+	copy(pool_base &pb, char *dest, const void *src, size_type size)
+	{
+#ifdef PMEMOBJ_F_MEM_NONTEMPORAL
+		pmemobj_memcpy(pb.get_handle(), dest, src, size,
+			       PMEMOBJ_F_MEM_NODRAIN |
+				       PMEMOBJ_F_MEM_NONTEMPORAL);
+#else
+		std::memcpy(dest, src, size);
+		pb.flush(dest, size);
+#endif
+	}
+
+	/*
+	 * Drains the records written below new_tail and then publishes
+	 * it with a single persisted store.
+	 */
+	void
+	publish(uint64_t new_tail)
+	{
+		pool_base pb = get_pool();
+		pb.drain();
+
+		_tail.store(new_tail, std::memory_order_release);
+		pb.persist(&_tail, sizeof(_tail));
+	}
+
+	/*
+	 * Frees the extent e and all following ones, in a transaction.
+	 */
+	static void
+	free_extents(persistent_ptr<extent> e)
+	{
+		while (e != nullptr) {
+			persistent_ptr<extent> next = e->next;
+			delete_persistent<extent>(e);
+			e = next;
+		}
+	}
+
+	/*
+	 * Throws if called within a transaction, which could roll back
+	 * an extent allocation below a published tail.
+	 */
+	static void
+	check_tx_stage()
+	{
+		if (pmemobj_tx_stage() != TX_STAGE_NONE)
+			throw transaction_scope_error(
+				"append_log cannot be appended to within a "
+				"transaction");
+	}
+
+	/*
+	 * Checks that the log resides in persistent memory and that
+	 * there is an active transaction.
+	 */
+	void
+	check_pmem_tx() const
+	{
+		if (pmemobj_pool_by_ptr(this) == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"Function called out of transaction scope.");
+	}
+
+	/*
+	 * Returns the pool in which the log resides.
+	 */
+	pool_base
+	get_pool() const
+	{
+		auto pop = pmemobj_pool_by_ptr(this);
+		if (pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		return pool_base(pop);
+	}
+
+	persistent_ptr<extent> _head;
+
+	/* Extent to which records are appended */
+	persistent_ptr<extent> _current;
+
+	p<size_type> _extent_size;
+
+	/* Offset in the log past the last published record */
+	std::atomic<uint64_t> _tail;
+};
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_APPEND_LOG_HPP */
@@ -0,0 +1,1323 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Persistent adaptive radix tree with byte string keys.
+ */
+
+#ifndef PMEMOBJ_ART_MAP_HPP
+#define PMEMOBJ_ART_MAP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/experimental/string.hpp"
+#include "libpmemobj++/make_persistent.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::art_map - EXPERIMENTAL persistent map from byte
+ * strings to T, implemented as an adaptive radix tree.
+ *
+ * Inner nodes branch on one byte of the key and come in four sizes, with
+ * room for 4, 16, 48 and 256 children, so that sparse nodes stay small.
+ * A node grows or shrinks to the next size when it is full or mostly
+ * empty. The 16 keys of the second size are searched with a single SSE2
+ * comparison where available. Chains of nodes with a single child are
+ * compressed into a prefix stored in the node below them; the first
+ * max_prefix_len bytes of the prefix are kept in the node and the rest
+ * is compared against the key stored in a leaf.
+ *
+ * Every element is a leaf holding the whole key, in a persistent string
+ * whose internal buffer fits short keys without another allocation, and
+ * the value. A key which is a prefix of other keys is stored in the inner
+ * node where it ends. Elements are visited in lexicographical order of
+ * their keys.
+ *
+ * Every modification is performed in its own transaction, so the map can
+ * be modified within an outer transaction too.
+ */
+template <typename T>
+class art_map {
+public:
+	/* Member types */
+	using mapped_type = T;
+	using size_type = std::size_t;
+
+	/**
+	 * Number of prefix bytes stored in an inner node.
+	 */
+	static constexpr size_type max_prefix_len = 8;
+
+private:
+	enum node_type : uint8_t {
+		leaf_type,
+		node4_type,
+		node16_type,
+		node48_type,
+		node256_type
+	};
+
+	struct node_base {
+		explicit node_base(node_type type) : type(type)
+		{
+		}
+
+		p<node_type> type;
+	};
+
+	struct leaf : node_base {
+		leaf(const char *key, size_type len, const mapped_type &value)
+		    : node_base(leaf_type), key(key, len), value(value)
+		{
+		}
+
+		basic_string<char> key;
+		mapped_type value;
+	};
+
+	struct inner : node_base {
+		explicit inner(node_type type)
+		    : node_base(type), count(0), prefix_len(0)
+		{
+		}
+
+		/* Number of children */
+		p<uint16_t> count;
+
+		/* Length of the compressed path above the children */
+		p<uint32_t> prefix_len;
+		uint8_t prefix[max_prefix_len];
+
+		/* Element whose key ends in this node */
+		persistent_ptr<leaf> value;
+	};
+
+	/* Inner node with keys and children sorted by key */
+	template <node_type Type, size_type N>
+	struct sorted_node : inner {
+		sorted_node() : inner(Type)
+		{
+		}
+
+		uint8_t keys[N];
+		persistent_ptr<node_base> children[N];
+	};
+
+	using node4 = sorted_node<node4_type, 4>;
+	using node16 = sorted_node<node16_type, 16>;
+
+	struct node48 : inner {
+		node48() : inner(node48_type)
+		{
+			std::memset(child_index, 0, sizeof(child_index));
+		}
+
+		/* One plus the index of the child for each key, or 0 */
+		uint8_t child_index[256];
+		persistent_ptr<node_base> children[48];
+	};
+
+	struct node256 : inner {
+		node256() : inner(node256_type)
+		{
+		}
+
+		persistent_ptr<node_base> children[256];
+	};
+
+public:
+	/**
+	 * Constructs an empty map.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the map doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 */
+	art_map() : _size(0)
+	{
+		check_pmem_tx();
+	}
+
+	/**
+	 * Destructor. Frees all elements.
+	 */
+	~art_map()
+	{
+		try {
+			clear();
+		} catch (...) {
+			std::terminate();
+		}
+	}
+
+	art_map(const art_map &) = delete;
+	art_map &operator=(const art_map &) = delete;
+
+	/**
+	 * Returns the number of elements.
+	 */
+	size_type
+	size() const noexcept
+	{
+		return _size;
+	}
+
+	/**
+	 * Checks whether the map is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * Returns a pointer to the value stored under the first len bytes
+	 * of key, or nullptr if there is no such element. The value has to
+	 * be modified in a transaction.
+	 */
+	mapped_type *
+	find(const char *key, size_type len) const
+	{
+		node_base *nb = _root.get();
+		size_type depth = 0;
+
+		while (nb != nullptr) {
+			if (nb->type == leaf_type) {
+				leaf *l = static_cast<leaf *>(nb);
+
+				return matches(l, key, len) ? &l->value
+							    : nullptr;
+			}
+
+			inner *n = static_cast<inner *>(nb);
+			if (n->prefix_len != 0) {
+				if (!prefix_matches(n, key, len, depth))
+					return nullptr;
+
+				depth += n->prefix_len;
+			}
+
+			if (depth == len) {
+				leaf *l = n->value.get();
+
+				return l != nullptr && matches(l, key, len)
+					? &l->value
+					: nullptr;
+			}
+
+			persistent_ptr<node_base> *child =
+				find_child(n, byte_at(key, depth));
+			if (child == nullptr)
+				return nullptr;
+
+			nb = child->get();
+			depth++;
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * Returns a pointer to the value stored under key, or nullptr.
+	 */
+	mapped_type *
+	find(const std::string &key) const
+	{
+		return find(key.data(), key.size());
+	}
+
+	/**
+	 * Returns the number of elements with the given key, either 0 or 1.
+	 */
+	size_type
+	count(const char *key, size_type len) const
+	{
+		return find(key, len) == nullptr ? 0 : 1;
+	}
+
+	/**
+	 * Returns the number of elements with the given key, either 0 or 1.
+	 */
+	size_type
+	count(const std::string &key) const
+	{
+		return count(key.data(), key.size());
+	}
+
+	/**
+	 * Inserts the first len bytes of key with value, unless the key is
+	 * already present.
+	 *
+	 * @return true if the element was inserted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a node
+	 *	failed.
+	 */
+	bool
+	insert(const char *key, size_type len, const mapped_type &value)
+	{
+		return insert(key, len, value, false);
+	}
+
+	/**
+	 * Inserts key with value, unless the key is already present.
+	 *
+	 * @return true if the element was inserted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a node
+	 *	failed.
+	 */
+	bool
+	insert(const std::string &key, const mapped_type &value)
+	{
+		return insert(key.data(), key.size(), value, false);
+	}
+
+	/**
+	 * Inserts the first len bytes of key with value or replaces the
+	 * value if the key is already present.
+	 *
+	 * @return true if the element was inserted, false if assigned.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a node
+	 *	failed.
+	 */
+	bool
+	insert_or_assign(const char *key, size_type len,
+			 const mapped_type &value)
+	{
+		return insert(key, len, value, true);
+	}
+
+	/**
+	 * Inserts key with value or replaces the value if the key is
+	 * already present.
+	 *
+	 * @return true if the element was inserted, false if assigned.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a node
+	 *	failed.
+	 */
+	bool
+	insert_or_assign(const std::string &key, const mapped_type &value)
+	{
+		return insert(key.data(), key.size(), value, true);
+	}
+
+	/**
+	 * Removes the element stored under the first len bytes of key.
+	 *
+	 * @return number of removed elements, either 0 or 1.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a smaller
+	 *	node failed.
+	 */
+	size_type
+	erase(const char *key, size_type len)
+	{
+		bool erased = false;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			erased = remove(key, len);
+			if (erased)
+				_size = _size - 1;
+		});
+
+		return erased ? 1 : 0;
+	}
+
+	/**
+	 * Removes the element stored under key.
+	 *
+	 * @return number of removed elements, either 0 or 1.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a smaller
+	 *	node failed.
+	 */
+	size_type
+	erase(const std::string &key)
+	{
+		return erase(key.data(), key.size());
+	}
+
+	/**
+	 * Removes all elements.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	clear()
+	{
+		if (_root == nullptr)
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			free_tree(_root);
+			_root = nullptr;
+			_size = 0;
+		});
+	}
+
+	/**
+	 * Calls f(key, len, value) for every element, in lexicographical
+	 * order of the keys.
+	 */
+	template <typename F>
+	void
+	for_each(F f) const
+	{
+		visit(_root.get(), f);
+	}
+
+private:
+	static uint8_t
+	byte_at(const char *key, size_type i) noexcept
+	{
+		return static_cast<uint8_t>(key[i]);
+	}
+
+	static bool
+	matches(const leaf *l, const char *key, size_type len) noexcept
+	{
+		return l->key.size() == len &&
+			std::memcmp(l->key.cdata(), key, len) == 0;
+	}
+
+	/*
+	 * Compares the stored part of the prefix of n with the key at
+	 * depth. The rest of the prefix is verified at the leaf.
+	 */
+	static bool
+	prefix_matches(const inner *n, const char *key, size_type len,
+		       size_type depth) noexcept
+	{
+		size_type plen = n->prefix_len;
+		if (plen > len - depth)
+			return false;
+
+		size_type cmp = (std::min)(plen, max_prefix_len);
+
+		return std::memcmp(n->prefix, key + depth, cmp) == 0;
+	}
+
+	/*
+	 * Returns the length of the common part of the prefix of n and
+	 * the key at depth, reading the prefix bytes which are not stored
+	 * in n from its smallest leaf.
+	 */
+	static size_type
+	prefix_mismatch(inner *n, const char *key, size_type len,
+			size_type depth) noexcept
+	{
+		size_type plen = n->prefix_len;
+		size_type cmp = (std::min)(plen, len - depth);
+		size_type stored = (std::min)(cmp, max_prefix_len);
+		size_type i = 0;
+
+		for (; i < stored; ++i)
+			if (n->prefix[i] != byte_at(key, depth + i))
+				return i;
+
+		if (i < cmp) {
+			const char *lkey = minimum(n)->key.cdata();
+
+			for (; i < cmp; ++i)
+				if (lkey[depth + i] != key[depth + i])
+					return i;
+		}
+
+		return cmp;
+	}
+
+	/*
+	 * Returns the index of key among the first count keys of a node16,
+	 * or count if it is not there.
+	 */
+	static size_type
+	find_key16(const uint8_t *keys, size_type count, uint8_t key) noexcept
+	{
+#if defined(__SSE2__)
+		const __m128i *p = reinterpret_cast<const __m128i *>(keys);
+		__m128i needle = _mm_set1_epi8(static_cast<char>(key));
+		__m128i cmp = _mm_cmpeq_epi8(needle, _mm_loadu_si128(p));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(cmp)) &
+			((1U << count) - 1);
+
+		return mask != 0 ? static_cast<size_type>(__builtin_ctz(mask))
+				 : count;
+#else
+		size_type i = 0;
+		while (i < count && keys[i] != key)
+			i++;
+
+		return i;
+#endif
+	}
+
+	/*
+	 * Returns the child slot for key, or nullptr if there is no child.
+	 */
+	static persistent_ptr<node_base> *
+	find_child(inner *n, uint8_t key) noexcept
+	{
+		size_type count = n->count;
+
+		switch (n->type) {
+			case node4_type: {
+				node4 *s = static_cast<node4 *>(n);
+				for (size_type i = 0; i < count; ++i)
+					if (s->keys[i] == key)
+						return &s->children[i];
+
+				return nullptr;
+			}
+			case node16_type: {
+				node16 *s = static_cast<node16 *>(n);
+				size_type i = find_key16(s->keys, count, key);
+
+				return i < count ? &s->children[i] : nullptr;
+			}
+			case node48_type: {
+				node48 *s = static_cast<node48 *>(n);
+				uint8_t i = s->child_index[key];
+
+				return i != 0 ? &s->children[i - 1] : nullptr;
+			}
+			default: {
+				node256 *s = static_cast<node256 *>(n);
+
+				return s->children[key] != nullptr
+					? &s->children[key]
+					: nullptr;
+			}
+		}
+	}
+
+	/*
+	 * Returns the first child of a node which has children.
+	 */
+	static node_base *
+	first_child(inner *n) noexcept
+	{
+		switch (n->type) {
+			case node4_type:
+				return static_cast<node4 *>(n)
+					->children[0]
+					.get();
+			case node16_type:
+				return static_cast<node16 *>(n)
+					->children[0]
+					.get();
+			case node48_type: {
+				node48 *s = static_cast<node48 *>(n);
+				size_type b = 0;
+				while (s->child_index[b] == 0)
+					b++;
+
+				return s->children[s->child_index[b] - 1]
+					.get();
+			}
+			default: {
+				node256 *s = static_cast<node256 *>(n);
+				size_type b = 0;
+				while (s->children[b] == nullptr)
+					b++;
+
+				return s->children[b].get();
+			}
+		}
+	}
+
+	/*
+	 * Returns the leaf with the smallest key below nb.
+	 */
+	static leaf *
+	minimum(node_base *nb) noexcept
+	{
+		while (nb->type != leaf_type) {
+			inner *n = static_cast<inner *>(nb);
+			if (n->value != nullptr)
+				return n->value.get();
+
+			nb = first_child(n);
+		}
+
+		return static_cast<leaf *>(nb);
+	}
+
+	template <typename U>
+	static persistent_ptr<U>
+	cast(const persistent_ptr<node_base> &ptr) noexcept
+	{
+		return persistent_ptr<U>(ptr.raw());
+	}
+
+	/*
+	 * Copies the prefix and the value of src into dst, which was
+	 * allocated in the current transaction.
+	 */
+	static void
+	copy_header(inner *dst, const inner *src) noexcept
+	{
+		dst->prefix_len = src->prefix_len;
+		std::memcpy(dst->prefix, src->prefix, max_prefix_len);
+		*dst->value.raw_ptr() = src->value.raw();
+	}
+
+	/*
+	 * Inserts a child into a sorted node which is not full.
+	 */
+	template <typename Node>
+	static void
+	sorted_insert(Node *s, uint8_t key,
+		      const persistent_ptr<node_base> &child)
+	{
+		size_type count = s->count;
+		size_type pos = 0;
+		while (pos < count && s->keys[pos] < key)
+			pos++;
+
+		detail::conditional_add_to_tx(s);
+
+		for (size_type i = count; i > pos; --i) {
+			s->keys[i] = s->keys[i - 1];
+			*s->children[i].raw_ptr() = s->children[i - 1].raw();
+		}
+
+		s->keys[pos] = key;
+		*s->children[pos].raw_ptr() = child.raw();
+		s->count = static_cast<uint16_t>(count + 1);
+	}
+
+	/*
+	 * Removes the child at pos from a sorted node.
+	 */
+	template <typename Node>
+	static void
+	sorted_remove(Node *s, size_type pos)
+	{
+		size_type count = s->count;
+
+		detail::conditional_add_to_tx(s);
+
+		for (size_type i = pos; i + 1 < count; ++i) {
+			s->keys[i] = s->keys[i + 1];
+			*s->children[i].raw_ptr() = s->children[i + 1].raw();
+		}
+
+		s->count = static_cast<uint16_t>(count - 1);
+	}
+
+	/*
+	 * Copies the children of a sorted node into a new, bigger or
+	 * smaller, sorted node.
+	 */
+	template <typename To, typename From>
+	static persistent_ptr<To>
+	resize_sorted(From *s)
+	{
+		persistent_ptr<To> g = make_persistent<To>();
+		copy_header(g.get(), s);
+
+		size_type count = s->count;
+		for (size_type i = 0; i < count; ++i) {
+			g->keys[i] = s->keys[i];
+			*g->children[i].raw_ptr() = s->children[i].raw();
+		}
+		g->count = s->count;
+
+		return g;
+	}
+
+	/*
+	 * Adds a child to the node n stored in ref, replacing the node with
+	 * a bigger one if it is full.
+	 */
+	void
+	add_child(persistent_ptr<node_base> &ref, inner *n, uint8_t key,
+		  const persistent_ptr<node_base> &child)
+	{
+		switch (n->type) {
+			case node4_type: {
+				node4 *s = static_cast<node4 *>(n);
+				if (s->count < 4) {
+					sorted_insert(s, key, child);
+					return;
+				}
+
+				persistent_ptr<node16> g =
+					resize_sorted<node16>(s);
+				sorted_insert(g.get(), key, child);
+				replace(ref, g);
+				return;
+			}
+			case node16_type: {
+				node16 *s = static_cast<node16 *>(n);
+				if (s->count < 16) {
+					sorted_insert(s, key, child);
+					return;
+				}
+
+				persistent_ptr<node48> g =
+					make_persistent<node48>();
+				copy_header(g.get(), s);
+				for (size_type i = 0; i < 16; ++i) {
+					g->child_index[s->keys[i]] =
+						static_cast<uint8_t>(i + 1);
+					*g->children[i].raw_ptr() =
+						s->children[i].raw();
+				}
+				g->count = s->count;
+
+				add_child48(g.get(), key, child);
+				replace(ref, g);
+				return;
+			}
+			case node48_type: {
+				node48 *s = static_cast<node48 *>(n);
+				if (s->count < 48) {
+					add_child48(s, key, child);
+					return;
+				}
+
+				persistent_ptr<node256> g =
+					make_persistent<node256>();
+				copy_header(g.get(), s);
+				for (size_type b = 0; b < 256; ++b) {
+					uint8_t i = s->child_index[b];
+					if (i != 0)
+						*g->children[b].raw_ptr() =
+							s->children[i - 1]
+								.raw();
+				}
+				g->count = s->count;
+
+				add_child256(g.get(), key, child);
+				replace(ref, g);
+				return;
+			}
+			default:
+				add_child256(static_cast<node256 *>(n), key,
+					     child);
+		}
+	}
+
+	static void
+	add_child48(node48 *s, uint8_t key,
+		    const persistent_ptr<node_base> &child)
+	{
+		size_type pos = 0;
+		while (s->children[pos] != nullptr)
+			pos++;
+
+		detail::conditional_add_to_tx(&s->child_index[key]);
+		s->child_index[key] = static_cast<uint8_t>(pos + 1);
+		s->children[pos] = child;
+		s->count = static_cast<uint16_t>(s->count + 1);
+	}
+
+	static void
+	add_child256(node256 *s, uint8_t key,
+		     const persistent_ptr<node_base> &child)
+	{
+		s->children[key] = child;
+		s->count = static_cast<uint16_t>(s->count + 1);
+	}
+
+	/*
+	 * Removes the child for key from the node n stored in ref and
+	 * replaces the node with a smaller one, or with its only remaining
+	 * element, when it becomes sparse.
+	 */
+	void
+	remove_child(persistent_ptr<node_base> &ref, inner *n, uint8_t key)
+	{
+		switch (n->type) {
+			case node4_type: {
+				node4 *s = static_cast<node4 *>(n);
+				sorted_remove(s, static_cast<size_type>(
+							 find_child(s, key) -
+							 s->children));
+				collapse(ref, s);
+				return;
+			}
+			case node16_type: {
+				node16 *s = static_cast<node16 *>(n);
+				sorted_remove(s, static_cast<size_type>(
+							 find_child(s, key) -
+							 s->children));
+				if (s->count <= 3)
+					replace(ref, resize_sorted<node4>(s));
+				return;
+			}
+			case node48_type: {
+				node48 *s = static_cast<node48 *>(n);
+				uint8_t i = s->child_index[key];
+
+				detail::conditional_add_to_tx(
+					&s->child_index[key]);
+				s->child_index[key] = 0;
+				s->children[i - 1] = nullptr;
+				s->count = static_cast<uint16_t>(s->count - 1);
+
+				if (s->count > 12)
+					return;
+
+				persistent_ptr<node16> g =
+					make_persistent<node16>();
+				copy_header(g.get(), s);
+
+				size_type count = 0;
+				for (size_type b = 0; b < 256; ++b) {
+					uint8_t j = s->child_index[b];
+					if (j == 0)
+						continue;
+
+					g->keys[count] =
+						static_cast<uint8_t>(b);
+					*g->children[count].raw_ptr() =
+						s->children[j - 1].raw();
+					count++;
+				}
+				g->count = s->count;
+
+				replace(ref, g);
+				return;
+			}
+			default: {
+				node256 *s = static_cast<node256 *>(n);
+
+				s->children[key] = nullptr;
+				s->count = static_cast<uint16_t>(s->count - 1);
+
+				if (s->count > 37)
+					return;
+
+				persistent_ptr<node48> g =
+					make_persistent<node48>();
+				copy_header(g.get(), s);
+
+				size_type count = 0;
+				for (size_type b = 0; b < 256; ++b) {
+					if (s->children[b] == nullptr)
+						continue;
+
+					g->child_index[b] =
+						static_cast<uint8_t>(count + 1);
+					*g->children[count].raw_ptr() =
+						s->children[b].raw();
+					count++;
+				}
+				g->count = s->count;
+
+				replace(ref, g);
+				return;
+			}
+		}
+	}
+
+	/*
+	 * Replaces a node4 which is left with a single element by that
+	 * element, merging the prefixes if it is an inner node.
+	 */
+	void
+	collapse(persistent_ptr<node_base> &ref, node4 *s)
+	{
+		persistent_ptr<node_base> child;
+
+		if (s->count == 0) {
+			child = s->value;
+		} else if (s->count == 1 && s->value == nullptr) {
+			child = s->children[0];
+
+			if (child->type != leaf_type) {
+				inner *c = static_cast<inner *>(child.get());
+				uint8_t buf[max_prefix_len];
+				size_type len = (std::min)(
+					size_type(s->prefix_len),
+					max_prefix_len);
+
+				std::memcpy(buf, s->prefix, len);
+				if (len < max_prefix_len)
+					buf[len++] = s->keys[0];
+				if (len < max_prefix_len) {
+					size_type m = (std::min)(
+						size_type(c->prefix_len),
+						max_prefix_len - len);
+					std::memcpy(buf + len, c->prefix, m);
+					len += m;
+				}
+
+				detail::conditional_add_to_tx(&c->prefix);
+				std::memcpy(c->prefix, buf, len);
+				c->prefix_len = s->prefix_len + 1 +
+					c->prefix_len;
+			}
+		} else {
+			return;
+		}
+
+		delete_persistent<node4>(cast<node4>(ref));
+		ref = child;
+	}
+
+	/*
+	 * Stores the new node g in ref and frees the node it replaces.
+	 */
+	template <typename Node>
+	void
+	replace(persistent_ptr<node_base> &ref, const persistent_ptr<Node> &g)
+	{
+		free_node(ref);
+		ref = g;
+	}
+
+	/*
+	 * Frees a single node, without its children.
+	 */
+	static void
+	free_node(const persistent_ptr<node_base> &nb)
+	{
+		switch (nb->type) {
+			case leaf_type:
+				delete_persistent<leaf>(cast<leaf>(nb));
+				break;
+			case node4_type:
+				delete_persistent<node4>(cast<node4>(nb));
+				break;
+			case node16_type:
+				delete_persistent<node16>(cast<node16>(nb));
+				break;
+			case node48_type:
+				delete_persistent<node48>(cast<node48>(nb));
+				break;
+			default:
+				delete_persistent<node256>(cast<node256>(nb));
+		}
+	}
+
+	/*
+	 * Frees a node with all nodes below it.
+	 */
+	static void
+	free_tree(const persistent_ptr<node_base> &nb)
+	{
+		if (nb->type != leaf_type) {
+			inner *n = static_cast<inner *>(nb.get());
+
+			if (n->value != nullptr)
+				delete_persistent<leaf>(n->value);
+
+			for_each_child(n, [](persistent_ptr<node_base> &c) {
+				free_tree(c);
+			});
+		}
+
+		free_node(nb);
+	}
+
+	/*
+	 * Calls f for every child of n, in order of the keys.
+	 */
+	template <typename F>
+	static void
+	for_each_child(inner *n, F f)
+	{
+		switch (n->type) {
+			case node4_type: {
+				node4 *s = static_cast<node4 *>(n);
+				for (size_type i = 0; i < s->count; ++i)
+					f(s->children[i]);
+				break;
+			}
+			case node16_type: {
+				node16 *s = static_cast<node16 *>(n);
+				for (size_type i = 0; i < s->count; ++i)
+					f(s->children[i]);
+				break;
+			}
+			case node48_type: {
+				node48 *s = static_cast<node48 *>(n);
+				for (size_type b = 0; b < 256; ++b) {
+					uint8_t j = s->child_index[b];
+					if (j != 0)
+						f(s->children[j - 1]);
+				}
+				break;
+			}
+			default: {
+				node256 *s = static_cast<node256 *>(n);
+				for (size_type b = 0; b < 256; ++b)
+					if (s->children[b] != nullptr)
+						f(s->children[b]);
+			}
+		}
+	}
+
+	template <typename F>
+	static void
+	visit(node_base *nb, F &f)
+	{
+		if (nb == nullptr)
+			return;
+
+		if (nb->type == leaf_type) {
+			leaf *l = static_cast<leaf *>(nb);
+			const mapped_type &value = l->value;
+			f(l->key.cdata(), l->key.size(), value);
+			return;
+		}
+
+		inner *n = static_cast<inner *>(nb);
+		visit(n->value.get(), f);
+		for_each_child(n, [&](persistent_ptr<node_base> &c) {
+			visit(c.get(), f);
+		});
+	}
+
+	persistent_ptr<node_base>
+	make_leaf(const char *key, size_type len, const mapped_type &value)
+	{
+		return make_persistent<leaf>(key, len, value);
+	}
+
+	/*
+	 * Stores the element l in the new node nn, either as its value if
+	 * its key ends at depth or as a child.
+	 */
+	static void
+	place(node4 *nn, const persistent_ptr<node_base> &l, const char *key,
+	      size_type len, size_type depth)
+	{
+		if (len == depth)
+			nn->value = cast<leaf>(l);
+		else
+			sorted_insert(nn, byte_at(key, depth), l);
+	}
+
+	/*
+	 * Replaces the leaf l stored in ref by a node4 holding both l and
+	 * a new element, with the common part of their keys as the prefix.
+	 */
+	void
+	split_leaf(persistent_ptr<node_base> &ref, leaf *l, const char *key,
+		   size_type len, size_type depth, const mapped_type &value)
+	{
+		const char *lkey = l->key.cdata();
+		size_type llen = l->key.size();
+		size_type end = depth;
+		while (end < llen && end < len && lkey[end] == key[end])
+			end++;
+
+		persistent_ptr<node4> nn = make_persistent<node4>();
+		nn->prefix_len = static_cast<uint32_t>(end - depth);
+		std::memcpy(nn->prefix, key + depth,
+			    (std::min)(end - depth, max_prefix_len));
+
+		place(nn.get(), ref, lkey, llen, end);
+		place(nn.get(), make_leaf(key, len, value), key, len, end);
+
+		ref = nn;
+	}
+
+	/*
+	 * Splits the prefix of the node n stored in ref after diff bytes,
+	 * putting a node4 holding n and a new element above n.
+	 */
+	void
+	split_prefix(persistent_ptr<node_base> &ref, inner *n, const char *key,
+		     size_type len, size_type depth, size_type diff,
+		     const mapped_type &value)
+	{
+		size_type plen = n->prefix_len;
+		size_type rest = plen - diff - 1;
+
+		persistent_ptr<node4> nn = make_persistent<node4>();
+		nn->prefix_len = static_cast<uint32_t>(diff);
+		std::memcpy(nn->prefix, n->prefix,
+			    (std::min)(diff, max_prefix_len));
+
+		uint8_t b;
+		detail::conditional_add_to_tx(&n->prefix);
+		if (plen <= max_prefix_len) {
+			b = n->prefix[diff];
+			std::memmove(n->prefix, n->prefix + diff + 1, rest);
+		} else {
+			const char *lkey = minimum(n)->key.cdata();
+			b = byte_at(lkey, depth + diff);
+			std::memcpy(n->prefix, lkey + depth + diff + 1,
+				    (std::min)(rest, max_prefix_len));
+		}
+		n->prefix_len = static_cast<uint32_t>(rest);
+
+		sorted_insert(nn.get(), b, ref);
+		place(nn.get(), make_leaf(key, len, value), key, len,
+		      depth + diff);
+
+		ref = nn;
+	}
+
+	static void
+	assign(leaf *l, const mapped_type &value)
+	{
+		detail::conditional_add_to_tx(&l->value);
+		l->value = value;
+	}
+
+	bool
+	insert(const char *key, size_type len, const mapped_type &value,
+	       bool assign_existing)
+	{
+		bool inserted = false;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			inserted = add(key, len, value, assign_existing);
+			if (inserted)
+				_size = _size + 1;
+		});
+
+		return inserted;
+	}
+
+	/*
+	 * Inserts or assigns an element, in a transaction.
+	 */
+	bool
+	add(const char *key, size_type len, const mapped_type &value,
+	    bool assign_existing)
+	{
+		persistent_ptr<node_base> *ref = &_root;
+		size_type depth = 0;
+
+		for (;;) {
+			if (*ref == nullptr) {
+				*ref = make_leaf(key, len, value);
+				return true;
+			}
+
+			node_base *nb = ref->get();
+			if (nb->type == leaf_type) {
+				leaf *l = static_cast<leaf *>(nb);
+				if (!matches(l, key, len)) {
+					split_leaf(*ref, l, key, len, depth,
+						   value);
+					return true;
+				}
+
+				if (assign_existing)
+					assign(l, value);
+				return false;
+			}
+
+			inner *n = static_cast<inner *>(nb);
+			if (n->prefix_len != 0) {
+				size_type diff =
+					prefix_mismatch(n, key, len, depth);
+				if (diff < n->prefix_len) {
+					split_prefix(*ref, n, key, len, depth,
+						     diff, value);
+					return true;
+				}
+
+				depth += n->prefix_len;
+			}
+
+			if (depth == len) {
+				if (n->value == nullptr) {
+					n->value = make_persistent<leaf>(
+						key, len, value);
+					return true;
+				}
+
+				if (assign_existing)
+					assign(n->value.get(), value);
+				return false;
+			}
+
+			uint8_t b = byte_at(key, depth);
+			persistent_ptr<node_base> *child = find_child(n, b);
+			if (child == nullptr) {
+				add_child(*ref, n, b,
+					  make_leaf(key, len, value));
+				return true;
+			}
+
+			ref = child;
+			depth++;
+		}
+	}
+
+	/*
+	 * Removes an element, in a transaction.
+	 */
+	bool
+	remove(const char *key, size_type len)
+	{
+		persistent_ptr<node_base> *ref = &_root;
+		size_type depth = 0;
+
+		if (_root == nullptr)
+			return false;
+
+		if (_root->type == leaf_type) {
+			leaf *l = static_cast<leaf *>(_root.get());
+			if (!matches(l, key, len))
+				return false;
+
+			free_node(_root);
+			_root = nullptr;
+			return true;
+		}
+
+		for (;;) {
+			inner *n = static_cast<inner *>(ref->get());
+			if (n->prefix_len != 0) {
+				if (!prefix_matches(n, key, len, depth))
+					return false;
+
+				depth += n->prefix_len;
+			}
+
+			if (depth == len) {
+				if (n->value == nullptr ||
+				    !matches(n->value.get(), key, len))
+					return false;
+
+				delete_persistent<leaf>(n->value);
+				n->value = nullptr;
+				if (n->type == node4_type)
+					collapse(*ref, static_cast<node4 *>(n));
+				return true;
+			}
+
+			uint8_t b = byte_at(key, depth);
+			persistent_ptr<node_base> *child = find_child(n, b);
+			if (child == nullptr)
+				return false;
+
+			if ((*child)->type == leaf_type) {
+				if (!matches(static_cast<leaf *>(child->get()),
+					     key, len))
+					return false;
+
+				free_node(*child);
+				remove_child(*ref, n, b);
+				return true;
+			}
+
+			ref = child;
+			depth++;
+		}
+	}
+
+	/*
+	 * Checks that the map resides in persistent memory and that there
+	 * is an active transaction.
+	 */
+	void
+	check_pmem_tx() const
+	{
+		if (pmemobj_pool_by_ptr(this) == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"Function called out of transaction scope.");
+	}
+
+	/*
+	 * Returns the pool in which the map resides.
+	 */
+	pool_base
+	get_pool() const
+	{
+		auto pop = pmemobj_pool_by_ptr(this);
+		if (pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		return pool_base(pop);
+	}
+
+	/* Root node, either a leaf or an inner node */
+	persistent_ptr<node_base> _root;
+
+	/* Number of elements */
+	p<size_type> _size;
+};
+
+template <typename T>
+constexpr typename art_map<T>::size_type art_map<T>::max_prefix_len;
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_ART_MAP_HPP */
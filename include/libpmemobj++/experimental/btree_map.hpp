@@ -0,0 +1,996 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Ordered map with persistent leaves and volatile inner nodes.
+ */
+
+#ifndef PMEMOBJ_BTREE_MAP_HPP
+#define PMEMOBJ_BTREE_MAP_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/make_persistent.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::btree_map - EXPERIMENTAL ordered map, a B+tree
+ * whose leaves live in persistent memory and whose inner nodes live in
+ * DRAM.
+ *
+ * The persistent part of the map is storage_type, a doubly linked list of
+ * leaves sorted by key, which has to be allocated with make_persistent.
+ * Each leaf keeps its elements sorted and starts with a cache line holding
+ * the number of elements and one byte fingerprint of every key, so a point
+ * lookup compares fingerprints first and usually reads only one element.
+ * Range scans read the leaves sequentially.
+ *
+ * btree_map itself is a volatile object which builds the inner nodes by a
+ * single pass over the leaves when it is constructed, e.g. after the pool
+ * is opened. Only one btree_map object at a time may be used to access
+ * a storage_type.
+ *
+ * Key and T have to be trivially copyable. Hash has to be consistent with
+ * the equivalence defined by Compare.
+ *
+ * Every modification is performed in its own transaction, after which the
+ * inner nodes are updated. Since the inner nodes are not part of the
+ * transaction, modifications cannot be called within an outer transaction.
+ */
+template <typename Key, typename T, typename Compare = std::less<Key>,
+	  typename Hash = std::hash<Key>>
+class btree_map {
+	static_assert(std::is_trivially_copyable<Key>::value,
+		      "Key has to be trivially copyable");
+	static_assert(std::is_trivially_copyable<T>::value,
+		      "T has to be trivially copyable");
+
+public:
+	/* Member types */
+	using key_type = Key;
+	using mapped_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+	using hasher = Hash;
+
+	/**
+	 * Element stored in the leaves.
+	 */
+	struct value_type {
+		key_type first;
+		mapped_type second;
+	};
+
+	/**
+	 * Maximal number of elements in a leaf.
+	 */
+	static constexpr size_type leaf_capacity = 32;
+
+	/**
+	 * Maximal number of keys in an inner node.
+	 */
+	static constexpr size_type inner_capacity = 32;
+
+private:
+	struct leaf {
+		leaf() : count(0)
+		{
+		}
+
+		/* first cache line */
+		size_type count;
+		uint8_t fingerprints[leaf_capacity];
+		persistent_ptr<leaf> next;
+
+		value_type entries[leaf_capacity];
+
+		persistent_ptr<leaf> prev;
+	};
+
+public:
+	/**
+	 * Persistent part of the map.
+	 */
+	class storage_type {
+	public:
+		/**
+		 * Constructs an empty map, with a single empty leaf.
+		 *
+		 * @pre must be called in transaction scope.
+		 *
+		 * @throw pmem::transaction_scope_error if called outside
+		 *	of an active transaction.
+		 * @throw pmem::transaction_alloc_error when allocating the
+		 *	leaf failed.
+		 */
+		storage_type() : size(0)
+		{
+			head = make_persistent<leaf>();
+		}
+
+		/**
+		 * Destructor. Frees all leaves.
+		 *
+		 * @pre must be called in transaction scope.
+		 */
+		~storage_type()
+		{
+			while (head != nullptr) {
+				persistent_ptr<leaf> l = head;
+				head = l->next;
+				delete_persistent<leaf>(l);
+			}
+		}
+
+		storage_type(const storage_type &) = delete;
+		storage_type &operator=(const storage_type &) = delete;
+
+	private:
+		friend class btree_map;
+
+		/* First leaf, never removed */
+		persistent_ptr<leaf> head;
+
+		/* Number of elements */
+		p<size_type> size;
+	};
+
+	/**
+	 * Forward iterator over the elements, in key order.
+	 */
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = typename btree_map::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = const value_type &;
+		using pointer = const value_type *;
+
+		/**
+		 * Constructs end iterator.
+		 */
+		const_iterator() : l(nullptr), idx(0)
+		{
+		}
+
+		reference operator*() const
+		{
+			return l->entries[idx];
+		}
+
+		pointer operator->() const
+		{
+			return &l->entries[idx];
+		}
+
+		const_iterator &operator++()
+		{
+			++idx;
+			skip_empty();
+
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator tmp(*this);
+			++(*this);
+
+			return tmp;
+		}
+
+		bool
+		operator==(const const_iterator &rhs) const
+		{
+			return l == rhs.l && idx == rhs.idx;
+		}
+
+		bool
+		operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+
+	private:
+		friend class btree_map;
+
+		const_iterator(const leaf *l, size_type idx) : l(l), idx(idx)
+		{
+			skip_empty();
+		}
+
+		/*
+		 * Moves to the next leaf if the end of the current one was
+		 * reached.
+		 */
+		void
+		skip_empty()
+		{
+			while (l != nullptr && idx >= l->count) {
+				l = l->next.get();
+				idx = 0;
+			}
+		}
+
+		const leaf *l;
+		size_type idx;
+	};
+
+	using iterator = const_iterator;
+
+	/**
+	 * Opens the map stored in storage and builds its inner nodes.
+	 *
+	 * @throw pmem::pool_error if storage is nullptr.
+	 */
+	explicit btree_map(persistent_ptr<storage_type> storage,
+			   const Compare &comp = Compare(),
+			   const Hash &hash = Hash())
+	    : _storage(storage), _comp(comp), _hash(hash), _root(nullptr),
+	      _height(0)
+	{
+		if (_storage == nullptr)
+			throw pool_error("Invalid storage.");
+
+		build();
+	}
+
+	/**
+	 * Destructor. Frees the inner nodes, the persistent part is left
+	 * intact.
+	 */
+	~btree_map()
+	{
+		free_inner(_root, _height);
+	}
+
+	btree_map(const btree_map &) = delete;
+	btree_map &operator=(const btree_map &) = delete;
+
+	/**
+	 * Returns the number of elements.
+	 */
+	size_type
+	size() const noexcept
+	{
+		return _storage->size;
+	}
+
+	/**
+	 * Checks whether the map is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * Returns an iterator to the smallest element.
+	 */
+	const_iterator
+	begin() const
+	{
+		return const_iterator(_storage->head.get(), 0);
+	}
+
+	/**
+	 * Returns an iterator past the largest element.
+	 */
+	const_iterator
+	end() const
+	{
+		return const_iterator();
+	}
+
+	/**
+	 * Returns an iterator to the element with the given key, or end().
+	 * Compares fingerprints before comparing the keys.
+	 */
+	const_iterator
+	find(const key_type &key) const
+	{
+		const leaf *l = find_leaf(key, nullptr);
+		size_type idx = find_in_leaf(l, key);
+
+		if (idx == l->count)
+			return end();
+
+		return const_iterator(l, idx);
+	}
+
+	/**
+	 * Returns the number of elements with the given key, either 0 or 1.
+	 */
+	size_type
+	count(const key_type &key) const
+	{
+		const leaf *l = find_leaf(key, nullptr);
+
+		return find_in_leaf(l, key) == l->count ? 0 : 1;
+	}
+
+	/**
+	 * Returns an iterator to the first element whose key is not less
+	 * than key.
+	 */
+	const_iterator
+	lower_bound(const key_type &key) const
+	{
+		const leaf *l = find_leaf(key, nullptr);
+
+		return const_iterator(l, leaf_lower_bound(l, key));
+	}
+
+	/**
+	 * Returns an iterator to the first element whose key is greater
+	 * than key.
+	 */
+	const_iterator
+	upper_bound(const key_type &key) const
+	{
+		const leaf *l = find_leaf(key, nullptr);
+		const value_type *e = l->entries;
+
+		auto it = std::upper_bound(
+			e, e + l->count, key,
+			[&](const key_type &k, const value_type &v) {
+				return _comp(k, v.first);
+			});
+
+		return const_iterator(l, static_cast<size_type>(it - e));
+	}
+
+	/**
+	 * Inserts key with value, unless the key is already present.
+	 *
+	 * @return true if the element was inserted.
+	 *
+	 * @throw pmem::transaction_scope_error if called within a
+	 *	transaction.
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a new leaf
+	 *	failed.
+	 */
+	bool
+	insert(const key_type &key, const mapped_type &value)
+	{
+		return insert(key, value, false);
+	}
+
+	/**
+	 * Inserts key with value or replaces the value if the key is
+	 * already present.
+	 *
+	 * @return true if the element was inserted, false if assigned.
+	 *
+	 * @throw pmem::transaction_scope_error if called within a
+	 *	transaction.
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a new leaf
+	 *	failed.
+	 */
+	bool
+	insert_or_assign(const key_type &key, const mapped_type &value)
+	{
+		return insert(key, value, true);
+	}
+
+	/**
+	 * Removes the element with the given key. A leaf which becomes
+	 * empty is freed, unless it is the first one.
+	 *
+	 * @return number of removed elements, either 0 or 1.
+	 *
+	 * @throw pmem::transaction_scope_error if called within a
+	 *	transaction.
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_free_error when freeing a leaf failed.
+	 */
+	size_type
+	erase(const key_type &key)
+	{
+		check_tx_stage();
+
+		std::vector<path_entry> path;
+		leaf *l = find_leaf(key, &path);
+		size_type idx = find_in_leaf(l, key);
+
+		if (idx == l->count)
+			return 0;
+
+		bool remove_leaf = l->count == 1 && l->prev != nullptr;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (remove_leaf) {
+				unlink(l);
+			} else {
+				snapshot_leaf(l, idx, l->count);
+				std::memmove(&l->entries[idx],
+					     &l->entries[idx + 1],
+					     (l->count - idx - 1) *
+						     sizeof(value_type));
+				std::memmove(&l->fingerprints[idx],
+					     &l->fingerprints[idx + 1],
+					     l->count - idx - 1);
+				l->count--;
+			}
+
+			_storage->size = _storage->size - 1;
+		});
+
+		if (remove_leaf)
+			remove_child(path);
+
+		return 1;
+	}
+
+	/**
+	 * Removes all elements and frees all leaves but the first one.
+	 *
+	 * @throw pmem::transaction_scope_error if called within a
+	 *	transaction.
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_free_error when freeing a leaf failed.
+	 */
+	void
+	clear()
+	{
+		check_tx_stage();
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			persistent_ptr<leaf> head = _storage->head;
+
+			while (head->next != nullptr)
+				unlink(head->next.get());
+
+			detail::conditional_add_to_tx(&head->count);
+			head->count = 0;
+			_storage->size = 0;
+		});
+
+		/* only the head is left, the index needs no allocation */
+		free_inner(_root, _height);
+		_root = _storage->head.get();
+		_height = 0;
+	}
+
+private:
+	struct inner_node {
+		inner_node() : count(0)
+		{
+		}
+
+		/* Number of keys, the node has count + 1 children */
+		size_type count;
+		key_type keys[inner_capacity];
+		void *children[inner_capacity + 1];
+	};
+
+	/* Inner node visited on the way to a leaf and the taken child */
+	using path_entry = std::pair<inner_node *, size_type>;
+
+	/*
+	 * Throws if called within a transaction, which could roll back the
+	 * leaves without rolling back the inner nodes.
+	 */
+	static void
+	check_tx_stage()
+	{
+		if (pmemobj_tx_stage() != TX_STAGE_NONE)
+			throw transaction_scope_error(
+				"btree_map cannot be modified within a "
+				"transaction");
+	}
+
+	pool_base
+	get_pool() const
+	{
+		return pool_base(pmemobj_pool_by_oid(_storage.raw()));
+	}
+
+	bool
+	equal(const key_type &lhs, const key_type &rhs) const
+	{
+		return !_comp(lhs, rhs) && !_comp(rhs, lhs);
+	}
+
+	uint8_t
+	fingerprint(const key_type &key) const
+	{
+		uint64_t h = static_cast<uint64_t>(_hash(key));
+
+		/* use the high bits, identity hashes differ in the low ones */
+		return static_cast<uint8_t>((h * 0x9E3779B97F4A7C15ULL) >> 56);
+	}
+
+	/*
+	 * Descends the inner nodes to the leaf which may hold key,
+	 * optionally recording the path.
+	 */
+	leaf *
+	find_leaf(const key_type &key, std::vector<path_entry> *path) const
+	{
+		void *node = _root;
+
+		for (size_type level = _height; level > 0; --level) {
+			inner_node *n = static_cast<inner_node *>(node);
+			auto it = std::upper_bound(n->keys, n->keys + n->count,
+						   key, _comp);
+			size_type idx = static_cast<size_type>(it - n->keys);
+
+			if (path)
+				path->emplace_back(n, idx);
+
+			node = n->children[idx];
+		}
+
+		return static_cast<leaf *>(node);
+	}
+
+	/*
+	 * Returns index of key within the leaf, or l->count if it's not
+	 * there.
+	 */
+	size_type
+	find_in_leaf(const leaf *l, const key_type &key) const
+	{
+		uint8_t fp = fingerprint(key);
+
+		for (size_type i = 0; i < l->count; ++i) {
+			if (l->fingerprints[i] == fp &&
+			    equal(l->entries[i].first, key))
+				return i;
+		}
+
+		return l->count;
+	}
+
+	size_type
+	leaf_lower_bound(const leaf *l, const key_type &key) const
+	{
+		const value_type *e = l->entries;
+
+		auto it = std::lower_bound(
+			e, e + l->count, key,
+			[&](const value_type &v, const key_type &k) {
+				return _comp(v.first, k);
+			});
+
+		return static_cast<size_type>(it - e);
+	}
+
+	/*
+	 * Adds the header of the leaf (the count and the fingerprints) and
+	 * the elements [first, last) to the transaction.
+	 */
+	void
+	snapshot_leaf(leaf *l, size_type first, size_type last)
+	{
+		detail::conditional_add_to_tx(&l->count);
+		detail::conditional_add_to_tx(&l->fingerprints);
+		detail::conditional_add_to_tx(&l->entries[first],
+					      last - first);
+	}
+
+	/*
+	 * Inserts an element at idx of a leaf which is not full, in a
+	 * transaction.
+	 */
+	void
+	leaf_insert(leaf *l, size_type idx, const key_type &key,
+		    const mapped_type &value)
+	{
+		std::memmove(&l->entries[idx + 1], &l->entries[idx],
+			     (l->count - idx) * sizeof(value_type));
+		std::memmove(&l->fingerprints[idx + 1], &l->fingerprints[idx],
+			     l->count - idx);
+
+		l->entries[idx].first = key;
+		l->entries[idx].second = value;
+		l->fingerprints[idx] = fingerprint(key);
+		l->count++;
+	}
+
+	bool
+	insert(const key_type &key, const mapped_type &value, bool assign)
+	{
+		check_tx_stage();
+
+		std::vector<path_entry> path;
+		leaf *l = find_leaf(key, &path);
+		size_type idx = leaf_lower_bound(l, key);
+
+		if (idx < l->count && equal(l->entries[idx].first, key)) {
+			if (!assign)
+				return false;
+
+			pool_base pb = get_pool();
+			transaction::exec_tx(pb, [&] {
+				detail::conditional_add_to_tx(
+					&l->entries[idx].second);
+				l->entries[idx].second = value;
+			});
+
+			return false;
+		}
+
+		leaf *right = nullptr;
+
+		/*
+		 * The inner nodes for the splits caused by a split of the
+		 * leaf are allocated up front, once the leaf is committed
+		 * the index has to be updated without failing.
+		 */
+		std::vector<std::unique_ptr<inner_node>> spares;
+		if (l->count == leaf_capacity)
+			spares = spare_nodes(path);
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (l->count < leaf_capacity) {
+				/* the slot past the last element is included */
+				snapshot_leaf(l, idx, l->count + 1);
+				leaf_insert(l, idx, key, value);
+			} else {
+				right = split(l);
+
+				if (idx > l->count)
+					leaf_insert(right, idx - l->count, key,
+						    value);
+				else
+					leaf_insert(l, idx, key, value);
+			}
+
+			_storage->size = _storage->size + 1;
+		});
+
+		if (right != nullptr)
+			insert_child(path, right->entries[0].first, right,
+				     spares);
+
+		return true;
+	}
+
+	/*
+	 * Moves the upper half of a full leaf to a new leaf linked after
+	 * it, in a transaction. The whole old leaf is snapshotted, as
+	 * a new element is going to be inserted into one of them.
+	 */
+	leaf *
+	split(leaf *l)
+	{
+		persistent_ptr<leaf> right = make_persistent<leaf>();
+		size_type half = leaf_capacity / 2;
+
+		detail::conditional_add_to_tx(l);
+
+		std::memcpy(right->entries, &l->entries[half],
+			    (leaf_capacity - half) * sizeof(value_type));
+		std::memcpy(right->fingerprints, &l->fingerprints[half],
+			    leaf_capacity - half);
+		right->count = leaf_capacity - half;
+		l->count = half;
+
+		right->next = l->next;
+		right->prev = l->prev == nullptr
+			? _storage->head
+			: l->prev->next;
+		if (l->next != nullptr)
+			l->next->prev = right;
+		l->next = right;
+
+		return right.get();
+	}
+
+	/*
+	 * Unlinks a leaf from the list and frees it, in a transaction.
+	 */
+	void
+	unlink(leaf *l)
+	{
+		persistent_ptr<leaf> prev = l->prev;
+		persistent_ptr<leaf> self = prev->next;
+
+		prev->next = l->next;
+		if (l->next != nullptr)
+			l->next->prev = prev;
+
+		delete_persistent<leaf>(self);
+	}
+
+	/*
+	 * Allocates the inner nodes needed by insert_child to insert
+	 * a child at the end of the path: one for each full node at the
+	 * bottom of the path, and one for the new root if all of them are.
+	 */
+	static std::vector<std::unique_ptr<inner_node>>
+	spare_nodes(const std::vector<path_entry> &path)
+	{
+		size_type n = 1;
+		for (auto it = path.rbegin(); it != path.rend(); ++it) {
+			if (it->first->count < inner_capacity)
+				break;
+			n++;
+		}
+
+		std::vector<std::unique_ptr<inner_node>> spares;
+		spares.reserve(n);
+		for (size_type i = 0; i < n; ++i)
+			spares.emplace_back(new inner_node());
+
+		return spares;
+	}
+
+	/*
+	 * Takes one of the inner nodes allocated by spare_nodes.
+	 */
+	static inner_node *
+	take_spare(std::vector<std::unique_ptr<inner_node>> &spares) noexcept
+	{
+		assert(!spares.empty());
+
+		inner_node *n = spares.back().release();
+		spares.pop_back();
+
+		return n;
+	}
+
+	/*
+	 * Inserts a separator and the child following it into the inner
+	 * node at the end of the path, splitting full nodes on the way up.
+	 * The new nodes are taken from spares, so it does not fail.
+	 */
+	void
+	insert_child(std::vector<path_entry> &path, key_type key, void *child,
+		     std::vector<std::unique_ptr<inner_node>> &spares) noexcept
+	{
+		while (!path.empty()) {
+			inner_node *n = path.back().first;
+			size_type idx = path.back().second;
+			path.pop_back();
+
+			if (n->count < inner_capacity) {
+				inner_insert(n, idx, key, child);
+				return;
+			}
+
+			/* split the node, promoting its middle key */
+			inner_node *right = take_spare(spares);
+			size_type half = inner_capacity / 2;
+
+			right->count = inner_capacity - half - 1;
+			std::copy(n->keys + half + 1, n->keys + inner_capacity,
+				  right->keys);
+			std::copy(n->children + half + 1,
+				  n->children + inner_capacity + 1,
+				  right->children);
+			n->count = half;
+
+			key_type promoted = n->keys[half];
+
+			if (idx > half)
+				inner_insert(right, idx - half - 1, key, child);
+			else
+				inner_insert(n, idx, key, child);
+
+			key = promoted;
+			child = right;
+		}
+
+		/* the root was split */
+		inner_node *root = take_spare(spares);
+		root->count = 1;
+		root->keys[0] = key;
+		root->children[0] = _root;
+		root->children[1] = child;
+
+		_root = root;
+		_height++;
+	}
+
+	/*
+	 * Inserts key and the child following it after child idx of a node
+	 * which is not full.
+	 */
+	static void
+	inner_insert(inner_node *n, size_type idx, const key_type &key,
+		     void *child)
+	{
+		std::copy_backward(n->keys + idx, n->keys + n->count,
+				   n->keys + n->count + 1);
+		std::copy_backward(n->children + idx + 1,
+				   n->children + n->count + 1,
+				   n->children + n->count + 2);
+
+		n->keys[idx] = key;
+		n->children[idx + 1] = child;
+		n->count++;
+	}
+
+	/*
+	 * Removes the child at the end of the path, along with inner nodes
+	 * which are left without children. It only frees memory, so it
+	 * does not fail once the leaf was freed.
+	 */
+	void
+	remove_child(std::vector<path_entry> &path) noexcept
+	{
+		while (!path.empty()) {
+			inner_node *n = path.back().first;
+			size_type idx = path.back().second;
+			path.pop_back();
+
+			if (n->count == 0) {
+				/* the only child is gone, remove the node */
+				delete n;
+				continue;
+			}
+
+			size_type key_idx = idx == 0 ? 0 : idx - 1;
+
+			std::copy(n->keys + key_idx + 1, n->keys + n->count,
+				  n->keys + key_idx);
+			std::copy(n->children + idx + 1,
+				  n->children + n->count + 1,
+				  n->children + idx);
+			n->count--;
+
+			break;
+		}
+
+		/* shrink the tree while the root has a single child */
+		while (_height > 0) {
+			inner_node *root = static_cast<inner_node *>(_root);
+			if (root->count > 0)
+				break;
+
+			_root = root->children[0];
+			_height--;
+			delete root;
+		}
+	}
+
+	/*
+	 * Builds the inner nodes bottom-up from the list of leaves.
+	 */
+	void
+	build()
+	{
+		std::vector<std::pair<key_type, void *>> level;
+
+		for (leaf *l = _storage->head.get(); l != nullptr;
+		     l = l->next.get())
+			level.emplace_back(l->count ? l->entries[0].first
+						    : key_type(),
+					   l);
+
+		_height = 0;
+
+		while (level.size() > 1) {
+			std::vector<std::pair<key_type, void *>> upper;
+
+			for (size_type i = 0; i < level.size();) {
+				size_type n = (std::min)(inner_capacity + 1,
+							 level.size() - i);
+
+				/* do not leave a single child for the last */
+				if (level.size() - i - n == 1)
+					n--;
+
+				inner_node *node = new inner_node();
+				node->count = n - 1;
+				for (size_type j = 0; j < n; ++j) {
+					node->children[j] = level[i + j].second;
+					if (j > 0)
+						node->keys[j - 1] =
+							level[i + j].first;
+				}
+
+				upper.emplace_back(level[i].first, node);
+				i += n;
+			}
+
+			level.swap(upper);
+			_height++;
+		}
+
+		_root = level[0].second;
+	}
+
+	static void
+	free_inner(void *node, size_type height)
+	{
+		if (height == 0)
+			return;
+
+		inner_node *n = static_cast<inner_node *>(node);
+		for (size_type i = 0; i <= n->count; ++i)
+			free_inner(n->children[i], height - 1);
+
+		delete n;
+	}
+
+	persistent_ptr<storage_type> _storage;
+	Compare _comp;
+	Hash _hash;
+
+	/* Root inner node or, if _height is 0, the only leaf */
+	void *_root;
+
+	/* Number of levels of inner nodes */
+	size_type _height;
+};
+
+template <typename Key, typename T, typename Compare, typename Hash>
+constexpr typename btree_map<Key, T, Compare, Hash>::size_type
+	btree_map<Key, T, Compare, Hash>::leaf_capacity;
+
+template <typename Key, typename T, typename Compare, typename Hash>
+constexpr typename btree_map<Key, T, Compare, Hash>::size_type
+	btree_map<Key, T, Compare, Hash>::inner_capacity;
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_BTREE_MAP_HPP */
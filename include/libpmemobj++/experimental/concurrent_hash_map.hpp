@@ -0,0 +1,754 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Concurrent hash map with lock striping and incremental rehashing.
+ */
+
+#ifndef PMEMOBJ_CONCURRENT_HASH_MAP_HPP
+#define PMEMOBJ_CONCURRENT_HASH_MAP_HPP
+
+#include <functional>
+#include <mutex>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/make_persistent.hpp"
+#include "libpmemobj++/make_persistent_array.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/shared_mutex.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::concurrent_hash_map - EXPERIMENTAL persistent
+ * hash map which can be safely used by many threads.
+ *
+ * The map must reside in persistent memory, i.e. it has to be created
+ * with make_persistent or be a member of an object which was. Key and T
+ * have to be types which can be placed in persistent memory.
+ *
+ * Buckets are protected by lock_count stripes of pmem::obj::shared_mutex,
+ * a bucket belongs to the stripe selected by the hash of its keys. Lookups
+ * take the stripe's lock in shared mode, so they never wait for each other,
+ * modifications take it exclusively for the duration of their transaction.
+ * The locks are kept in persistent memory, but like all pmem locks they are
+ * reinitialized lazily on first use after the pool is opened, so opening
+ * the pool does not have to visit them.
+ *
+ * When the number of elements exceeds the number of buckets, a new, twice
+ * as large bucket table is allocated. Elements are not moved all at once,
+ * instead every modification migrates a couple of the old buckets of its
+ * stripe within its own transaction, which makes the rehashing both
+ * incremental and crash-safe. Only swapping the tables requires all
+ * stripes to be locked.
+ *
+ * Modifications called within an outer transaction keep the lock until
+ * that transaction ends, so locking order of such a transaction is the
+ * caller's responsibility. Growing the table is only started by
+ * modifications called outside of a transaction.
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+	  typename KeyEqual = std::equal_to<Key>>
+class concurrent_hash_map {
+public:
+	/* Member types */
+	using key_type = Key;
+	using mapped_type = T;
+	using size_type = std::size_t;
+	using hasher = Hash;
+	using key_equal = KeyEqual;
+
+	/**
+	 * Number of lock stripes, also the minimal number of buckets.
+	 */
+	static constexpr size_type lock_count = 64;
+
+	/**
+	 * Number of old buckets migrated by a single modification while
+	 * the map is being rehashed.
+	 */
+	static constexpr size_type rehash_batch = 2;
+
+	/**
+	 * Constructs an empty map with at least bucket_count buckets.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the map doesn't reside in persistent
+	 *	memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory for
+	 *	the buckets failed.
+	 */
+	explicit concurrent_hash_map(size_type bucket_count = lock_count)
+	    : _bucket_count(lock_count), _old_bucket_count(0)
+	{
+		if (pmemobj_pool_by_ptr(this) == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"Function called out of transaction scope.");
+
+		size_type n = lock_count;
+		while (n < bucket_count)
+			n <<= 1;
+
+		_table = make_persistent<bucket_type[]>(n);
+		_bucket_count = n;
+	}
+
+	/**
+	 * Destructor. Frees all elements and buckets.
+	 *
+	 * Should be called within a transaction (e.g. by
+	 * delete_persistent), otherwise a new one is started.
+	 */
+	~concurrent_hash_map()
+	{
+		try {
+			pool_base pb = get_pool();
+			transaction::exec_tx(pb, [&] {
+				free_table(_old_table, _old_bucket_count);
+				free_table(_table, _bucket_count);
+			});
+		} catch (...) {
+			std::terminate();
+		}
+	}
+
+	/**
+	 * Deleted copy constructor.
+	 */
+	concurrent_hash_map(const concurrent_hash_map &) = delete;
+
+	/**
+	 * Deleted assignment operator.
+	 */
+	concurrent_hash_map &operator=(const concurrent_hash_map &) = delete;
+
+	/**
+	 * Inserts key with value, unless the key is already present.
+	 *
+	 * @return true if the element was inserted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory for
+	 *	the element failed.
+	 */
+	bool
+	insert(const key_type &key, const mapped_type &value)
+	{
+		return modify(key, [&](bucket_type &bucket, node_ptr *n) {
+			if (*n != nullptr)
+				return 0;
+
+			bucket = make_persistent<node>(hash(key), key, value,
+						       bucket);
+			return 1;
+		}) > 0;
+	}
+
+	/**
+	 * Inserts key with value or replaces the value if the key is
+	 * already present.
+	 *
+	 * @return true if the element was inserted, false if assigned.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory for
+	 *	the element failed.
+	 */
+	bool
+	insert_or_assign(const key_type &key, const mapped_type &value)
+	{
+		return modify(key, [&](bucket_type &bucket, node_ptr *n) {
+			if (*n != nullptr) {
+				detail::conditional_add_to_tx(&(*n)->value);
+				(*n)->value = value;
+
+				return 0;
+			}
+
+			bucket = make_persistent<node>(hash(key), key, value,
+						       bucket);
+			return 1;
+		}) > 0;
+	}
+
+	/**
+	 * Calls f with a reference to the value mapped to key, which is
+	 * added to the transaction first. The stripe stays locked while f
+	 * is running.
+	 *
+	 * @return true if the key was found.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw rethrows any exception thrown by f, after the transaction
+	 *	is aborted.
+	 */
+	template <typename F>
+	bool
+	update(const key_type &key, F f)
+	{
+		bool found = false;
+
+		modify(key, [&](bucket_type &, node_ptr *n) {
+			if (*n != nullptr) {
+				detail::conditional_add_to_tx(&(*n)->value);
+				f((*n)->value);
+				found = true;
+			}
+
+			return 0;
+		});
+
+		return found;
+	}
+
+	/**
+	 * Removes the element with the given key.
+	 *
+	 * @return true if the element was removed.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_free_error when freeing the element
+	 *	failed.
+	 */
+	bool
+	erase(const key_type &key)
+	{
+		return modify(key, [&](bucket_type &, node_ptr *n) {
+			if (*n == nullptr)
+				return 0;
+
+			node_ptr erased = *n;
+			*n = erased->next;
+			delete_persistent<node>(erased);
+
+			return -1;
+		}) < 0;
+	}
+
+	/**
+	 * Copies the value mapped to key into result.
+	 *
+	 * Outside of a transaction the stripe is locked in shared mode only.
+	 * Within a transaction it is locked exclusively until the
+	 * transaction ends, which also makes it safe to look up keys the
+	 * transaction has modified.
+	 *
+	 * @return true if the key was found.
+	 *
+	 * @throw pmem::lock_error when locking the stripe failed.
+	 * @throw pmem::transaction_error when adding the lock to the
+	 *	transaction failed.
+	 */
+	bool
+	find(const key_type &key, mapped_type &result) const
+	{
+		return lookup(key, [&](const node &n) { result = n.value; });
+	}
+
+	/**
+	 * Returns the number of elements with the given key, i.e. either 0
+	 * or 1.
+	 *
+	 * @throw pmem::lock_error when locking the stripe failed.
+	 * @throw pmem::transaction_error when adding the lock to the
+	 *	transaction failed.
+	 */
+	size_type
+	count(const key_type &key) const
+	{
+		return lookup(key, [](const node &) {}) ? 1 : 0;
+	}
+
+	/**
+	 * Returns the number of elements. While other threads modify the
+	 * map, the result is only an approximation.
+	 */
+	size_type
+	size() const noexcept
+	{
+		size_type ret = 0;
+
+		for (const stripe &s : _stripes)
+			ret += s.size;
+
+		return ret;
+	}
+
+	/**
+	 * Checks whether the map is empty. While other threads modify the
+	 * map, the result is only an approximation.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * Returns the number of buckets of the current table.
+	 */
+	size_type
+	bucket_count() const noexcept
+	{
+		return _bucket_count;
+	}
+
+	/**
+	 * Removes all elements. All stripes are locked for the duration of
+	 * the transaction.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_free_error when freeing the elements
+	 *	failed.
+	 */
+	void
+	clear()
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			lock_all();
+
+			free_table(_old_table, _old_bucket_count);
+
+			bucket_type *table = _table.get();
+			detail::conditional_add_to_tx(table, _bucket_count);
+			for (size_type i = 0; i < _bucket_count; ++i)
+				free_chain(table[i]);
+
+			for (stripe &s : _stripes) {
+				s.size = 0;
+				s.migrated = 0;
+			}
+		});
+	}
+
+private:
+	struct node;
+
+	using node_ptr = persistent_ptr<node>;
+	using bucket_type = node_ptr;
+
+	struct node {
+		node(size_type hash, const key_type &key,
+		     const mapped_type &value, node_ptr next)
+		    : next(next), hash(hash), key(key), value(value)
+		{
+		}
+
+		node_ptr next;
+		size_type hash;
+		key_type key;
+		mapped_type value;
+	};
+
+	/*
+	 * Lock and per-stripe counters, padded so that stripes used by
+	 * different threads do not share cache lines.
+	 */
+	struct stripe {
+		stripe() : size(0), migrated(0)
+		{
+		}
+
+		shared_mutex lock;
+
+		/* Number of elements in the stripe */
+		p<size_type> size;
+
+		/* Number of old buckets of the stripe already migrated */
+		p<size_type> migrated;
+
+		char padding[128 - sizeof(shared_mutex) -
+			     2 * sizeof(p<size_type>)];
+	};
+
+	/*
+	 * Shared lock guard, unlocks the stripe on scope exit.
+	 */
+	class shared_lock_guard {
+	public:
+		explicit shared_lock_guard(shared_mutex &m) : m(m)
+		{
+			m.lock_shared();
+		}
+
+		~shared_lock_guard()
+		{
+			m.unlock_shared();
+		}
+
+		shared_lock_guard(const shared_lock_guard &) = delete;
+		shared_lock_guard &
+		operator=(const shared_lock_guard &) = delete;
+
+	private:
+		shared_mutex &m;
+	};
+
+	static size_type
+	hash(const key_type &key)
+	{
+		return static_cast<size_type>(hasher()(key));
+	}
+
+	static bool
+	matches(const node_ptr &n, size_type h, const key_type &key)
+	{
+		return n->hash == h && key_equal()(n->key, key);
+	}
+
+	/*
+	 * Returns the pool in which the map resides.
+	 */
+	pool_base
+	get_pool() const
+	{
+		auto pop = pmemobj_pool_by_ptr(this);
+		if (pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		return pool_base(pop);
+	}
+
+	/*
+	 * Adds the lock to the active transaction, in which it is held
+	 * until the outermost transaction ends.
+	 */
+	static void
+	tx_lock(shared_mutex &m)
+	{
+		if (pmemobj_tx_lock(m.lock_type(), m.native_handle()) != 0)
+			throw transaction_error(
+				"failed to add a lock to the transaction");
+	}
+
+	/*
+	 * Locks all stripes, in order, until the end of the transaction.
+	 */
+	void
+	lock_all()
+	{
+		for (stripe &s : _stripes)
+			tx_lock(s.lock);
+	}
+
+	/*
+	 * Returns the bucket which holds elements with hash h. While the map
+	 * is being rehashed, this is the bucket of the old table, unless it
+	 * has been migrated already. The stripe of h must be locked.
+	 */
+	bucket_type &
+	get_bucket(size_type h) const
+	{
+		if (_old_table != nullptr) {
+			size_type ob = h & (_old_bucket_count - 1);
+
+			if (ob / lock_count < _stripes[h % lock_count].migrated)
+				return _table[static_cast<std::ptrdiff_t>(
+					h & (_bucket_count - 1))];
+
+			return _old_table[static_cast<std::ptrdiff_t>(ob)];
+		}
+
+		return _table[static_cast<std::ptrdiff_t>(h &
+							  (_bucket_count - 1))];
+	}
+
+	/*
+	 * Moves up to rehash_batch not yet migrated old buckets of the
+	 * stripe to the new table. Must be called in a transaction, with
+	 * the stripe locked.
+	 *
+	 * Returns true if the last old bucket of the stripe was migrated.
+	 */
+	bool
+	migrate(size_type stripe_idx)
+	{
+		if (_old_table == nullptr)
+			return false;
+
+		stripe &s = _stripes[stripe_idx];
+		size_type per_stripe = _old_bucket_count / lock_count;
+
+		if (s.migrated == per_stripe)
+			return false;
+
+		for (size_type i = 0;
+		     i < rehash_batch && s.migrated < per_stripe; ++i) {
+			migrate_bucket(stripe_idx + s.migrated * lock_count);
+			s.migrated = s.migrated + 1;
+		}
+
+		return s.migrated == per_stripe;
+	}
+
+	/*
+	 * Relinks all elements of the old bucket to the new table. The
+	 * elements themselves are neither copied nor rehashed.
+	 */
+	void
+	migrate_bucket(size_type idx)
+	{
+		bucket_type &old = _old_table[static_cast<std::ptrdiff_t>(idx)];
+
+		while (old != nullptr) {
+			node_ptr n = old;
+			bucket_type &b = _table[static_cast<std::ptrdiff_t>(
+				n->hash & (_bucket_count - 1))];
+
+			old = n->next;
+			n->next = b;
+			b = n;
+		}
+	}
+
+	/*
+	 * Runs f in a transaction holding the stripe's lock. f gets the
+	 * bucket of key and the link which points to the element matching
+	 * key, or to the nullptr ending the chain. f returns the change of
+	 * the number of elements. Afterwards grows the table or finishes
+	 * rehashing, if needed.
+	 */
+	template <typename F>
+	int
+	modify(const key_type &key, F f)
+	{
+		int diff = 0;
+		bool check_table = false;
+		size_type h = hash(key);
+		size_type stripe_idx = h % lock_count;
+		stripe &s = _stripes[stripe_idx];
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(
+			pb,
+			[&] {
+				check_table = migrate(stripe_idx);
+
+				bucket_type &bucket = get_bucket(h);
+				node_ptr *n = &bucket;
+				while (*n != nullptr && !matches(*n, h, key))
+					n = &(*n)->next;
+
+				diff = f(bucket, n);
+				if (diff > 0) {
+					s.size = s.size + 1;
+					check_table |= overloaded(s);
+				} else if (diff < 0) {
+					s.size = s.size - 1;
+				}
+			},
+			s.lock);
+
+		if (check_table && pmemobj_tx_stage() == TX_STAGE_NONE)
+			resize();
+
+		return diff;
+	}
+
+	/*
+	 * Finds the element matching key and calls f on it with the stripe
+	 * locked.
+	 */
+	template <typename F>
+	bool
+	lookup(const key_type &key, F f) const
+	{
+		size_type h = hash(key);
+		stripe &s = _stripes[h % lock_count];
+
+		if (pmemobj_tx_stage() == TX_STAGE_WORK) {
+			tx_lock(s.lock);
+
+			return find_and_call(h, key, f);
+		}
+
+		shared_lock_guard guard(s.lock);
+
+		return find_and_call(h, key, f);
+	}
+
+	template <typename F>
+	bool
+	find_and_call(size_type h, const key_type &key, F f) const
+	{
+		for (node_ptr n = get_bucket(h); n != nullptr; n = n->next) {
+			if (matches(n, h, key)) {
+				f(*n);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/*
+	 * Checks whether the stripe holds more elements than its share of
+	 * the buckets.
+	 */
+	bool
+	overloaded(const stripe &s) const
+	{
+		return s.size > _bucket_count / lock_count;
+	}
+
+	/*
+	 * With all stripes locked, frees the old table once all of its
+	 * buckets are migrated and starts rehashing into a twice as large
+	 * table if the map is overloaded. If it is overloaded while the
+	 * previous rehashing is still in progress, the remaining old
+	 * buckets are migrated at once.
+	 */
+	void
+	resize()
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			lock_all();
+
+			bool grow = size() > _bucket_count;
+
+			if (_old_table != nullptr) {
+				size_type per_stripe =
+					_old_bucket_count / lock_count;
+
+				for (size_type i = 0; i < lock_count; ++i) {
+					stripe &s = _stripes[i];
+
+					if (s.migrated < per_stripe && !grow)
+						return;
+
+					while (s.migrated < per_stripe) {
+						migrate_bucket(
+							i +
+							s.migrated *
+								lock_count);
+						s.migrated = s.migrated + 1;
+					}
+				}
+
+				delete_persistent<bucket_type[]>(
+					_old_table, _old_bucket_count);
+				_old_table = nullptr;
+				_old_bucket_count = 0;
+
+				for (stripe &s : _stripes)
+					s.migrated = 0;
+			}
+
+			if (!grow)
+				return;
+
+			_old_table = _table;
+			_old_bucket_count = _bucket_count;
+
+			_table = make_persistent<bucket_type[]>(2 *
+								_bucket_count);
+			_bucket_count = 2 * _bucket_count;
+		});
+	}
+
+	/*
+	 * Frees all elements of the chain and sets the bucket to nullptr.
+	 */
+	static void
+	free_chain(bucket_type &bucket)
+	{
+		while (bucket != nullptr) {
+			node_ptr n = bucket;
+			bucket = n->next;
+			delete_persistent<node>(n);
+		}
+	}
+
+	/*
+	 * Frees all elements of the table and the table itself.
+	 */
+	static void
+	free_table(persistent_ptr<bucket_type[]> &table, p<size_type> &count)
+	{
+		if (table == nullptr)
+			return;
+
+		for (size_type i = 0; i < count; ++i)
+			free_chain(table[static_cast<std::ptrdiff_t>(i)]);
+
+		delete_persistent<bucket_type[]>(table, count);
+		table = nullptr;
+		count = 0;
+	}
+
+	/* Current bucket table */
+	persistent_ptr<bucket_type[]> _table;
+	p<size_type> _bucket_count;
+
+	/* Bucket table being migrated to _table */
+	persistent_ptr<bucket_type[]> _old_table;
+	p<size_type> _old_bucket_count;
+
+	mutable stripe _stripes[lock_count];
+};
+
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+constexpr typename concurrent_hash_map<Key, T, Hash, KeyEqual>::size_type
+	concurrent_hash_map<Key, T, Hash, KeyEqual>::lock_count;
+
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+constexpr typename concurrent_hash_map<Key, T, Hash, KeyEqual>::size_type
+	concurrent_hash_map<Key, T, Hash, KeyEqual>::rehash_batch;
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_CONCURRENT_HASH_MAP_HPP */
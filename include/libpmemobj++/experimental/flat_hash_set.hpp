@@ -0,0 +1,704 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Persistent open-addressing hash set with metadata byte probing.
+ */
+
+#ifndef PMEMOBJ_FLAT_HASH_SET_HPP
+#define PMEMOBJ_FLAT_HASH_SET_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/make_persistent_array.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::flat_hash_set - EXPERIMENTAL persistent hash
+ * set which stores its keys inline in a single array.
+ *
+ * Every slot of the key array has a metadata byte in a separate array,
+ * which is either empty, deleted, or holds 7 bits of the hash of the key
+ * in the slot. Slots are probed in aligned groups of 16, whose metadata
+ * bytes are compared with the hash bits all at once with SSE2 where
+ * available, so a lookup usually reads one cache line of metadata and
+ * compares a single key. A group with an empty slot ends the probe
+ * sequence.
+ *
+ * The set must reside in persistent memory, i.e. it has to be created
+ * with make_persistent or be a member of an object which was. All
+ * methods which modify the set are performed in a transaction. A key is
+ * written to a free slot without snapshotting it, only the metadata byte
+ * is, so an abort makes the slot free again. Growing the set rehashes all
+ * keys into newly allocated arrays in one transaction, so a crash leaves
+ * either the old or the new table.
+ *
+ * Key has to be trivially copyable. Hash and KeyEqual are default
+ * constructed on every use, as they cannot be stored in the pool.
+ */
+template <typename Key, typename Hash = std::hash<Key>,
+	  typename KeyEqual = std::equal_to<Key>>
+class flat_hash_set {
+	static_assert(std::is_trivially_copyable<Key>::value,
+		      "Key has to be trivially copyable");
+
+public:
+	/* Member types */
+	using key_type = Key;
+	using value_type = Key;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using hasher = Hash;
+	using key_equal = KeyEqual;
+
+	/**
+	 * Number of slots probed at once.
+	 */
+	static constexpr size_type group_size = 16;
+
+	/**
+	 * Forward iterator over the keys.
+	 */
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Key;
+		using difference_type = std::ptrdiff_t;
+		using reference = const Key &;
+		using pointer = const Key *;
+
+		const_iterator() : set(nullptr), idx(0)
+		{
+		}
+
+		reference operator*() const
+		{
+			return set->_slots[static_cast<difference_type>(idx)];
+		}
+
+		pointer operator->() const
+		{
+			return &**this;
+		}
+
+		const_iterator &operator++()
+		{
+			++idx;
+			skip_free();
+
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator tmp(*this);
+			++(*this);
+
+			return tmp;
+		}
+
+		bool
+		operator==(const const_iterator &rhs) const
+		{
+			return idx == rhs.idx;
+		}
+
+		bool
+		operator!=(const const_iterator &rhs) const
+		{
+			return idx != rhs.idx;
+		}
+
+	private:
+		friend class flat_hash_set;
+
+		const_iterator(const flat_hash_set *set, size_type idx)
+		    : set(set), idx(idx)
+		{
+		}
+
+		void
+		skip_free()
+		{
+			size_type capacity = set->_capacity;
+			const uint8_t *ctrl = set->_ctrl.get();
+
+			while (idx < capacity && !is_full(ctrl[idx]))
+				++idx;
+		}
+
+		const flat_hash_set *set;
+		size_type idx;
+	};
+
+	using iterator = const_iterator;
+
+	/**
+	 * Constructs an empty set with a single group of slots.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the set doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating the table
+	 *	failed.
+	 */
+	flat_hash_set() : _size(0), _deleted(0), _capacity(0)
+	{
+		check_pmem_tx();
+
+		allocate(group_size);
+	}
+
+	/**
+	 * Destructor. Frees the table.
+	 */
+	~flat_hash_set()
+	{
+		try {
+			pool_base pb = get_pool();
+			transaction::exec_tx(pb, [&] { deallocate(); });
+		} catch (...) {
+			std::terminate();
+		}
+	}
+
+	flat_hash_set(const flat_hash_set &) = delete;
+	flat_hash_set &operator=(const flat_hash_set &) = delete;
+
+	/**
+	 * Returns the number of keys.
+	 */
+	size_type
+	size() const noexcept
+	{
+		return _size;
+	}
+
+	/**
+	 * Checks whether the set is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * Returns the number of slots.
+	 */
+	size_type
+	capacity() const noexcept
+	{
+		return _capacity;
+	}
+
+	/**
+	 * Returns an iterator to the first key.
+	 */
+	const_iterator
+	begin() const
+	{
+		const_iterator it(this, 0);
+		it.skip_free();
+
+		return it;
+	}
+
+	/**
+	 * Returns an iterator past the last key.
+	 */
+	const_iterator
+	end() const
+	{
+		return const_iterator(this, _capacity);
+	}
+
+	/**
+	 * Returns an iterator to the given key, or end().
+	 */
+	const_iterator
+	find(const key_type &key) const
+	{
+		return const_iterator(this, find_index(key, hash_of(key)));
+	}
+
+	/**
+	 * Returns the number of keys equal to key, either 0 or 1.
+	 */
+	size_type
+	count(const key_type &key) const
+	{
+		return find_index(key, hash_of(key)) == _capacity ? 0 : 1;
+	}
+
+	/**
+	 * Inserts key, unless it is already present.
+	 *
+	 * @return true if the key was inserted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a bigger
+	 *	table failed.
+	 */
+	bool
+	insert(const key_type &key)
+	{
+		uint64_t h = hash_of(key);
+		if (find_index(key, h) != _capacity)
+			return false;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			size_type used = _size + _deleted + 1;
+			if (used * 8 > _capacity * 7)
+				rehash_to(_deleted * 2 > _size
+						  ? _capacity.get_ro()
+						  : _capacity * 2);
+
+			size_type idx = find_free(h);
+			uint8_t *ctrl = _ctrl.get();
+
+			if (ctrl[idx] == ctrl_deleted)
+				_deleted = _deleted - 1;
+
+			/*
+			 * The slot is free, it is flushed, not snapshotted -
+			 * a slot freed in this transaction was snapshotted
+			 * by erase.
+			 */
+			Key *slot = &_slots.get()[idx];
+			std::memcpy(static_cast<void *>(slot), &key,
+				    sizeof(Key));
+			pb.flush(slot, sizeof(Key));
+
+			detail::conditional_add_to_tx(&ctrl[idx]);
+			ctrl[idx] = tag_of(h);
+			_size = _size + 1;
+		});
+
+		return true;
+	}
+
+	/**
+	 * Removes key.
+	 *
+	 * @return number of removed keys, either 0 or 1.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	size_type
+	erase(const key_type &key)
+	{
+		size_type idx = find_index(key, hash_of(key));
+		if (idx == _capacity)
+			return 0;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			uint8_t *ctrl = _ctrl.get();
+			size_type group = idx - idx % group_size;
+
+			detail::conditional_add_to_tx(&ctrl[idx]);
+
+			/*
+			 * The key itself stays in place, but a later insert
+			 * in the same transaction may reuse the slot with
+			 * only a flush, so it is snapshotted for the abort.
+			 */
+			detail::conditional_add_to_tx(&_slots.get()[idx]);
+
+			/*
+			 * No probe sequence went past a group with an empty
+			 * slot, so the slot can become empty too.
+			 */
+			if (match_empty(ctrl + group) != 0) {
+				ctrl[idx] = ctrl_empty;
+			} else {
+				ctrl[idx] = ctrl_deleted;
+				_deleted = _deleted + 1;
+			}
+
+			_size = _size - 1;
+		});
+
+		return 1;
+	}
+
+	/**
+	 * Removes all keys and shrinks the table to a single group.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating the table
+	 *	failed.
+	 */
+	void
+	clear()
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			deallocate();
+			allocate(group_size);
+			_size = 0;
+			_deleted = 0;
+		});
+	}
+
+	/**
+	 * Grows the table so that count keys fit without rehashing.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating a bigger
+	 *	table failed.
+	 */
+	void
+	reserve(size_type count)
+	{
+		size_type capacity = _capacity;
+		while (count * 8 > capacity * 7)
+			capacity *= 2;
+
+		if (capacity == _capacity)
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { rehash_to(capacity); });
+	}
+
+private:
+	/* Metadata of a slot which never held a key */
+	static constexpr uint8_t ctrl_empty = 0x00;
+
+	/* Metadata of a slot whose key was erased */
+	static constexpr uint8_t ctrl_deleted = 0x01;
+
+	/* Set in the metadata of a slot holding a key */
+	static constexpr uint8_t ctrl_full = 0x80;
+
+	static bool
+	is_full(uint8_t c) noexcept
+	{
+		return (c & ctrl_full) != 0;
+	}
+
+	static uint64_t
+	mix(uint64_t h) noexcept
+	{
+		return h * 0x9E3779B97F4A7C15ULL;
+	}
+
+	uint64_t
+	hash_of(const key_type &key) const
+	{
+		return mix(static_cast<uint64_t>(Hash()(key)));
+	}
+
+	static uint8_t
+	tag_of(uint64_t h) noexcept
+	{
+		return static_cast<uint8_t>(ctrl_full | (h >> 57));
+	}
+
+	static unsigned
+	lowest_bit(unsigned mask) noexcept
+	{
+#if defined(__GNUC__)
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+		unsigned i = 0;
+		while ((mask & 1) == 0) {
+			mask >>= 1;
+			i++;
+		}
+
+		return i;
+#endif
+	}
+
+	/*
+	 * Returns a bit mask of the slots in the group whose metadata is
+	 * equal to c.
+	 */
+	static unsigned
+	match(const uint8_t *group, uint8_t c) noexcept
+	{
+#if defined(__SSE2__)
+		__m128i g = _mm_loadu_si128(
+			reinterpret_cast<const __m128i *>(group));
+
+		__m128i t = _mm_set1_epi8(static_cast<char>(c));
+
+		return static_cast<unsigned>(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(g, t)));
+#else
+		unsigned mask = 0;
+		for (unsigned i = 0; i < group_size; ++i)
+			if (group[i] == c)
+				mask |= 1U << i;
+
+		return mask;
+#endif
+	}
+
+	static unsigned
+	match_empty(const uint8_t *group) noexcept
+	{
+		return match(group, ctrl_empty);
+	}
+
+	/*
+	 * Returns a bit mask of the slots in the group which are empty or
+	 * deleted.
+	 */
+	static unsigned
+	match_free(const uint8_t *group) noexcept
+	{
+#if defined(__SSE2__)
+		__m128i g = _mm_loadu_si128(
+			reinterpret_cast<const __m128i *>(group));
+
+		return ~static_cast<unsigned>(_mm_movemask_epi8(g)) & 0xFFFFU;
+#else
+		unsigned mask = 0;
+		for (unsigned i = 0; i < group_size; ++i)
+			if (!is_full(group[i]))
+				mask |= 1U << i;
+
+		return mask;
+#endif
+	}
+
+	/*
+	 * Returns the index of key, or the capacity if it is not present.
+	 * Groups are probed quadratically, which visits every group of
+	 * a table with a power of two groups.
+	 */
+	size_type
+	find_index(const key_type &key, uint64_t h) const
+	{
+		const uint8_t *ctrl = _ctrl.get();
+		const Key *slots = _slots.get();
+		size_type mask = _capacity / group_size - 1;
+		size_type g = static_cast<size_type>(h) & mask;
+		uint8_t tag = tag_of(h);
+
+		for (size_type step = 1;; ++step) {
+			const uint8_t *group = ctrl + g * group_size;
+
+			for (unsigned m = match(group, tag); m != 0;
+			     m &= m - 1) {
+				size_type idx = g * group_size + lowest_bit(m);
+				if (KeyEqual()(slots[idx], key))
+					return idx;
+			}
+
+			if (match_empty(group) != 0 || step > mask)
+				return _capacity;
+
+			g = (g + step) & mask;
+		}
+	}
+
+	/*
+	 * Returns the first empty or deleted slot in the probe sequence.
+	 */
+	size_type
+	find_free(uint64_t h) const noexcept
+	{
+		const uint8_t *ctrl = _ctrl.get();
+		size_type mask = _capacity / group_size - 1;
+		size_type g = static_cast<size_type>(h) & mask;
+
+		for (size_type step = 1;; ++step) {
+			unsigned m = match_free(ctrl + g * group_size);
+			if (m != 0)
+				return g * group_size + lowest_bit(m);
+
+			g = (g + step) & mask;
+		}
+	}
+
+	/*
+	 * Allocates an empty table, in a transaction.
+	 */
+	void
+	allocate(size_type capacity)
+	{
+		_ctrl = make_persistent<uint8_t[]>(capacity);
+		_slots = make_persistent<Key[]>(capacity);
+		_capacity = capacity;
+	}
+
+	/*
+	 * Frees the table, in a transaction.
+	 */
+	void
+	deallocate()
+	{
+		if (_ctrl == nullptr)
+			return;
+
+		delete_persistent<uint8_t[]>(_ctrl, _capacity);
+		delete_persistent<Key[]>(_slots, _capacity);
+		_ctrl = nullptr;
+		_slots = nullptr;
+		_capacity = 0;
+	}
+
+	/*
+	 * Moves all keys to a new table with capacity slots, in
+	 * a transaction. The new table is written without snapshots,
+	 * as it is allocated in the same transaction.
+	 */
+	void
+	rehash_to(size_type capacity)
+	{
+		persistent_ptr<uint8_t[]> old_ctrl = _ctrl;
+		persistent_ptr<Key[]> old_slots = _slots;
+		size_type old_capacity = _capacity;
+
+		_ctrl = make_persistent<uint8_t[]>(capacity);
+		_slots = make_persistent<Key[]>(capacity);
+		_capacity = capacity;
+
+		uint8_t *ctrl = _ctrl.get();
+		Key *slots = _slots.get();
+		for (size_type i = 0; i < old_capacity; ++i) {
+			if (!is_full(old_ctrl[static_cast<difference_type>(i)]))
+				continue;
+
+			const Key &key =
+				old_slots[static_cast<difference_type>(i)];
+			uint64_t h = hash_of(key);
+			size_type idx = find_free(h);
+
+			std::memcpy(static_cast<void *>(&slots[idx]), &key,
+				    sizeof(Key));
+			ctrl[idx] = tag_of(h);
+		}
+
+		_deleted = 0;
+
+		delete_persistent<uint8_t[]>(old_ctrl, old_capacity);
+		delete_persistent<Key[]>(old_slots, old_capacity);
+	}
+
+	/*
+	 * Checks that the set resides in persistent memory and that
+	 * there is an active transaction.
+	 */
+	void
+	check_pmem_tx() const
+	{
+		if (pmemobj_pool_by_ptr(this) == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"Function called out of transaction scope.");
+	}
+
+	/*
+	 * Returns the pool in which the set resides.
+	 */
+	pool_base
+	get_pool() const
+	{
+		auto pop = pmemobj_pool_by_ptr(this);
+		if (pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		return pool_base(pop);
+	}
+
+	/* Metadata byte of every slot */
+	persistent_ptr<uint8_t[]> _ctrl;
+
+	persistent_ptr<Key[]> _slots;
+
+	p<size_type> _size;
+
+	/* Number of deleted slots */
+	p<size_type> _deleted;
+
+	/* Number of slots, a multiple of group_size and a power of two */
+	p<size_type> _capacity;
+};
+
+template <typename Key, typename Hash, typename KeyEqual>
+constexpr typename flat_hash_set<Key, Hash, KeyEqual>::size_type
+	flat_hash_set<Key, Hash, KeyEqual>::group_size;
+
+template <typename Key, typename Hash, typename KeyEqual>
+constexpr uint8_t flat_hash_set<Key, Hash, KeyEqual>::ctrl_empty;
+
+template <typename Key, typename Hash, typename KeyEqual>
+constexpr uint8_t flat_hash_set<Key, Hash, KeyEqual>::ctrl_deleted;
+
+template <typename Key, typename Hash, typename KeyEqual>
+constexpr uint8_t flat_hash_set<Key, Hash, KeyEqual>::ctrl_full;
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_FLAT_HASH_SET_HPP */
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Executor committing transactions of many threads together.
+ */
+
+#ifndef PMEMOBJ_GROUP_COMMIT_HPP
+#define PMEMOBJ_GROUP_COMMIT_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::group_commit - EXPERIMENTAL executor which
+ * runs transactions submitted by many threads in batches.
+ *
+ * A worker thread takes all closures submitted since the previous batch,
+ * up to a limit, and runs them one after another in a single
+ * transaction, so that the cost of committing, and the final drain in
+ * particular, is shared by the whole batch. The submitter is notified
+ * through a future or a callback once its transaction is durable.
+ *
+ * The closures of a batch commit or abort together. If one of them
+ * throws, the batch is aborted and every closure is executed again in
+ * its own transaction, so that only the failing one reports the error.
+ * Closures may therefore run more than once and must not have volatile
+ * side effects which cannot be repeated. They run on the worker thread,
+ * in a transaction, and must neither commit nor end it; they should not
+ * block, as that delays the whole batch.
+ *
+ * All methods are thread-safe.
+ */
+class group_commit {
+public:
+	/**
+	 * Callback notified of the result of a transaction, with an empty
+	 * exception_ptr if it was committed.
+	 */
+	using callback_type = std::function<void(std::exception_ptr)>;
+
+	/**
+	 * Starts the worker thread.
+	 *
+	 * @param[in,out] pop the pool in which the transactions run.
+	 * @param[in] max_batch the maximum number of closures run in one
+	 *	transaction.
+	 *
+	 * @throw std::system_error if the thread could not be started.
+	 */
+	explicit group_commit(pool_base &pop, std::size_t max_batch = 64)
+	    : pop(pop), max_batch(max_batch == 0 ? 1 : max_batch),
+	      stopped(false)
+	{
+		worker = std::thread([this] { run(); });
+	}
+
+	/**
+	 * Commits all submitted transactions and stops the worker thread.
+	 */
+	~group_commit()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stopped = true;
+		}
+		cond.notify_one();
+		worker.join();
+	}
+
+	group_commit(const group_commit &) = delete;
+	group_commit &operator=(const group_commit &) = delete;
+
+	/**
+	 * Submits a transaction.
+	 *
+	 * @param[in] tx the closure to run in the transaction.
+	 *
+	 * @return future which becomes ready when the transaction is
+	 *	durable, or holds the exception which aborted it.
+	 */
+	std::future<void>
+	submit(std::function<void()> tx)
+	{
+		request r(std::move(tx));
+		auto f = r.promise.get_future();
+		push(std::move(r));
+
+		return f;
+	}
+
+	/**
+	 * Submits a transaction, calling done on the worker thread when
+	 * it is durable or was aborted.
+	 *
+	 * @param[in] tx the closure to run in the transaction.
+	 * @param[in] done the callback notified of the result.
+	 */
+	void
+	submit(std::function<void()> tx, callback_type done)
+	{
+		push(request(std::move(tx), std::move(done)));
+	}
+
+private:
+	struct request {
+		explicit request(std::function<void()> tx)
+		    : tx(std::move(tx))
+		{
+		}
+
+		request(std::function<void()> tx, callback_type done)
+		    : tx(std::move(tx)), done(std::move(done))
+		{
+		}
+
+		void
+		complete(std::exception_ptr err) noexcept
+		{
+			if (done) {
+				done(err);
+			} else if (err) {
+				promise.set_exception(err);
+			} else {
+				promise.set_value();
+			}
+		}
+
+		std::function<void()> tx;
+		callback_type done;
+		std::promise<void> promise;
+	};
+
+	void
+	push(request &&r)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			queue.push_back(std::move(r));
+		}
+		cond.notify_one();
+	}
+
+	/*
+	 * Worker thread, runs batches until stopped and the queue is empty.
+	 */
+	void
+	run()
+	{
+		std::vector<request> batch;
+
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cond.wait(lock, [this] {
+					return stopped || !queue.empty();
+				});
+
+				if (queue.empty())
+					return;
+
+				while (!queue.empty() &&
+				       batch.size() < max_batch) {
+					batch.push_back(
+						std::move(queue.front()));
+					queue.pop_front();
+				}
+			}
+
+			run_batch(batch);
+			batch.clear();
+		}
+	}
+
+	/*
+	 * Runs the batch in one transaction, or each closure in its own
+	 * transaction if the batch failed.
+	 */
+	void
+	run_batch(std::vector<request> &batch)
+	{
+		try {
+			transaction::exec_tx(pop, [&] {
+				for (auto &r : batch)
+					r.tx();
+			});
+		} catch (...) {
+			if (batch.size() == 1) {
+				batch[0].complete(std::current_exception());
+				return;
+			}
+
+			for (auto &r : batch) {
+				try {
+					transaction::exec_tx(pop, r.tx);
+				} catch (...) {
+					r.complete(std::current_exception());
+					continue;
+				}
+				r.complete(nullptr);
+			}
+
+			return;
+		}
+
+		for (auto &r : batch)
+			r.complete(nullptr);
+	}
+
+	pool_base pop;
+	std::size_t max_batch;
+
+	std::mutex mtx;
+	std::condition_variable cond;
+	std::deque<request> queue;
+	bool stopped;
+
+	std::thread worker;
+};
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_GROUP_COMMIT_HPP */
@@ -0,0 +1,359 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Bounded lock-free multi-producer multi-consumer persistent queue.
+ */
+
+#ifndef PMEMOBJ_MPMC_QUEUE_HPP
+#define PMEMOBJ_MPMC_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/experimental/array.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::mpmc_queue - EXPERIMENTAL bounded, lock-free
+ * persistent queue, which can be used by many producers and consumers
+ * concurrently.
+ *
+ * The queue is a ring buffer of N slots stored in an experimental::array.
+ * Every slot holds a sequence number, which tells whether the slot is
+ * waiting for a producer or for a consumer of a given position. Producers
+ * and consumers claim positions with a compare-and-swap on volatile
+ * counters and publish their slot by storing its sequence number, after
+ * which the slot is flushed and drained. No transactions or allocations
+ * are involved, so push and pop are not rolled back by an enclosing
+ * transaction.
+ *
+ * An element returned by try_pop is removed durably once try_pop returns,
+ * a crash before that may deliver it again after recovery. An element
+ * stored by try_push is durable once try_push returns.
+ *
+ * The counters are not persisted. After the pool is opened, recover() has
+ * to be called, before the queue is used by any thread.
+ *
+ * T has to be trivially copyable.
+ */
+template <typename T, std::size_t N>
+class mpmc_queue {
+	static_assert(std::is_trivially_copyable<T>::value,
+		      "T has to be trivially copyable");
+	static_assert(N >= 2, "mpmc_queue needs at least 2 slots");
+
+public:
+	/* Member types */
+	using value_type = T;
+	using size_type = std::size_t;
+
+	/**
+	 * Constructs an empty queue.
+	 *
+	 * @throw pmem::pool_error if the queue doesn't reside in persistent
+	 *	memory.
+	 */
+	mpmc_queue()
+	{
+		_pop = pmemobj_pool_by_ptr(this);
+		if (_pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		for (size_type i = 0; i < N; ++i)
+			_slots._data[i].seq.store(i, std::memory_order_relaxed);
+
+		_enqueue_pos.store(0, std::memory_order_relaxed);
+		_dequeue_pos.store(0, std::memory_order_relaxed);
+
+		pool_base pb(_pop);
+		pb.persist(&_slots, sizeof(_slots));
+	}
+
+	mpmc_queue(const mpmc_queue &) = delete;
+	mpmc_queue &operator=(const mpmc_queue &) = delete;
+
+	/**
+	 * Appends value to the queue, unless it is full. The value is
+	 * durable when the function returns.
+	 *
+	 * @return true if the value was appended, false if the queue was
+	 *	full.
+	 */
+	bool
+	try_push(const value_type &value) noexcept
+	{
+		uint64_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+		slot *s;
+
+		for (;;) {
+			s = &_slots._data[pos % N];
+			uint64_t seq = s->seq.load(std::memory_order_acquire);
+			auto dif = static_cast<int64_t>(seq - pos);
+
+			if (dif == 0) {
+				if (_enqueue_pos.compare_exchange_weak(
+					    pos, pos + 1,
+					    std::memory_order_relaxed))
+					break;
+			} else if (dif < 0) {
+				return false;
+			} else {
+				pos = _enqueue_pos.load(
+					std::memory_order_relaxed);
+			}
+		}
+
+		pool_base pb(_pop);
+
+		/* the value has to be durable before the slot is published */
+		s->value = value;
+		pb.flush(&s->value, sizeof(s->value));
+		pb.drain();
+
+		s->seq.store(pos + 1, std::memory_order_release);
+		pb.flush(&s->seq, sizeof(s->seq));
+		pb.drain();
+
+		return true;
+	}
+
+	/**
+	 * Removes the oldest value from the queue, unless it is empty.
+	 *
+	 * @param[out] value the removed value.
+	 *
+	 * @return true if a value was removed, false if the queue was empty.
+	 */
+	bool
+	try_pop(value_type &value) noexcept
+	{
+		uint64_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+		slot *s;
+
+		for (;;) {
+			s = &_slots._data[pos % N];
+			uint64_t seq = s->seq.load(std::memory_order_acquire);
+			auto dif = static_cast<int64_t>(seq - (pos + 1));
+
+			if (dif == 0) {
+				if (_dequeue_pos.compare_exchange_weak(
+					    pos, pos + 1,
+					    std::memory_order_relaxed))
+					break;
+			} else if (dif < 0) {
+				return false;
+			} else {
+				pos = _dequeue_pos.load(
+					std::memory_order_relaxed);
+			}
+		}
+
+		value = s->value;
+
+		pool_base pb(_pop);
+		s->seq.store(pos + N, std::memory_order_release);
+		pb.flush(&s->seq, sizeof(s->seq));
+		pb.drain();
+
+		return true;
+	}
+
+	/**
+	 * Restores the volatile state of the queue after the pool was
+	 * opened. Must not be called concurrently with other operations.
+	 *
+	 * A crash may leave slots of positions claimed by producers which
+	 * never published them between published ones. If that is the case,
+	 * the published values are moved together, in a transaction.
+	 *
+	 * @throw pmem::pool_error if the queue doesn't reside in persistent
+	 *	memory.
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	recover()
+	{
+		_pop = pmemobj_pool_by_ptr(this);
+		if (_pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		/* positions of published values, in order */
+		std::vector<std::pair<uint64_t, size_type>> full;
+		uint64_t base = UINT64_MAX;
+
+		for (size_type i = 0; i < N; ++i) {
+			uint64_t seq = _slots._data[i].seq.load(
+				std::memory_order_relaxed);
+
+			if ((seq - i) % N == 1)
+				full.emplace_back(seq - 1, i);
+			else
+				base = (std::min)(base, seq);
+		}
+
+		std::sort(full.begin(), full.end());
+		if (!full.empty())
+			base = full.front().first;
+
+		uint64_t count = full.size();
+
+		if (!consistent(base, count)) {
+			pool_base pb(_pop);
+			transaction::exec_tx(pb, [&] { compact(full, base); });
+		}
+
+		_dequeue_pos.store(base, std::memory_order_relaxed);
+		_enqueue_pos.store(base + count, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the number of slots.
+	 */
+	constexpr size_type
+	capacity() const noexcept
+	{
+		return N;
+	}
+
+	/**
+	 * Returns the number of values in the queue. While other threads
+	 * use the queue, the result is only an approximation.
+	 */
+	size_type
+	size() const noexcept
+	{
+		uint64_t deq = _dequeue_pos.load(std::memory_order_relaxed);
+		uint64_t enq = _enqueue_pos.load(std::memory_order_relaxed);
+
+		return enq > deq ? static_cast<size_type>(enq - deq) : 0;
+	}
+
+	/**
+	 * Checks whether the queue is empty. While other threads use the
+	 * queue, the result is only an approximation.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+private:
+	struct slot {
+		std::atomic<uint64_t> seq;
+		value_type value;
+	};
+
+	/*
+	 * Checks whether positions [base, base + count) hold published
+	 * values and all remaining slots wait for the following positions.
+	 */
+	bool
+	consistent(uint64_t base, uint64_t count) const
+	{
+		for (uint64_t pos = base; pos < base + N; ++pos) {
+			uint64_t seq = _slots._data[pos % N].seq.load(
+				std::memory_order_relaxed);
+			uint64_t expected = pos < base + count ? pos + 1 : pos;
+
+			if (seq != expected)
+				return false;
+		}
+
+		return true;
+	}
+
+	/*
+	 * Moves published values to consecutive positions starting at
+	 * base, in a transaction.
+	 */
+	void
+	compact(const std::vector<std::pair<uint64_t, size_type>> &full,
+		uint64_t base)
+	{
+		std::vector<value_type> values;
+		for (auto &e : full)
+			values.push_back(_slots._data[e.second].value);
+
+		detail::conditional_add_to_tx(&_slots);
+
+		for (uint64_t j = 0; j < N; ++j) {
+			uint64_t pos = base + j;
+			slot &s = _slots._data[pos % N];
+
+			if (j < values.size()) {
+				s.value = values[j];
+				s.seq.store(pos + 1, std::memory_order_relaxed);
+			} else {
+				s.seq.store(pos, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	array<slot, N> _slots;
+
+	/* volatile, restored by recover() */
+	PMEMobjpool *_pop;
+
+	char _padding1[64];
+	std::atomic<uint64_t> _enqueue_pos;
+
+	char _padding2[64];
+	std::atomic<uint64_t> _dequeue_pos;
+};
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_MPMC_QUEUE_HPP */
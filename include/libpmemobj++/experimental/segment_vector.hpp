@@ -0,0 +1,949 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Vector container storing its elements in segments which are never
+ * relocated.
+ */
+
+#ifndef PMEMOBJ_SEGMENT_VECTOR_HPP
+#define PMEMOBJ_SEGMENT_VECTOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/life.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/experimental/array.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::segment_vector - EXPERIMENTAL persistent
+ * container with a subset of std::vector interface, whose elements are
+ * never moved.
+ *
+ * The elements are stored in segments of geometrically growing size:
+ * segment k holds first_segment_size * 2^k elements. Growing the vector
+ * allocates the next segment and leaves the existing ones untouched, so
+ * the transaction which appends an element logs at most the new segment
+ * allocation, whatever the size of the vector, and references to the
+ * elements stay valid until they are removed. Elements can only be added
+ * and removed at the end.
+ *
+ * The vector must reside in persistent memory, i.e. it has to be created
+ * with make_persistent or be a member of an object which was.
+ *
+ * All methods which modify the vector are performed in a transaction. As
+ * in experimental::vector, elements constructed in unused capacity are
+ * only flushed, not undo logged, and methods which allow write access to
+ * specific elements add them to an active transaction.
+ */
+template <typename T>
+class segment_vector {
+	template <bool Const>
+	class segment_iterator;
+
+public:
+	/* Member types */
+	using value_type = T;
+	using pointer = value_type *;
+	using const_pointer = const value_type *;
+	using reference = value_type &;
+	using const_reference = const value_type &;
+	using iterator = segment_iterator<false>;
+	using const_iterator = segment_iterator<true>;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	/**
+	 * Number of elements in the first segment, a power of two.
+	 */
+	static constexpr size_type first_segment_size = 16;
+
+	/**
+	 * Maximal number of segments.
+	 */
+	static constexpr size_type max_segments = 32;
+
+	/**
+	 * Default constructor. Constructs an empty container.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 */
+	segment_vector() : _segment_count(0), _size(0)
+	{
+		check_pmem_tx();
+	}
+
+	/**
+	 * Constructs the container with count copies of value.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the segments failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	segment_vector(size_type count, const value_type &value)
+	    : _segment_count(0), _size(0)
+	{
+		check_pmem_tx();
+
+		grow(count, value);
+	}
+
+	/**
+	 * Destructor. Destroys all elements and frees the segments.
+	 */
+	~segment_vector()
+	{
+		try {
+			pool_base pb = get_pool();
+			transaction::exec_tx(pb, [&] { dealloc(0); });
+		} catch (...) {
+			std::terminate();
+		}
+	}
+
+	segment_vector(const segment_vector &) = delete;
+	segment_vector &operator=(const segment_vector &) = delete;
+
+	/**
+	 * Access element at specific index and add it to a transaction.
+	 *
+	 * @throw std::out_of_range if index is out of bound.
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference
+	at(size_type n)
+	{
+		if (n >= _size)
+			throw std::out_of_range("segment_vector::at");
+
+		return (*this)[n];
+	}
+
+	/**
+	 * Access element at specific index.
+	 *
+	 * @throw std::out_of_range if index is out of bound.
+	 */
+	const_reference
+	at(size_type n) const
+	{
+		if (n >= _size)
+			throw std::out_of_range("segment_vector::at");
+
+		return (*this)[n];
+	}
+
+	/**
+	 * Access element at specific index and add it to a transaction.
+	 * No bounds checking is performed.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference operator[](size_type n)
+	{
+		T *elem = element(n);
+		detail::conditional_add_to_tx(elem);
+
+		return *elem;
+	}
+
+	/**
+	 * Access element at specific index.
+	 * No bounds checking is performed.
+	 */
+	const_reference operator[](size_type n) const
+	{
+		return *element(n);
+	}
+
+	/**
+	 * Access the first element and add it to a transaction.
+	 */
+	reference
+	front()
+	{
+		return (*this)[0];
+	}
+
+	/**
+	 * Access the first element.
+	 */
+	const_reference
+	front() const
+	{
+		return (*this)[0];
+	}
+
+	/**
+	 * Access the last element and add it to a transaction.
+	 */
+	reference
+	back()
+	{
+		return (*this)[_size - 1];
+	}
+
+	/**
+	 * Access the last element.
+	 */
+	const_reference
+	back() const
+	{
+		return (*this)[_size - 1];
+	}
+
+	/**
+	 * Returns an iterator to the beginning.
+	 */
+	iterator
+	begin()
+	{
+		return iterator(this, 0);
+	}
+
+	/**
+	 * Returns an iterator to the end.
+	 */
+	iterator
+	end()
+	{
+		return iterator(this, _size);
+	}
+
+	/**
+	 * Returns a const iterator to the beginning.
+	 */
+	const_iterator
+	begin() const noexcept
+	{
+		return const_iterator(this, 0);
+	}
+
+	/**
+	 * Returns a const iterator to the beginning.
+	 */
+	const_iterator
+	cbegin() const noexcept
+	{
+		return const_iterator(this, 0);
+	}
+
+	/**
+	 * Returns a const iterator to the end.
+	 */
+	const_iterator
+	end() const noexcept
+	{
+		return const_iterator(this, _size);
+	}
+
+	/**
+	 * Returns a const iterator to the end.
+	 */
+	const_iterator
+	cend() const noexcept
+	{
+		return const_iterator(this, _size);
+	}
+
+	/**
+	 * Returns a reverse iterator to the beginning.
+	 */
+	reverse_iterator
+	rbegin()
+	{
+		return reverse_iterator(end());
+	}
+
+	/**
+	 * Returns a reverse iterator to the end.
+	 */
+	reverse_iterator
+	rend()
+	{
+		return reverse_iterator(begin());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the beginning.
+	 */
+	const_reverse_iterator
+	crbegin() const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the end.
+	 */
+	const_reverse_iterator
+	crend() const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	/**
+	 * Checks whether the container is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return _size == 0;
+	}
+
+	/**
+	 * Returns the number of elements.
+	 */
+	size_type
+	size() const noexcept
+	{
+		return _size;
+	}
+
+	/**
+	 * Returns the maximum number of elements the container is able
+	 * to hold, limited by the size of the largest allocation.
+	 */
+	size_type
+	max_size() const noexcept
+	{
+		size_type k = 0;
+		while (k < max_segments &&
+		       segment_size(k) <=
+			       PMEMOBJ_MAX_ALLOC_SIZE / sizeof(value_type))
+			k++;
+
+		return segment_start(k);
+	}
+
+	/**
+	 * Returns the number of elements that can be held in currently
+	 * allocated segments.
+	 */
+	size_type
+	capacity() const noexcept
+	{
+		return segment_start(_segment_count);
+	}
+
+	/**
+	 * Returns the number of allocated segments.
+	 */
+	size_type
+	segment_count() const noexcept
+	{
+		return _segment_count;
+	}
+
+	/**
+	 * Allocates segments until the capacity is at least new_cap.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for a segment failed.
+	 * @throw std::length_error if new_cap > max_size().
+	 */
+	void
+	reserve(size_type new_cap)
+	{
+		if (new_cap <= capacity())
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { alloc(new_cap); });
+	}
+
+	/**
+	 * Frees the segments which hold no elements.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	shrink_to_fit()
+	{
+		size_type needed = segments_for(_size);
+		if (needed == _segment_count)
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { dealloc(needed); });
+	}
+
+	/**
+	 * Erases all elements from the container. The segments are left
+	 * allocated.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	clear()
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { shrink(0); });
+	}
+
+	/**
+	 * Appends a new element constructed from args to the end of the
+	 * container. No existing element is moved.
+	 *
+	 * @return reference to the inserted element.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for a new segment failed.
+	 * @throw std::length_error if the size would exceed max_size().
+	 */
+	template <typename... Args>
+	reference
+	emplace_back(Args &&... args)
+	{
+		T *elem = nullptr;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			alloc(_size + 1);
+
+			elem = element(_size);
+			detail::create<T>(elem, std::forward<Args>(args)...);
+			pb.flush(elem, sizeof(value_type));
+			_size = _size + 1;
+		});
+
+		return *elem;
+	}
+
+	/**
+	 * Appends a copy of value to the end of the container.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for a new segment failed.
+	 * @throw std::length_error if the size would exceed max_size().
+	 */
+	void
+	push_back(const value_type &value)
+	{
+		emplace_back(value);
+	}
+
+	/**
+	 * Moves value to the end of the container.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for a new segment failed.
+	 * @throw std::length_error if the size would exceed max_size().
+	 */
+	void
+	push_back(value_type &&value)
+	{
+		emplace_back(std::move(value));
+	}
+
+	/**
+	 * Removes the last element of the container.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	pop_back()
+	{
+		if (empty())
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { shrink(_size - 1); });
+	}
+
+	/**
+	 * Resizes the container to contain count elements. Additional
+	 * elements are default-inserted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for a new segment failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	void
+	resize(size_type count)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (count <= _size)
+				shrink(count);
+			else
+				grow(count);
+		});
+	}
+
+	/**
+	 * Resizes the container to contain count elements. Additional
+	 * elements are copies of value.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for a new segment failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	void
+	resize(size_type count, const value_type &value)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (count <= _size)
+				shrink(count);
+			else
+				grow(count, value);
+		});
+	}
+
+private:
+	/*
+	 * Random access iterator, which adds the elements it gives write
+	 * access to to an active transaction.
+	 */
+	template <bool Const>
+	class segment_iterator {
+		using container_type =
+			typename std::conditional<Const, const segment_vector,
+						  segment_vector>::type;
+
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using reference = typename std::conditional<Const, const T &,
+							    T &>::type;
+		using pointer = typename std::conditional<Const, const T *,
+							  T *>::type;
+
+		segment_iterator() : v(nullptr), idx(0)
+		{
+		}
+
+		segment_iterator(container_type *v, size_type idx)
+		    : v(v), idx(idx)
+		{
+		}
+
+		/**
+		 * Conversion from iterator to const_iterator.
+		 */
+		template <bool C = Const,
+			  typename = typename std::enable_if<C>::type>
+		segment_iterator(const segment_iterator<false> &other)
+		    : v(other.v), idx(other.idx)
+		{
+		}
+
+		reference operator*() const
+		{
+			return (*v)[idx];
+		}
+
+		pointer operator->() const
+		{
+			return &(*v)[idx];
+		}
+
+		reference operator[](difference_type n) const
+		{
+			return (*v)[offset(n)];
+		}
+
+		segment_iterator &operator++()
+		{
+			++idx;
+			return *this;
+		}
+
+		segment_iterator operator++(int)
+		{
+			segment_iterator tmp(*this);
+			++idx;
+			return tmp;
+		}
+
+		segment_iterator &operator--()
+		{
+			--idx;
+			return *this;
+		}
+
+		segment_iterator operator--(int)
+		{
+			segment_iterator tmp(*this);
+			--idx;
+			return tmp;
+		}
+
+		segment_iterator &
+		operator+=(difference_type n)
+		{
+			idx = offset(n);
+			return *this;
+		}
+
+		segment_iterator &
+		operator-=(difference_type n)
+		{
+			idx = offset(-n);
+			return *this;
+		}
+
+		segment_iterator
+		operator+(difference_type n) const
+		{
+			return segment_iterator(v, offset(n));
+		}
+
+		segment_iterator
+		operator-(difference_type n) const
+		{
+			return segment_iterator(v, offset(-n));
+		}
+
+		difference_type
+		operator-(const segment_iterator &rhs) const
+		{
+			return static_cast<difference_type>(idx) -
+				static_cast<difference_type>(rhs.idx);
+		}
+
+		bool
+		operator==(const segment_iterator &rhs) const
+		{
+			return idx == rhs.idx;
+		}
+
+		bool
+		operator!=(const segment_iterator &rhs) const
+		{
+			return idx != rhs.idx;
+		}
+
+		bool
+		operator<(const segment_iterator &rhs) const
+		{
+			return idx < rhs.idx;
+		}
+
+		bool
+		operator>(const segment_iterator &rhs) const
+		{
+			return idx > rhs.idx;
+		}
+
+		bool
+		operator<=(const segment_iterator &rhs) const
+		{
+			return idx <= rhs.idx;
+		}
+
+		bool
+		operator>=(const segment_iterator &rhs) const
+		{
+			return idx >= rhs.idx;
+		}
+
+	private:
+		friend class segment_iterator<true>;
+
+		size_type
+		offset(difference_type n) const
+		{
+			return static_cast<size_type>(
+				static_cast<difference_type>(idx) + n);
+		}
+
+		container_type *v;
+		size_type idx;
+	};
+
+	/*
+	 * Checks that the vector resides in persistent memory and that
+	 * there is an active transaction.
+	 */
+	void
+	check_pmem_tx() const
+	{
+		if (pmemobj_pool_by_ptr(this) == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"Function called out of transaction scope.");
+	}
+
+	/*
+	 * Returns the pool in which the vector resides.
+	 */
+	pool_base
+	get_pool() const
+	{
+		auto pop = pmemobj_pool_by_ptr(this);
+		if (pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		return pool_base(pop);
+	}
+
+	static size_type
+	floor_log2(size_type x) noexcept
+	{
+#if defined(__GNUC__)
+		return sizeof(unsigned long long) * 8 - 1 -
+			static_cast<size_type>(__builtin_clzll(x));
+#else
+		size_type r = 0;
+		while (x >>= 1)
+			r++;
+
+		return r;
+#endif
+	}
+
+	/*
+	 * Returns the number of elements in segment k.
+	 */
+	static size_type
+	segment_size(size_type k) noexcept
+	{
+		return first_segment_size << k;
+	}
+
+	/*
+	 * Returns the index of the first element of segment k, which is
+	 * also the capacity of k segments.
+	 */
+	static size_type
+	segment_start(size_type k) noexcept
+	{
+		return first_segment_size * ((size_type(1) << k) - 1);
+	}
+
+	/*
+	 * Returns the segment holding the element at index n.
+	 */
+	static size_type
+	segment_of(size_type n) noexcept
+	{
+		return floor_log2(n / first_segment_size + 1);
+	}
+
+	/*
+	 * Returns the number of segments needed to hold count elements.
+	 */
+	static size_type
+	segments_for(size_type count) noexcept
+	{
+		return count == 0 ? 0 : segment_of(count - 1) + 1;
+	}
+
+	T *
+	element(size_type n) const noexcept
+	{
+		size_type k = segment_of(n);
+
+		return _segments._data[k].get() + (n - segment_start(k));
+	}
+
+	/*
+	 * Calls f(ptr, count) for every contiguous part of elements
+	 * [first, last).
+	 */
+	template <typename F>
+	void
+	for_each_part(size_type first, size_type last, F f) const
+	{
+		while (first < last) {
+			size_type k = segment_of(first);
+			size_type end = (std::min)(last, segment_start(k + 1));
+
+			f(element(first), end - first);
+			first = end;
+		}
+	}
+
+	/*
+	 * Transactionally allocates uninitialized segments until the
+	 * capacity is at least count. No constructors are called.
+	 */
+	void
+	alloc(size_type count)
+	{
+		if (count > max_size())
+			throw std::length_error("segment_vector::reserve");
+
+		while (capacity() < count) {
+			size_type k = _segment_count;
+			persistent_ptr<T[]> segment = pmemobj_tx_alloc(
+				sizeof(value_type) * segment_size(k),
+				detail::type_num<T>());
+
+			if (segment == nullptr)
+				throw transaction_alloc_error(
+					"failed to allocate persistent memory "
+					"segment");
+
+			_segments[k] = segment;
+			_segment_count = k + 1;
+		}
+	}
+
+	/*
+	 * Destroys all elements beyond the capacity of the first count
+	 * segments and transactionally frees the other segments.
+	 */
+	void
+	dealloc(size_type count)
+	{
+		if (_size > segment_start(count))
+			shrink(segment_start(count));
+
+		for (size_type k = _segment_count; k > count; --k) {
+			if (pmemobj_tx_free(*_segments[k - 1].raw_ptr()) != 0)
+				throw transaction_free_error(
+					"failed to delete persistent memory "
+					"object");
+
+			_segments[k - 1] = nullptr;
+		}
+
+		_segment_count = count;
+	}
+
+	/*
+	 * Constructs elements from args up to count. They are created in
+	 * unused capacity, so they are flushed instead of snapshotted.
+	 */
+	template <typename... Args>
+	void
+	grow(size_type count, const Args &... args)
+	{
+		assert(count >= _size);
+
+		alloc(count);
+
+		pool_base pb = get_pool();
+		for_each_part(_size, count, [&](T *ptr, size_type n) {
+			for (size_type i = 0; i < n; ++i)
+				detail::create<T>(ptr + i, args...);
+
+			pb.flush(ptr, n * sizeof(value_type));
+		});
+
+		_size = count;
+	}
+
+	/*
+	 * Removes elements beyond new_size, snapshotting each removed part
+	 * of a segment. The segments stay allocated, so a later grow() or
+	 * emplace_back() in the same transaction constructs over these
+	 * elements with only a flush - the snapshot is what an abort
+	 * restores them from, whether the elements are trivial or not.
+	 */
+	void
+	shrink(size_type new_size)
+	{
+		assert(new_size <= _size);
+
+		for_each_part(new_size, _size, [&](T *ptr, size_type n) {
+			detail::conditional_add_to_tx(ptr, n);
+
+			for (size_type i = n; i > 0; --i)
+				detail::destroy<T>(ptr[i - 1]);
+		});
+
+		_size = new_size;
+	}
+
+	/* Segments, the first _segment_count are allocated */
+	array<persistent_ptr<T[]>, max_segments> _segments;
+
+	p<size_type> _segment_count;
+
+	p<size_type> _size;
+};
+
+template <typename T>
+constexpr typename segment_vector<T>::size_type
+	segment_vector<T>::first_segment_size;
+
+template <typename T>
+constexpr typename segment_vector<T>::size_type
+	segment_vector<T>::max_segments;
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_SEGMENT_VECTOR_HPP */
@@ -0,0 +1,717 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Persistent skip list with lock-free concurrent inserts.
+ */
+
+#ifndef PMEMOBJ_SKIP_LIST_HPP
+#define PMEMOBJ_SKIP_LIST_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/make_persistent.hpp"
+#include "libpmemobj++/make_persistent_atomic.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::skip_list - EXPERIMENTAL ordered map which
+ * allows many threads to insert concurrently, without locks.
+ *
+ * The persistent part of the map is storage_type, a singly linked list of
+ * nodes sorted by key, which has to be allocated with make_persistent.
+ * The upper levels of the skip list live in DRAM. skip_list itself is
+ * a volatile object which rebuilds them by a single pass over the list
+ * when it is constructed, e.g. after the pool is opened. Only one
+ * skip_list object at a time may be used to access a storage_type.
+ *
+ * An insert allocates its node atomically and links it with a single
+ * compare-and-swap of the offset of the predecessor's persistent_ptr.
+ * The new link is marked until it is flushed and drained, and any thread
+ * which reads a marked link makes it durable before following it, so a
+ * node is never reachable after a crash without all of its predecessors.
+ * Nodes allocated by inserts which were interrupted before linking are
+ * freed when the skip_list is constructed.
+ *
+ * insert, lookups and iteration may be called concurrently from any
+ * number of threads. Elements cannot be erased or modified, they are
+ * freed with the storage_type.
+ *
+ * Key and T have to be trivially copyable and Key default constructible.
+ */
+template <typename Key, typename T, typename Compare = std::less<Key>>
+class skip_list {
+	static_assert(std::is_trivially_copyable<Key>::value,
+		      "Key has to be trivially copyable");
+	static_assert(std::is_trivially_copyable<T>::value,
+		      "T has to be trivially copyable");
+
+public:
+	/* Member types */
+	using key_type = Key;
+	using mapped_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+
+	/**
+	 * Element stored in the nodes.
+	 */
+	struct value_type {
+		key_type first;
+		mapped_type second;
+	};
+
+	/**
+	 * Number of levels kept in DRAM, above the persistent list.
+	 */
+	static constexpr size_type max_height = 16;
+
+private:
+	struct node {
+		node(uint64_t owner, PMEMoid next, const key_type &key,
+		     const mapped_type &value)
+		    : next(next), owner(owner), entry{key, value}
+		{
+		}
+
+		persistent_ptr<node> next;
+
+		/* Offset of the storage_type this node was allocated for */
+		uint64_t owner;
+
+		value_type entry;
+	};
+
+	/* Set in the offset of a link which may not be durable yet */
+	static constexpr uint64_t dirty_bit = 1;
+
+public:
+	/**
+	 * Persistent part of the map.
+	 */
+	class storage_type {
+	public:
+		/**
+		 * Constructs an empty map.
+		 *
+		 * @pre must be called in transaction scope.
+		 */
+		storage_type()
+		    : head(PMEMoid{pmemobj_oid(this).pool_uuid_lo, 0})
+		{
+		}
+
+		/**
+		 * Destructor. Frees all nodes.
+		 *
+		 * @pre must be called in transaction scope.
+		 */
+		~storage_type()
+		{
+			PMEMoid oid = head.raw();
+
+			while ((oid.off & ~dirty_bit) != 0) {
+				oid.off &= ~dirty_bit;
+				persistent_ptr<node> n(oid);
+				oid = n->next.raw();
+				delete_persistent<node>(n);
+			}
+		}
+
+		storage_type(const storage_type &) = delete;
+		storage_type &operator=(const storage_type &) = delete;
+
+	private:
+		friend class skip_list;
+
+		/*
+		 * First node. Every link carries the pool uuid, even when
+		 * it is null, so that only the offset is ever swapped.
+		 */
+		persistent_ptr<node> head;
+	};
+
+	/**
+	 * Forward iterator over the elements, in key order.
+	 */
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = typename skip_list::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = const value_type &;
+		using pointer = const value_type *;
+
+		/**
+		 * Constructs end iterator.
+		 */
+		const_iterator() : list(nullptr), n(nullptr)
+		{
+		}
+
+		reference operator*() const
+		{
+			return n->entry;
+		}
+
+		pointer operator->() const
+		{
+			return &n->entry;
+		}
+
+		const_iterator &operator++()
+		{
+			n = list->node_at(list->load(n->next));
+
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator tmp(*this);
+			++(*this);
+
+			return tmp;
+		}
+
+		bool
+		operator==(const const_iterator &rhs) const
+		{
+			return n == rhs.n;
+		}
+
+		bool
+		operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+
+	private:
+		friend class skip_list;
+
+		const_iterator(const skip_list *list, node *n)
+		    : list(list), n(n)
+		{
+		}
+
+		const skip_list *list;
+		node *n;
+	};
+
+	using iterator = const_iterator;
+
+	/**
+	 * Opens the map stored in storage, frees the nodes leaked by
+	 * interrupted inserts and builds the upper levels.
+	 *
+	 * @throw pmem::pool_error if storage is nullptr.
+	 */
+	explicit skip_list(persistent_ptr<storage_type> storage,
+			   const Compare &comp = Compare())
+	    : _storage(storage), _comp(comp), _size(0)
+	{
+		if (_storage == nullptr)
+			throw pool_error("Invalid storage.");
+
+		_pop = pmemobj_pool_by_oid(_storage.raw());
+		_uuid = _storage.raw().pool_uuid_lo;
+		_head.reset(new tower(key_type(), nullptr, max_height));
+
+		recover();
+	}
+
+	/**
+	 * Destructor. Frees the upper levels, the persistent part is left
+	 * intact.
+	 */
+	~skip_list()
+	{
+		tower *t = _head->next[0].load(std::memory_order_relaxed);
+
+		while (t != nullptr) {
+			tower *next =
+				t->next[0].load(std::memory_order_relaxed);
+			delete t;
+			t = next;
+		}
+	}
+
+	skip_list(const skip_list &) = delete;
+	skip_list &operator=(const skip_list &) = delete;
+
+	/**
+	 * Returns the number of elements. While other threads insert, the
+	 * result is only an approximation.
+	 */
+	size_type
+	size() const noexcept
+	{
+		return _size.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Checks whether the map is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * Returns an iterator to the smallest element.
+	 */
+	const_iterator
+	begin() const
+	{
+		return const_iterator(this, node_at(load(_storage->head)));
+	}
+
+	/**
+	 * Returns an iterator past the largest element.
+	 */
+	const_iterator
+	end() const
+	{
+		return const_iterator();
+	}
+
+	/**
+	 * Returns an iterator to the element with the given key, or end().
+	 */
+	const_iterator
+	find(const key_type &key) const
+	{
+		uint64_t off;
+		find_link(key, off);
+		node *n = node_at(off);
+
+		if (n == nullptr || _comp(key, n->entry.first))
+			return end();
+
+		return const_iterator(this, n);
+	}
+
+	/**
+	 * Returns the number of elements with the given key, either 0 or 1.
+	 */
+	size_type
+	count(const key_type &key) const
+	{
+		return find(key) == end() ? 0 : 1;
+	}
+
+	/**
+	 * Returns an iterator to the first element whose key is not less
+	 * than key.
+	 */
+	const_iterator
+	lower_bound(const key_type &key) const
+	{
+		uint64_t off;
+		find_link(key, off);
+
+		return const_iterator(this, node_at(off));
+	}
+
+	/**
+	 * Returns an iterator to the first element whose key is greater
+	 * than key.
+	 */
+	const_iterator
+	upper_bound(const key_type &key) const
+	{
+		const_iterator it = lower_bound(key);
+
+		if (it != end() && !_comp(key, it->first))
+			++it;
+
+		return it;
+	}
+
+	/**
+	 * Inserts key with value, unless the key is already present. The
+	 * element is durable once insert returns. Can be called concurrently
+	 * with any other method except the destructor.
+	 *
+	 * @return true if the element was inserted.
+	 *
+	 * @throw pmem::transaction_scope_error if called within a
+	 *	transaction.
+	 * @throw std::bad_alloc on allocation failure.
+	 */
+	bool
+	insert(const key_type &key, const mapped_type &value)
+	{
+		if (pmemobj_tx_stage() != TX_STAGE_NONE)
+			throw transaction_scope_error(
+				"skip_list cannot be modified within a "
+				"transaction");
+
+		pool_base pb(_pop);
+		persistent_ptr<node> fresh;
+
+		for (;;) {
+			uint64_t off;
+			persistent_ptr<node> *link = find_link(key, off);
+			node *succ = node_at(off);
+
+			if (succ != nullptr && !_comp(key, succ->entry.first)) {
+				delete_persistent_atomic<node>(fresh);
+				return false;
+			}
+
+			PMEMoid next{_uuid, off};
+			if (fresh == nullptr) {
+				uint64_t owner = _storage.raw().off;
+				make_persistent_atomic<node>(pb, fresh, owner,
+							     next, key, value);
+			} else if (fresh->next.raw().off != off) {
+				fresh->next = persistent_ptr<node>(next);
+				pb.persist(fresh->next);
+			}
+
+			uint64_t fresh_off = fresh.raw().off;
+			std::atomic<uint64_t> &link_off = offset_of(*link);
+
+			if (link_off.compare_exchange_strong(
+				    off, fresh_off | dirty_bit,
+				    std::memory_order_acq_rel)) {
+				make_durable(link_off, fresh_off | dirty_bit);
+				break;
+			}
+		}
+
+		link_tower(key, fresh.get());
+		_size.fetch_add(1, std::memory_order_relaxed);
+
+		return true;
+	}
+
+private:
+	/*
+	 * Volatile node of the upper levels, pointing to the persistent
+	 * node with the same key. The head tower has no persistent node.
+	 */
+	struct tower {
+		tower(const key_type &key, node *pnode, size_type height)
+		    : key(key),
+		      pnode(pnode),
+		      next(new std::atomic<tower *>[height])
+		{
+			for (size_type i = 0; i < height; ++i)
+				next[i].store(nullptr,
+					      std::memory_order_relaxed);
+		}
+
+		key_type key;
+		node *pnode;
+		std::unique_ptr<std::atomic<tower *>[]> next;
+	};
+
+	static std::atomic<uint64_t> &
+	offset_of(persistent_ptr<node> &link) noexcept
+	{
+		return *reinterpret_cast<std::atomic<uint64_t> *>(
+			&link.raw_ptr()->off);
+	}
+
+	node *
+	node_at(uint64_t off) const noexcept
+	{
+		return static_cast<node *>(pmemobj_direct(PMEMoid{_uuid, off}));
+	}
+
+	/*
+	 * Flushes a marked link and clears the mark. Failing to clear it
+	 * means another thread already did.
+	 */
+	void
+	make_durable(std::atomic<uint64_t> &link_off, uint64_t marked) const
+		noexcept
+	{
+		pool_base pb(_pop);
+		pb.flush(&link_off, sizeof(link_off));
+		pb.drain();
+
+		link_off.compare_exchange_strong(marked, marked & ~dirty_bit,
+						 std::memory_order_acq_rel);
+	}
+
+	/*
+	 * Returns the offset stored in a link, making the link durable
+	 * first if it is marked.
+	 */
+	uint64_t
+	load(persistent_ptr<node> &link) const noexcept
+	{
+		std::atomic<uint64_t> &link_off = offset_of(link);
+		uint64_t off = link_off.load(std::memory_order_acquire);
+
+		if (off & dirty_bit)
+			make_durable(link_off, off);
+
+		return off & ~dirty_bit;
+	}
+
+	/*
+	 * Finds on every upper level the last tower whose key is less than
+	 * key and its successor. Returns the last such tower on the lowest
+	 * level.
+	 */
+	tower *
+	find_towers(const key_type &key, tower **preds, tower **succs) const
+	{
+		tower *pred = _head.get();
+
+		for (size_type lvl = max_height; lvl-- > 0;) {
+			tower *succ =
+				pred->next[lvl].load(std::memory_order_acquire);
+			while (succ != nullptr && _comp(succ->key, key)) {
+				pred = succ;
+				succ = pred->next[lvl].load(
+					std::memory_order_acquire);
+			}
+
+			if (preds != nullptr) {
+				preds[lvl] = pred;
+				succs[lvl] = succ;
+			}
+		}
+
+		return pred;
+	}
+
+	/*
+	 * Finds the persistent link to the first node whose key is not less
+	 * than key and stores the offset of that node in off.
+	 */
+	persistent_ptr<node> *
+	find_link(const key_type &key, uint64_t &off) const
+	{
+		tower *t = find_towers(key, nullptr, nullptr);
+		persistent_ptr<node> *link =
+			t->pnode ? &t->pnode->next : &_storage->head;
+
+		for (;;) {
+			off = load(*link);
+			node *n = node_at(off);
+			if (n == nullptr || !_comp(n->entry.first, key))
+				return link;
+
+			link = &n->next;
+		}
+	}
+
+	/*
+	 * Returns the number of upper levels of a new node, each level
+	 * being reached with a probability of 1/4.
+	 */
+	static size_type
+	random_height() noexcept
+	{
+		static thread_local uint64_t state = 0;
+
+		if (state == 0)
+			state = reinterpret_cast<uintptr_t>(&state) | 1;
+
+		/* xorshift64 */
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+
+		uint64_t r = state;
+		size_type height = 0;
+		while (height < max_height && (r & 3) == 0) {
+			height++;
+			r >>= 2;
+		}
+
+		return height;
+	}
+
+	/*
+	 * Links a tower for an already inserted node into the upper levels,
+	 * bottom-up. The upper levels only speed up the search, so the tower
+	 * is skipped when it cannot be allocated.
+	 */
+	void
+	link_tower(const key_type &key, node *pnode)
+	{
+		size_type height = random_height();
+		if (height == 0)
+			return;
+
+		tower *t;
+		try {
+			t = new tower(key, pnode, height);
+		} catch (std::bad_alloc &) {
+			return;
+		}
+
+		tower *preds[max_height];
+		tower *succs[max_height];
+		find_towers(key, preds, succs);
+
+		for (size_type lvl = 0; lvl < height; ++lvl) {
+			for (;;) {
+				auto &link = preds[lvl]->next[lvl];
+
+				t->next[lvl].store(succs[lvl],
+						   std::memory_order_relaxed);
+				if (link.compare_exchange_strong(
+					    succs[lvl], t,
+					    std::memory_order_release,
+					    std::memory_order_relaxed))
+					break;
+
+				/* a concurrent insert linked a tower here */
+				find_towers(key, preds, succs);
+			}
+		}
+	}
+
+	/*
+	 * Clears the marks left by a crash, frees the nodes which were
+	 * allocated but never linked and builds the upper levels.
+	 */
+	void
+	recover()
+	{
+		pool_base pb(_pop);
+		std::unordered_set<uint64_t> reachable;
+		tower *last[max_height];
+
+		for (size_type lvl = 0; lvl < max_height; ++lvl)
+			last[lvl] = _head.get();
+
+		persistent_ptr<node> *link = &_storage->head;
+		for (;;) {
+			std::atomic<uint64_t> &link_off = offset_of(*link);
+			uint64_t off = link_off.load(std::memory_order_relaxed);
+
+			if (off & dirty_bit) {
+				off &= ~dirty_bit;
+				link_off.store(off, std::memory_order_relaxed);
+				pb.persist(&link_off, sizeof(link_off));
+			}
+
+			node *n = node_at(off);
+			if (n == nullptr)
+				break;
+
+			reachable.insert(off);
+			_size++;
+
+			size_type height = random_height();
+			if (height > 0) {
+				tower *t = new tower(n->entry.first, n, height);
+				for (size_type lvl = 0; lvl < height; ++lvl) {
+					last[lvl]->next[lvl].store(
+						t, std::memory_order_relaxed);
+					last[lvl] = t;
+				}
+			}
+
+			link = &n->next;
+		}
+
+		std::vector<persistent_ptr<node>> leaked;
+		uint64_t owner = _storage.raw().off;
+
+		for (PMEMoid oid = pmemobj_first(_pop); !OID_IS_NULL(oid);
+		     oid = pmemobj_next(oid)) {
+			if (pmemobj_type_num(oid) != detail::type_num<node>() ||
+			    reachable.count(oid.off) != 0)
+				continue;
+
+			persistent_ptr<node> n(oid);
+			if (n->owner == owner)
+				leaked.push_back(n);
+		}
+
+		for (auto &n : leaked)
+			delete_persistent_atomic<node>(n);
+	}
+
+	persistent_ptr<storage_type> _storage;
+
+	Compare _comp;
+
+	PMEMobjpool *_pop;
+
+	/* Uuid of the pool, shared by all links */
+	uint64_t _uuid;
+
+	/* Tower spanning all upper levels, before the first element */
+	std::unique_ptr<tower> _head;
+
+	std::atomic<size_type> _size;
+};
+
+template <typename Key, typename T, typename Compare>
+constexpr typename skip_list<Key, T, Compare>::size_type
+	skip_list<Key, T, Compare>::max_height;
+
+template <typename Key, typename T, typename Compare>
+constexpr uint64_t skip_list<Key, T, Compare>::dirty_bit;
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_SKIP_LIST_HPP */
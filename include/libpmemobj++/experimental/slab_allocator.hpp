@@ -0,0 +1,502 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Allocator of fixed-size objects from persistent slabs.
+ */
+
+#ifndef PMEMOBJ_SLAB_ALLOCATOR_HPP
+#define PMEMOBJ_SLAB_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "libpmemobj++/allocator.hpp"
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/make_persistent.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj/tx_base.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::slab - EXPERIMENTAL persistent store of
+ * fixed-size slots for objects of type T.
+ *
+ * The slots are carved out of chunks of SlotsPerChunk slots, allocated
+ * with make_persistent when all the others are full. Each chunk keeps
+ * a bitmap of its free slots, so allocating or freeing a slot only flips
+ * a bit, snapshotted as a single word, instead of a transactional heap
+ * operation. The only metadata of a slot is the 8-byte offset of its
+ * chunk, compared to the allocation header of at least 16 bytes of
+ * a libpmemobj object.
+ *
+ * The slab has to reside in persistent memory, e.g. in the root object.
+ * Memory of freed slots is reused for new objects of the slab only;
+ * chunks are never returned to the pool.
+ *
+ * Objects are usually allocated through slab_allocator, which can be
+ * used as the allocation policy of pmem::obj::allocator.
+ */
+template <typename T, std::size_t SlotsPerChunk = 256>
+class slab {
+	static_assert(SlotsPerChunk > 0 && SlotsPerChunk % 64 == 0,
+		      "SlotsPerChunk has to be a multiple of 64");
+
+public:
+	using value_type = T;
+	using pointer = persistent_ptr<T>;
+	using size_type = std::size_t;
+
+	/**
+	 * Allocates a slot for an object, without constructing it.
+	 *
+	 * @return pointer to the slot.
+	 *
+	 * @throw transaction_scope_error if called outside of
+	 *	a transaction.
+	 * @throw transaction_alloc_error if a new chunk could not be
+	 *	allocated.
+	 * @throw transaction_error if the slot could not be added to the
+	 *	transaction.
+	 */
+	pointer
+	allocate()
+	{
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"refusing to allocate "
+				"memory outside of transaction scope");
+
+		if (free_chunks == nullptr)
+			add_chunk();
+
+		persistent_ptr<chunk> c = free_chunks;
+
+		size_type w = 0;
+		while (c->free[w].get_ro() == 0)
+			++w;
+
+		uint64_t bits = c->free[w].get_ro();
+		size_type i = w * 64 + lowest_bit(bits);
+
+		c->free[w] = bits & (bits - 1);
+
+		/* the chunk is full, take it off the free list */
+		if (c->free[w].get_ro() == 0 && is_full(*c))
+			free_chunks = c->next_free;
+
+		auto ptr = reinterpret_cast<char *>(&c->slots[i].storage);
+
+		add_slot_to_tx(ptr);
+
+		uint64_t off = c.raw().off +
+			static_cast<uint64_t>(
+				ptr - reinterpret_cast<char *>(c.get()));
+
+		return pointer(PMEMoid{c.raw().pool_uuid_lo, off});
+	}
+
+	/**
+	 * Frees a slot allocated from the slab. The object has to be
+	 * destroyed already.
+	 *
+	 * @param[in] ptr pointer to the slot.
+	 *
+	 * @throw transaction_scope_error if called outside of
+	 *	a transaction.
+	 * @throw transaction_error if the slot could not be snapshotted.
+	 */
+	void
+	deallocate(pointer ptr)
+	{
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"refusing to free "
+				"memory outside of transaction scope");
+
+		if (ptr == nullptr)
+			return;
+
+		/*
+		 * The slot may be reused in this transaction, so its
+		 * contents have to be restored if it aborts.
+		 */
+		detail::conditional_add_to_tx(
+			reinterpret_cast<const storage_type *>(ptr.get()));
+
+		auto s = reinterpret_cast<slot *>(
+			reinterpret_cast<char *>(ptr.get()) -
+			offsetof(slot, storage));
+		persistent_ptr<chunk> c =
+			PMEMoid{ptr.raw().pool_uuid_lo, s->chunk_off.get_ro()};
+
+		size_type i = static_cast<size_type>(s - &c->slots[0]);
+		size_type w = i / 64;
+
+		bool was_full = is_full(*c);
+
+		c->free[w] = c->free[w].get_ro() | (uint64_t(1) << (i % 64));
+
+		if (was_full) {
+			c->next_free = free_chunks;
+			free_chunks = c;
+		}
+	}
+
+	/**
+	 * Returns the number of allocated slots. Runs in time linear in the
+	 * number of chunks.
+	 */
+	size_type
+	size() const
+	{
+		size_type n = 0;
+
+		for (auto c = chunks; c != nullptr; c = c->next) {
+			n += SlotsPerChunk;
+			for (size_type w = 0; w < words; ++w)
+				n -= popcount(c->free[w].get_ro());
+		}
+
+		return n;
+	}
+
+	/**
+	 * Returns the number of slots in all chunks.
+	 */
+	size_type
+	capacity() const
+	{
+		size_type n = 0;
+
+		for (auto c = chunks; c != nullptr; c = c->next)
+			n += SlotsPerChunk;
+
+		return n;
+	}
+
+private:
+	static constexpr size_type words = SlotsPerChunk / 64;
+
+	using storage_type = typename std::aligned_storage<sizeof(T),
+							   alignof(T)>::type;
+
+	struct slot {
+		p<uint64_t> chunk_off;
+		storage_type storage;
+	};
+
+	struct chunk {
+		chunk()
+		{
+			for (size_type w = 0; w < words; ++w)
+				free[w] = ~uint64_t(0);
+		}
+
+		/* all chunks of the slab */
+		persistent_ptr<chunk> next;
+
+		/* chunks with free slots */
+		persistent_ptr<chunk> next_free;
+
+		/* bit set for every free slot */
+		p<uint64_t> free[words];
+
+		slot slots[SlotsPerChunk];
+	};
+
+	/*
+	 * Adds a slot being allocated to the transaction, so that the
+	 * object constructed in it is flushed on commit. Unlike a fresh
+	 * libpmemobj allocation, a reused slot is not flushed by
+	 * libpmemobj. The slot was free at the start of the transaction, or
+	 * its contents were snapshotted when it was freed, so there is
+	 * nothing to snapshot where libpmemobj allows skipping it.
+	 */
+	static void
+	add_slot_to_tx(char *ptr)
+	{
+#ifdef POBJ_XADD_NO_SNAPSHOT
+		if (pmemobj_tx_xadd_range_direct(ptr, sizeof(T),
+						 POBJ_XADD_NO_SNAPSHOT) != 0)
+			throw transaction_error(
+				"Could not add object(s) to the transaction.");
+
+		detail::tx_allocated(ptr, sizeof(T));
+#else
+		detail::conditional_add_to_tx(
+			reinterpret_cast<const storage_type *>(ptr));
+#endif
+	}
+
+	/*
+	 * Allocates a chunk and puts it on both lists.
+	 */
+	void
+	add_chunk()
+	{
+		auto c = make_persistent<chunk>();
+
+		for (size_type i = 0; i < SlotsPerChunk; ++i)
+			c->slots[i].chunk_off = c.raw().off;
+
+		c->next = chunks;
+		chunks = c;
+		c->next_free = free_chunks;
+		free_chunks = c;
+	}
+
+	static bool
+	is_full(const chunk &c) noexcept
+	{
+		for (size_type w = 0; w < words; ++w)
+			if (c.free[w].get_ro() != 0)
+				return false;
+
+		return true;
+	}
+
+	static size_type
+	lowest_bit(uint64_t bits) noexcept
+	{
+#if defined(__GNUC__)
+		return static_cast<size_type>(__builtin_ctzll(bits));
+#else
+		size_type i = 0;
+		while ((bits & 1) == 0) {
+			bits >>= 1;
+			i++;
+		}
+
+		return i;
+#endif
+	}
+
+	static size_type
+	popcount(uint64_t bits) noexcept
+	{
+#if defined(__GNUC__)
+		return static_cast<size_type>(__builtin_popcountll(bits));
+#else
+		size_type n = 0;
+		for (; bits != 0; bits &= bits - 1)
+			n++;
+
+		return n;
+#endif
+	}
+
+	persistent_ptr<chunk> chunks;
+	persistent_ptr<chunk> free_chunks;
+};
+
+template <typename T, std::size_t SlotsPerChunk>
+constexpr typename slab<T, SlotsPerChunk>::size_type
+	slab<T, SlotsPerChunk>::words;
+
+/**
+ * pmem::obj::experimental::slab_allocator - EXPERIMENTAL allocation
+ * policy of pmem::obj::allocator allocating single objects from a slab.
+ *
+ * A policy constructed from a slab allocates single objects from it,
+ * and arrays with libpmemobj, as standard_alloc_policy does. A default
+ * constructed policy, or one converted from a policy of another type,
+ * is not bound to a slab and allocates everything with libpmemobj.
+ *
+ * In particular, containers which rebind the allocator to their
+ * internal node type, like std::list or the node-based maps, do not
+ * allocate from the slab: the slab has to be declared for the type
+ * which is actually allocated, and its allocator used directly.
+ *
+ * @code
+ * using node_allocator = allocator<node, slab_allocator<node>>;
+ * node_allocator a(slab_allocator<node>(pop.get_root()->nodes));
+ * @endcode
+ *
+ * Unlike for standard_alloc_policy, deallocate has to be given the
+ * number of objects passed to allocate, if it was not 1.
+ */
+template <typename T, std::size_t SlotsPerChunk = 256>
+class slab_allocator {
+public:
+	/*
+	 * Important typedefs.
+	 */
+	using value_type = T;
+	using pointer = persistent_ptr<value_type>;
+	using const_void_pointer = persistent_ptr<const void>;
+	using size_type = std::size_t;
+	using bool_type = bool;
+	using slab_type = slab<T, SlotsPerChunk>;
+
+	/**
+	 * Rebind to a different type.
+	 */
+	template <class U>
+	struct rebind {
+		using other = slab_allocator<U, SlotsPerChunk>;
+	};
+
+	/**
+	 * Constructs a policy which is not bound to a slab.
+	 */
+	slab_allocator() noexcept : s(nullptr)
+	{
+	}
+
+	/**
+	 * Constructs a policy allocating single objects from a slab.
+	 *
+	 * @param[in,out] s the slab, which has to outlive the policy.
+	 */
+	explicit slab_allocator(slab_type &s) noexcept : s(&s)
+	{
+	}
+
+	/**
+	 * Copy constructor.
+	 */
+	slab_allocator(const slab_allocator &) noexcept = default;
+
+	/**
+	 * Type converting constructor, the policy is not bound to a slab.
+	 */
+	template <typename U>
+	explicit slab_allocator(
+		slab_allocator<U, SlotsPerChunk> const &) noexcept
+	    : s(nullptr)
+	{
+	}
+
+	/**
+	 * Allocate storage for cnt objects of type T. Does not construct the
+	 * objects.
+	 *
+	 * @param[in] cnt the number of objects to allocate memory for.
+	 *
+	 * @throw transaction_scope_error if called outside of a transaction.
+	 * @throw transaction_alloc_error if a chunk of the slab could not be
+	 *	allocated.
+	 */
+	pointer
+	allocate(size_type cnt, const_void_pointer = 0)
+	{
+		if (s != nullptr && cnt == 1)
+			return s->allocate();
+
+		return standard_alloc_policy<T>().allocate(cnt);
+	}
+
+	/**
+	 * Deallocates storage pointed to p, which must be a value returned by
+	 * a previous call to allocate of an equal policy.
+	 *
+	 * @param[in] p pointer to the memory to be deallocated.
+	 * @param[in] cnt the number of objects passed to allocate.
+	 */
+	void
+	deallocate(pointer p, size_type cnt = 1)
+	{
+		if (s != nullptr && cnt == 1)
+			s->deallocate(p);
+		else
+			standard_alloc_policy<T>().deallocate(p);
+	}
+
+	/**
+	 * The largest value that can meaningfully be passed to allocate().
+	 *
+	 * @return largest value that can be passed to allocate.
+	 */
+	size_type
+	max_size() const
+	{
+		return PMEMOBJ_MAX_ALLOC_SIZE / sizeof(value_type);
+	}
+
+	/**
+	 * Returns the slab the policy allocates from, or nullptr.
+	 */
+	slab_type *
+	get_slab() const noexcept
+	{
+		return s;
+	}
+
+private:
+	slab_type *s;
+};
+
+/**
+ * Determines if memory from another allocator can be deallocated from this one.
+ *
+ * @return true if both policies allocate from the same slab.
+ */
+template <typename T, typename T2, std::size_t N>
+inline bool
+operator==(slab_allocator<T, N> const &lhs, slab_allocator<T2, N> const &rhs)
+{
+	return static_cast<const void *>(lhs.get_slab()) ==
+		static_cast<const void *>(rhs.get_slab());
+}
+
+/**
+ * Determines if memory from another allocator can be deallocated from this one.
+ *
+ * @return false.
+ */
+template <typename T, std::size_t N, typename OtherAllocator>
+inline bool
+operator==(slab_allocator<T, N> const &, OtherAllocator const &)
+{
+	return false;
+}
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_SLAB_ALLOCATOR_HPP */
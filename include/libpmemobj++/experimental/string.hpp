@@ -0,0 +1,1490 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * String container with std::basic_string like interface.
+ */
+
+#ifndef PMEMOBJ_STRING_HPP
+#define PMEMOBJ_STRING_HPP
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/experimental/contiguous_iterator.hpp"
+#include "libpmemobj++/make_persistent_array.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::basic_string - EXPERIMENTAL persistent string
+ * with std::basic_string like interface.
+ *
+ * The string must reside in persistent memory, i.e. it has to be created
+ * with make_persistent or be a member of an object which was.
+ *
+ * Short strings (up to sso_capacity characters) are kept in a buffer
+ * inside the string object itself, so no separate allocation is needed
+ * for them. Longer strings are stored in an array allocated with
+ * make_persistent<CharT[]>, whose capacity grows geometrically.
+ *
+ * All methods which modify the string are performed in a transaction.
+ * Appending snapshots only the size and the old terminating character,
+ * the appended characters land in memory which was not part of the
+ * string and are flushed instead of being undo logged. Operations which
+ * shorten the string snapshot the characters they drop, so an abort
+ * restores them even if they were overwritten by a later append.
+ */
+template <typename CharT, typename Traits = std::char_traits<CharT>>
+class basic_string {
+public:
+	/* Member types */
+	using traits_type = Traits;
+	using value_type = CharT;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = value_type &;
+	using const_reference = const value_type &;
+	using pointer = value_type *;
+	using const_pointer = const value_type *;
+	using iterator = basic_contiguous_iterator<CharT>;
+	using const_iterator = const_contiguous_iterator<CharT>;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	/**
+	 * Number of characters which can be stored without a separate
+	 * allocation.
+	 */
+	static constexpr size_type sso_capacity = 32 / sizeof(CharT) - 1;
+
+	/**
+	 * Special value, meaning "until the end of the string".
+	 */
+	static constexpr size_type npos = static_cast<size_type>(-1);
+
+	/**
+	 * Default constructor. Constructs an empty string.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 */
+	basic_string() : _size(0), _capacity(sso_capacity)
+	{
+		check_pmem_tx();
+
+		traits_type::assign(_sso[0], value_type());
+	}
+
+	/**
+	 * Constructs the string with count copies of character ch.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	basic_string(size_type count, value_type ch)
+	    : _size(0), _capacity(sso_capacity)
+	{
+		check_pmem_tx();
+
+		CharT *d = initialize(count);
+		traits_type::assign(d, count, ch);
+	}
+
+	/**
+	 * Constructs the string with the first count characters of s.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	basic_string(const CharT *s, size_type count)
+	    : _size(0), _capacity(sso_capacity)
+	{
+		check_pmem_tx();
+
+		CharT *d = initialize(count);
+		traits_type::copy(d, s, count);
+	}
+
+	/**
+	 * Constructs the string with the contents of the null-terminated
+	 * string s.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string(const CharT *s) : basic_string(s, traits_type::length(s))
+	{
+	}
+
+	/**
+	 * Constructs the string with the contents of std::basic_string.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string(const std::basic_string<CharT, Traits> &str)
+	    : basic_string(str.data(), str.size())
+	{
+	}
+
+	/**
+	 * Copy constructor.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string(const basic_string &other)
+	    : basic_string(other.cdata(), other.size())
+	{
+	}
+
+	/**
+	 * Move constructor. Takes over the storage of a long string,
+	 * copies the characters of a short one. After the move, other is
+	 * empty.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 */
+	basic_string(basic_string &&other) : _size(0), _capacity(sso_capacity)
+	{
+		check_pmem_tx();
+
+		if (other.is_sso()) {
+			traits_type::copy(_sso, other._sso, other._size + 1);
+
+			/* characters left in other no longer belong to it */
+			other.snapshot(0, other._size + 1);
+		} else {
+			new (&_large) persistent_ptr<CharT[]>(other._large);
+			_capacity = other._capacity;
+
+			other.reset_to_sso();
+		}
+
+		_size = other._size;
+
+		other._size = 0;
+		traits_type::assign(other._sso[0], value_type());
+	}
+
+	/**
+	 * Constructs the string with the contents of the initializer list.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the string doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string(std::initializer_list<CharT> ilist)
+	    : basic_string(ilist.begin(), ilist.size())
+	{
+	}
+
+	/**
+	 * Destructor. Frees the characters of a long string.
+	 *
+	 * Should be called within a transaction (e.g. by
+	 * delete_persistent), otherwise a new one is started.
+	 */
+	~basic_string()
+	{
+		try {
+			if (!is_sso()) {
+				pool_base pb = get_pool();
+				transaction::exec_tx(pb, [&] {
+					delete_persistent<CharT[]>(
+						_large, _capacity + 1);
+					reset_to_sso();
+				});
+			}
+		} catch (...) {
+			std::terminate();
+		}
+	}
+
+	/**
+	 * Copy assignment operator.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator=(const basic_string &other)
+	{
+		if (this != &other)
+			assign(other.cdata(), other.size());
+
+		return *this;
+	}
+
+	/**
+	 * Replaces the contents with the null-terminated string s.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator=(const CharT *s)
+	{
+		return assign(s);
+	}
+
+	/**
+	 * Replaces the contents with the contents of std::basic_string.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator=(const std::basic_string<CharT, Traits> &str)
+	{
+		return assign(str.data(), str.size());
+	}
+
+	/**
+	 * Replaces the contents with the initializer list.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator=(std::initializer_list<CharT> ilist)
+	{
+		return assign(ilist.begin(), ilist.size());
+	}
+
+	/**
+	 * Replaces the contents with count copies of character ch.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	basic_string &
+	assign(size_type count, value_type ch)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			CharT *d = prepare_assign(count);
+			traits_type::assign(d, count, ch);
+			finish_assign(count);
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Replaces the contents with the first count characters of s,
+	 * which may point into this string. Only the characters which
+	 * were part of the old string are snapshotted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	basic_string &
+	assign(const CharT *s, size_type count)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (count > _capacity) {
+				/* s may point into the old storage */
+				persistent_ptr<CharT[]> ptr = alloc(count);
+				traits_type::copy(ptr.get(), s, count);
+				traits_type::assign(ptr.get()[count],
+						    value_type());
+
+				replace_storage(ptr, count);
+				_size = count;
+			} else {
+				CharT *d = prepare_assign(count);
+				traits_type::move(d, s, count);
+				finish_assign(count);
+			}
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Replaces the contents with the null-terminated string s.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	assign(const CharT *s)
+	{
+		return assign(s, traits_type::length(s));
+	}
+
+	/**
+	 * Replaces the contents with a copy of str.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	assign(const basic_string &str)
+	{
+		return assign(str.cdata(), str.size());
+	}
+
+	/**
+	 * Access character at specific index and add it to a transaction.
+	 *
+	 * @throw std::out_of_range if index is out of bound.
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference
+	at(size_type n)
+	{
+		if (n >= _size)
+			throw std::out_of_range("basic_string::at");
+
+		snapshot(n, n + 1);
+
+		return mutable_data()[n];
+	}
+
+	/**
+	 * Access character at specific index.
+	 *
+	 * @throw std::out_of_range if index is out of bound.
+	 */
+	const_reference
+	at(size_type n) const
+	{
+		if (n >= _size)
+			throw std::out_of_range("basic_string::at");
+
+		return cdata()[n];
+	}
+
+	/**
+	 * Access character at specific index and add it to a transaction.
+	 * No bounds checking is performed.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference operator[](size_type n)
+	{
+		snapshot(n, n + 1);
+
+		return mutable_data()[n];
+	}
+
+	/**
+	 * Access character at specific index.
+	 * No bounds checking is performed.
+	 */
+	const_reference operator[](size_type n) const
+	{
+		return cdata()[n];
+	}
+
+	/**
+	 * Access the first character and add it to a transaction.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference
+	front()
+	{
+		return (*this)[0];
+	}
+
+	/**
+	 * Access the first character.
+	 */
+	const_reference
+	front() const
+	{
+		return cdata()[0];
+	}
+
+	/**
+	 * Access the last character and add it to a transaction.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference
+	back()
+	{
+		return (*this)[_size - 1];
+	}
+
+	/**
+	 * Access the last character.
+	 */
+	const_reference
+	back() const
+	{
+		return cdata()[_size - 1];
+	}
+
+	/**
+	 * Returns raw pointer to the characters and adds all of them to
+	 * a transaction.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	CharT *
+	data()
+	{
+		snapshot(0, _size);
+
+		return mutable_data();
+	}
+
+	/**
+	 * Returns const raw pointer to the characters.
+	 */
+	const CharT *
+	data() const noexcept
+	{
+		return cdata();
+	}
+
+	/**
+	 * Returns const raw pointer to the characters.
+	 */
+	const CharT *
+	cdata() const noexcept
+	{
+		return is_sso() ? _sso : _large.get();
+	}
+
+	/**
+	 * Returns const raw pointer to the null-terminated characters.
+	 */
+	const CharT *
+	c_str() const noexcept
+	{
+		return cdata();
+	}
+
+	/**
+	 * Returns an iterator to the beginning.
+	 */
+	iterator
+	begin()
+	{
+		return iterator(mutable_data());
+	}
+
+	/**
+	 * Returns an iterator to the end.
+	 */
+	iterator
+	end()
+	{
+		return iterator(mutable_data() + static_cast<size_type>(_size));
+	}
+
+	/**
+	 * Returns const iterator to the beginning.
+	 */
+	const_iterator
+	begin() const noexcept
+	{
+		return cbegin();
+	}
+
+	/**
+	 * Returns const iterator to the beginning.
+	 */
+	const_iterator
+	cbegin() const noexcept
+	{
+		return const_iterator(cdata());
+	}
+
+	/**
+	 * Returns a const iterator to the end.
+	 */
+	const_iterator
+	end() const noexcept
+	{
+		return cend();
+	}
+
+	/**
+	 * Returns a const iterator to the end.
+	 */
+	const_iterator
+	cend() const noexcept
+	{
+		return const_iterator(cdata() + static_cast<size_type>(_size));
+	}
+
+	/**
+	 * Returns a reverse iterator to the beginning.
+	 */
+	reverse_iterator
+	rbegin()
+	{
+		return reverse_iterator(end());
+	}
+
+	/**
+	 * Returns a reverse iterator to the end.
+	 */
+	reverse_iterator
+	rend()
+	{
+		return reverse_iterator(begin());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the beginning.
+	 */
+	const_reverse_iterator
+	crbegin() const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the end.
+	 */
+	const_reverse_iterator
+	crend() const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	/**
+	 * Checks whether the string is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return _size == 0;
+	}
+
+	/**
+	 * Returns the number of characters.
+	 */
+	size_type
+	size() const noexcept
+	{
+		return _size;
+	}
+
+	/**
+	 * Returns the number of characters.
+	 */
+	size_type
+	length() const noexcept
+	{
+		return _size;
+	}
+
+	/**
+	 * Returns the maximum number of characters the string is able to
+	 * hold.
+	 */
+	constexpr size_type
+	max_size() const noexcept
+	{
+		return PMEMOBJ_MAX_ALLOC_SIZE / sizeof(CharT) - 1;
+	}
+
+	/**
+	 * Returns the number of characters that can be held in currently
+	 * allocated storage.
+	 */
+	size_type
+	capacity() const noexcept
+	{
+		return _capacity;
+	}
+
+	/**
+	 * Increases the capacity of the string to new_cap.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 * @throw std::length_error if new_cap > max_size().
+	 */
+	void
+	reserve(size_type new_cap)
+	{
+		if (new_cap <= _capacity)
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { reallocate(new_cap); });
+	}
+
+	/**
+	 * Requests the removal of unused capacity. Moves the characters
+	 * back to the internal buffer, if they fit there.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	void
+	shrink_to_fit()
+	{
+		if (is_sso() || _size == _capacity)
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (_size > sso_capacity) {
+				reallocate(_size);
+				return;
+			}
+
+			persistent_ptr<CharT[]> old = _large;
+			size_type old_capacity = _capacity;
+
+			reset_to_sso();
+			traits_type::copy(_sso, old.get(), _size + 1);
+
+			delete_persistent<CharT[]>(old, old_capacity + 1);
+		});
+	}
+
+	/**
+	 * Removes all characters from the string. The capacity is left
+	 * unchanged.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	clear()
+	{
+		erase(0, npos);
+	}
+
+	/**
+	 * Removes min(count, size() - index) characters starting at index.
+	 * The characters from index up to the old end of the string are
+	 * snapshotted, including the ones which are only dropped: a later
+	 * append in the same transaction flushes rather than snapshots
+	 * them.
+	 *
+	 * @throw std::out_of_range if index > size().
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	basic_string &
+	erase(size_type index = 0, size_type count = npos)
+	{
+		size_type size = _size;
+
+		if (index > size)
+			throw std::out_of_range("basic_string::erase");
+
+		count = (std::min)(count, size - index);
+		if (count == 0)
+			return *this;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			CharT *d = mutable_data();
+
+			/* the terminating character is moved as well */
+			snapshot(index, size + 1);
+			traits_type::move(d + index, d + index + count,
+					  size + 1 - index - count);
+			_size = size - count;
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Appends character ch to the end of the string.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	void
+	push_back(value_type ch)
+	{
+		append(1, ch);
+	}
+
+	/**
+	 * Removes the last character of the string.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	pop_back()
+	{
+		erase(_size - 1, 1);
+	}
+
+	/**
+	 * Appends count copies of character ch.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 * @throw std::length_error if the resulting size would exceed
+	 *	max_size().
+	 */
+	basic_string &
+	append(size_type count, value_type ch)
+	{
+		if (count == 0)
+			return *this;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			CharT *d = prepare_append(count);
+			traits_type::assign(d, count, ch);
+			finish_append(count);
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Appends the first count characters of s, which may point into
+	 * this string.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 * @throw std::length_error if the resulting size would exceed
+	 *	max_size().
+	 */
+	basic_string &
+	append(const CharT *s, size_type count)
+	{
+		if (count == 0)
+			return *this;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			bool self = points_into(s);
+			difference_type offset = s - cdata();
+
+			CharT *d = prepare_append(count);
+
+			/* storage may have been reallocated */
+			if (self)
+				s = cdata() + offset;
+
+			traits_type::copy(d, s, count);
+			finish_append(count);
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Appends the null-terminated string s.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	append(const CharT *s)
+	{
+		return append(s, traits_type::length(s));
+	}
+
+	/**
+	 * Appends str.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	append(const basic_string &str)
+	{
+		return append(str.cdata(), str.size());
+	}
+
+	/**
+	 * Appends the contents of std::basic_string.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	append(const std::basic_string<CharT, Traits> &str)
+	{
+		return append(str.data(), str.size());
+	}
+
+	/**
+	 * Appends str.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator+=(const basic_string &str)
+	{
+		return append(str);
+	}
+
+	/**
+	 * Appends the null-terminated string s.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator+=(const CharT *s)
+	{
+		return append(s);
+	}
+
+	/**
+	 * Appends character ch.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator+=(value_type ch)
+	{
+		return append(1, ch);
+	}
+
+	/**
+	 * Appends the contents of std::basic_string.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	basic_string &
+	operator+=(const std::basic_string<CharT, Traits> &str)
+	{
+		return append(str);
+	}
+
+	/**
+	 * Resizes the string to contain count characters. Additional
+	 * characters are copies of ch.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the characters failed.
+	 */
+	void
+	resize(size_type count, value_type ch = value_type())
+	{
+		if (count > _size)
+			append(count - _size, ch);
+		else
+			erase(count, npos);
+	}
+
+	/**
+	 * Compares the string with the first count characters of s.
+	 *
+	 * @return negative value if the string is lexicographically less
+	 *	than s, zero if both are equal, positive value otherwise.
+	 */
+	int
+	compare(const CharT *s, size_type count) const
+	{
+		size_type size = _size;
+		int ret = traits_type::compare(cdata(), s,
+					       (std::min)(size, count));
+
+		if (ret != 0)
+			return ret;
+
+		if (size < count)
+			return -1;
+
+		if (size > count)
+			return 1;
+
+		return 0;
+	}
+
+	/**
+	 * Compares the string with the null-terminated string s.
+	 */
+	int
+	compare(const CharT *s) const
+	{
+		return compare(s, traits_type::length(s));
+	}
+
+	/**
+	 * Compares the string with other.
+	 */
+	int
+	compare(const basic_string &other) const
+	{
+		return compare(other.cdata(), other.size());
+	}
+
+	/**
+	 * Compares the string with std::basic_string.
+	 */
+	int
+	compare(const std::basic_string<CharT, Traits> &str) const
+	{
+		return compare(str.data(), str.size());
+	}
+
+private:
+	static_assert(sizeof(CharT[sso_capacity + 1]) >=
+			      sizeof(persistent_ptr<CharT[]>),
+		      "internal buffer cannot hold a persistent_ptr");
+
+	/*
+	 * Checks that the string resides in persistent memory and that
+	 * there is an active transaction.
+	 */
+	void
+	check_pmem_tx() const
+	{
+		if (pmemobj_pool_by_ptr(this) == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"Function called out of transaction scope.");
+	}
+
+	/*
+	 * Returns the pool in which the string resides.
+	 */
+	pool_base
+	get_pool() const
+	{
+		auto pop = pmemobj_pool_by_ptr(this);
+		if (pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		return pool_base(pop);
+	}
+
+	/*
+	 * Checks whether the characters are stored in the internal buffer.
+	 */
+	bool
+	is_sso() const noexcept
+	{
+		return _capacity <= sso_capacity;
+	}
+
+	/*
+	 * Returns pointer to the characters without snapshotting them.
+	 */
+	CharT *
+	mutable_data() noexcept
+	{
+		return is_sso() ? _sso : _large.get();
+	}
+
+	/*
+	 * Checks whether s points to a character of this string.
+	 */
+	bool
+	points_into(const CharT *s) const noexcept
+	{
+		const CharT *d = cdata();
+
+		return !std::less<const CharT *>()(s, d) &&
+			std::less<const CharT *>()(s, d + _size);
+	}
+
+	/*
+	 * Adds characters [first, last) to a transaction as a single
+	 * range.
+	 */
+	void
+	snapshot(size_type first, size_type last)
+	{
+		if (first >= last)
+			return;
+
+		detail::conditional_add_to_tx(mutable_data() + first,
+					      last - first);
+	}
+
+	/*
+	 * Flushes characters [first, last) written to the part of the
+	 * storage which did not belong to the string. They are not
+	 * snapshotted, so the transaction would not flush them on commit,
+	 * but the commit still drains before the new size becomes durable.
+	 */
+	void
+	flush(size_type first, size_type last)
+	{
+		if (first >= last)
+			return;
+
+		pool_base pb = get_pool();
+		pb.flush(mutable_data() + first,
+			 (last - first) * sizeof(CharT));
+	}
+
+	/*
+	 * Returns the capacity to which the string should grow to hold at
+	 * least at_least characters - amortizes appends by doubling.
+	 */
+	size_type
+	get_recommended_capacity(size_type at_least) const
+	{
+		if (at_least > max_size())
+			throw std::length_error("basic_string::reserve");
+
+		size_type doubled = 2 * static_cast<size_type>(_capacity);
+		if (doubled > max_size())
+			doubled = max_size();
+
+		return (std::max)(at_least, doubled);
+	}
+
+	/*
+	 * Transactionally allocates storage for capacity characters and
+	 * the terminating one.
+	 */
+	persistent_ptr<CharT[]>
+	alloc(size_type capacity)
+	{
+		if (capacity > max_size())
+			throw std::length_error("basic_string::reserve");
+
+		return make_persistent<CharT[]>(capacity + 1);
+	}
+
+	/*
+	 * Switches the internal buffer back from holding a pointer to
+	 * holding characters. Does not free the pointed to storage.
+	 */
+	void
+	reset_to_sso()
+	{
+		detail::conditional_add_to_tx(&_sso);
+
+		_large.~persistent_ptr<CharT[]>();
+		_capacity = sso_capacity;
+	}
+
+	/*
+	 * Frees the current storage and installs ptr holding capacity
+	 * characters.
+	 */
+	void
+	replace_storage(persistent_ptr<CharT[]> ptr, size_type capacity)
+	{
+		if (is_sso()) {
+			detail::conditional_add_to_tx(&_sso);
+			new (&_large) persistent_ptr<CharT[]>(ptr);
+		} else {
+			delete_persistent<CharT[]>(_large, _capacity + 1);
+			_large = ptr;
+		}
+
+		_capacity = capacity;
+	}
+
+	/*
+	 * Moves the characters to a newly allocated storage of capacity
+	 * characters.
+	 */
+	void
+	reallocate(size_type capacity)
+	{
+		persistent_ptr<CharT[]> ptr = alloc(capacity);
+		traits_type::copy(ptr.get(), cdata(), _size + 1);
+
+		replace_storage(ptr, capacity);
+	}
+
+	/*
+	 * Sets up storage for count characters in a string under
+	 * construction and returns pointer to it. The terminating
+	 * character is written as well.
+	 */
+	CharT *
+	initialize(size_type count)
+	{
+		if (count > sso_capacity) {
+			new (&_large) persistent_ptr<CharT[]>(alloc(count));
+			_capacity = count;
+		}
+
+		CharT *d = mutable_data();
+		traits_type::assign(d[count], value_type());
+		_size = count;
+
+		return d;
+	}
+
+	/*
+	 * Makes room for count characters replacing the current ones and
+	 * returns pointer to it. Only the part of the storage which holds
+	 * the current characters is snapshotted - all of it, as characters
+	 * left beyond a shorter new string may be overwritten by a later
+	 * append in the same transaction.
+	 */
+	CharT *
+	prepare_assign(size_type count)
+	{
+		if (count > _capacity) {
+			/* the old characters are not going to be needed */
+			replace_storage(alloc(count), count);
+			_size = 0;
+		}
+
+		snapshot(0, size() + 1);
+
+		return mutable_data();
+	}
+
+	/*
+	 * Terminates count characters written after prepare_assign.
+	 */
+	void
+	finish_assign(size_type count)
+	{
+		traits_type::assign(mutable_data()[count], value_type());
+		flush(size() + 1, count + 1);
+		_size = count;
+	}
+
+	/*
+	 * Makes room for count more characters and returns pointer to the
+	 * place where they are to be written. Only the old terminating
+	 * character is snapshotted.
+	 */
+	CharT *
+	prepare_append(size_type count)
+	{
+		size_type size = _size;
+
+		if (count > max_size() - size)
+			throw std::length_error("basic_string::append");
+
+		if (size + count > _capacity)
+			reallocate(get_recommended_capacity(size + count));
+		else
+			snapshot(size, size + 1);
+
+		return mutable_data() + size;
+	}
+
+	/*
+	 * Terminates count characters written after prepare_append.
+	 */
+	void
+	finish_append(size_type count)
+	{
+		size_type size = _size;
+
+		traits_type::assign(mutable_data()[size + count],
+				    value_type());
+		flush(size + 1, size + count + 1);
+		_size = size + count;
+	}
+
+	/* Number of characters */
+	p<size_type> _size;
+
+	/* Number of characters which fit in the current storage */
+	p<size_type> _capacity;
+
+	union {
+		/* Characters of a short string */
+		CharT _sso[sso_capacity + 1];
+
+		/* Characters of a long string */
+		persistent_ptr<CharT[]> _large;
+	};
+};
+
+template <typename CharT, typename Traits>
+constexpr typename basic_string<CharT, Traits>::size_type
+	basic_string<CharT, Traits>::sso_capacity;
+
+template <typename CharT, typename Traits>
+constexpr typename basic_string<CharT, Traits>::size_type
+	basic_string<CharT, Traits>::npos;
+
+/**
+ * Non-member equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator==(const basic_string<CharT, Traits> &lhs,
+	   const basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) == 0;
+}
+
+/**
+ * Non-member not-equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator!=(const basic_string<CharT, Traits> &lhs,
+	   const basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) != 0;
+}
+
+/**
+ * Non-member less than operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator<(const basic_string<CharT, Traits> &lhs,
+	  const basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) < 0;
+}
+
+/**
+ * Non-member less or equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator<=(const basic_string<CharT, Traits> &lhs,
+	   const basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) <= 0;
+}
+
+/**
+ * Non-member greater than operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator>(const basic_string<CharT, Traits> &lhs,
+	  const basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) > 0;
+}
+
+/**
+ * Non-member greater or equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator>=(const basic_string<CharT, Traits> &lhs,
+	   const basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) >= 0;
+}
+
+/**
+ * Non-member equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator==(const basic_string<CharT, Traits> &lhs, const CharT *rhs)
+{
+	return lhs.compare(rhs) == 0;
+}
+
+/**
+ * Non-member equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator==(const CharT *lhs, const basic_string<CharT, Traits> &rhs)
+{
+	return rhs.compare(lhs) == 0;
+}
+
+/**
+ * Non-member not-equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator!=(const basic_string<CharT, Traits> &lhs, const CharT *rhs)
+{
+	return lhs.compare(rhs) != 0;
+}
+
+/**
+ * Non-member not-equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator!=(const CharT *lhs, const basic_string<CharT, Traits> &rhs)
+{
+	return rhs.compare(lhs) != 0;
+}
+
+/**
+ * Non-member equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator==(const basic_string<CharT, Traits> &lhs,
+	   const std::basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) == 0;
+}
+
+/**
+ * Non-member equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator==(const std::basic_string<CharT, Traits> &lhs,
+	   const basic_string<CharT, Traits> &rhs)
+{
+	return rhs.compare(lhs) == 0;
+}
+
+/**
+ * Non-member not-equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator!=(const basic_string<CharT, Traits> &lhs,
+	   const std::basic_string<CharT, Traits> &rhs)
+{
+	return lhs.compare(rhs) != 0;
+}
+
+/**
+ * Non-member not-equal operator.
+ */
+template <typename CharT, typename Traits>
+inline bool
+operator!=(const std::basic_string<CharT, Traits> &lhs,
+	   const basic_string<CharT, Traits> &rhs)
+{
+	return rhs.compare(lhs) != 0;
+}
+
+using string = basic_string<char>;
+using wstring = basic_string<wchar_t>;
+using u16string = basic_string<char16_t>;
+using u32string = basic_string<char32_t>;
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_STRING_HPP */
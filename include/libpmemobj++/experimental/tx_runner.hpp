@@ -0,0 +1,385 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Transaction runner retrying on lock contention, with backoff.
+ */
+
+#ifndef PMEMOBJ_TX_RUNNER_HPP
+#define PMEMOBJ_TX_RUNNER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <random>
+#include <thread>
+
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include <libpmemobj/tx_base.h>
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * Backoff between the attempts of a tx_runner.
+ *
+ * The first spin_retries retries busy-wait, for spin_iterations
+ * iterations doubled on every retry. The next yield_retries retries
+ * yield the processor. All later retries sleep, for min_sleep doubled
+ * on every retry up to max_sleep, shortened by a random amount of up to
+ * a half so that the waiting threads do not retry all at once.
+ */
+struct tx_backoff {
+	/** Number of retries which busy-wait. */
+	unsigned spin_retries = 4;
+
+	/** Iterations of the first busy-wait. */
+	unsigned spin_iterations = 64;
+
+	/** Number of retries which yield, after the busy-waiting ones. */
+	unsigned yield_retries = 4;
+
+	/** Duration of the first sleep. */
+	std::chrono::microseconds min_sleep{10};
+
+	/** Maximum duration of a sleep. */
+	std::chrono::microseconds max_sleep{10000};
+
+	/** Number of retries after which a transaction is given up. */
+	unsigned max_retries = 32;
+};
+
+/**
+ * Counters of a tx_runner.
+ */
+struct tx_runner_stats {
+	/** Transactions attempted, including retries. */
+	std::uint64_t attempts;
+
+	/** Transactions committed. */
+	std::uint64_t commits;
+
+	/** Attempts which found one of the locks taken. */
+	std::uint64_t contentions;
+
+	/** Transactions aborted by an exception, which are not retried. */
+	std::uint64_t aborts;
+
+	/** Attempts repeated after a contention. */
+	std::uint64_t retries;
+
+	/** Backoffs which busy-waited. */
+	std::uint64_t spins;
+
+	/** Backoffs which yielded the processor. */
+	std::uint64_t yields;
+
+	/** Backoffs which slept. */
+	std::uint64_t sleeps;
+
+	/** Transactions given up after max_retries retries. */
+	std::uint64_t exhausted;
+};
+
+/**
+ * pmem::obj::experimental::tx_runner - EXPERIMENTAL transaction runner
+ * which retries transactions on lock contention.
+ *
+ * Unlike transaction::exec_tx, which blocks on the locks, the runner
+ * tries to take all of the locks before starting the transaction. If one
+ * of them is taken, it releases the others, backs off as configured by
+ * tx_backoff and tries again. The locks are held until the transaction
+ * has ended, as with exec_tx.
+ *
+ * Only lock contention is retried. Once the locks are taken, the closure
+ * runs exactly once: an exception thrown by it or by the transaction,
+ * transaction_error included, aborts the transaction and propagates to
+ * the caller, as such failures, e.g. a full undo log, would most likely
+ * repeat on a retry.
+ *
+ * A transaction run inside of another transaction cannot be retried on
+ * its own, so it is passed to exec_tx unchanged.
+ *
+ * All methods are thread-safe; a runner is usually shared by all the
+ * threads contending for the same locks, so that its counters describe
+ * the contention.
+ */
+class tx_runner {
+public:
+	/**
+	 * Constructs a runner.
+	 *
+	 * @param[in,out] pop the pool in which the transactions run.
+	 * @param[in] backoff the backoff between the attempts.
+	 */
+	explicit tx_runner(pool_base &pop, tx_backoff backoff = tx_backoff())
+	    : pop(pop), backoff(backoff)
+	{
+		reset_stats();
+	}
+
+	tx_runner(const tx_runner &) = delete;
+	tx_runner &operator=(const tx_runner &) = delete;
+
+	/**
+	 * Runs a transaction, retrying it on lock contention.
+	 *
+	 * @param[in] tx the closure to run in the transaction.
+	 * @param[in,out] locks locks to be taken for the whole duration of
+	 *	the transaction, which have to provide try_lock() and
+	 *	unlock().
+	 *
+	 * @throw transaction_error if the locks could not be taken within
+	 *	max_retries retries, or if the transaction failed.
+	 * @throw lock_error if one of the locks failed.
+	 * @throw anything thrown by tx, after aborting the transaction.
+	 */
+	template <typename Func, typename... Locks>
+	void
+	exec(Func &&tx, Locks &... locks)
+	{
+		count(counters.attempts);
+
+		if (pmemobj_tx_stage() != TX_STAGE_NONE) {
+			transaction::exec_tx(pop, tx, locks...);
+			count(counters.commits);
+			return;
+		}
+
+		for (unsigned retry = 0;; ++retry) {
+			if (retry > 0) {
+				count(counters.attempts);
+				count(counters.retries);
+			}
+
+			if (try_lock_all(locks...)) {
+				try {
+					transaction::exec_tx(pop, tx);
+				} catch (...) {
+					unlock_all(locks...);
+					count(counters.aborts);
+					throw;
+				}
+
+				unlock_all(locks...);
+				count(counters.commits);
+				return;
+			}
+
+			count(counters.contentions);
+
+			if (retry == backoff.max_retries) {
+				count(counters.exhausted);
+				throw transaction_error(
+					"retry budget exhausted on lock"
+					" contention");
+			}
+
+			wait(retry);
+		}
+	}
+
+	/**
+	 * Returns the counters of the runner.
+	 */
+	tx_runner_stats
+	stats() const noexcept
+	{
+		tx_runner_stats s;
+
+		s.attempts = counters.attempts.load(std::memory_order_relaxed);
+		s.commits = counters.commits.load(std::memory_order_relaxed);
+		s.contentions =
+			counters.contentions.load(std::memory_order_relaxed);
+		s.aborts = counters.aborts.load(std::memory_order_relaxed);
+		s.retries = counters.retries.load(std::memory_order_relaxed);
+		s.spins = counters.spins.load(std::memory_order_relaxed);
+		s.yields = counters.yields.load(std::memory_order_relaxed);
+		s.sleeps = counters.sleeps.load(std::memory_order_relaxed);
+		s.exhausted =
+			counters.exhausted.load(std::memory_order_relaxed);
+
+		return s;
+	}
+
+	/**
+	 * Zeroes the counters of the runner.
+	 */
+	void
+	reset_stats() noexcept
+	{
+		for (auto c : {&counters.attempts, &counters.commits,
+			       &counters.contentions, &counters.aborts,
+			       &counters.retries, &counters.spins,
+			       &counters.yields, &counters.sleeps,
+			       &counters.exhausted})
+			c->store(0, std::memory_order_relaxed);
+	}
+
+private:
+	static void
+	count(std::atomic<std::uint64_t> &c) noexcept
+	{
+		c.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static bool
+	try_lock_all()
+	{
+		return true;
+	}
+
+	/*
+	 * Takes all the locks, or none of them if one is taken.
+	 */
+	template <typename L, typename... Locks>
+	static bool
+	try_lock_all(L &lock, Locks &... locks)
+	{
+		if (!lock.try_lock())
+			return false;
+
+		bool locked;
+		try {
+			locked = try_lock_all(locks...);
+		} catch (...) {
+			lock.unlock();
+			throw;
+		}
+
+		if (!locked)
+			lock.unlock();
+
+		return locked;
+	}
+
+	static void
+	unlock_all() noexcept
+	{
+	}
+
+	template <typename L, typename... Locks>
+	static void
+	unlock_all(L &lock, Locks &... locks) noexcept
+	{
+		unlock_all(locks...);
+		lock.unlock();
+	}
+
+	/*
+	 * Backs off before the retry following the given one.
+	 */
+	void
+	wait(unsigned retry)
+	{
+		if (retry < backoff.spin_retries) {
+			count(counters.spins);
+
+			std::uint64_t n = std::uint64_t(backoff.spin_iterations)
+				<< (std::min)(retry, 16u);
+			for (std::uint64_t i = 0; i < n; ++i)
+				std::atomic_signal_fence(
+					std::memory_order_seq_cst);
+
+			return;
+		}
+
+		retry -= backoff.spin_retries;
+		if (retry < backoff.yield_retries) {
+			count(counters.yields);
+			std::this_thread::yield();
+			return;
+		}
+
+		retry -= backoff.yield_retries;
+		count(counters.sleeps);
+
+		auto max = backoff.max_sleep.count();
+		auto d = (std::max)(backoff.min_sleep.count(),
+				    decltype(max)(1));
+		for (; retry > 0 && d < max; --retry)
+			d *= 2;
+		d = (std::min)(d, max);
+
+		std::uniform_int_distribution<decltype(d)> jitter(d - d / 2,
+								  d);
+		std::this_thread::sleep_for(
+			std::chrono::microseconds(jitter(random_engine())));
+	}
+
+	static std::minstd_rand &
+	random_engine()
+	{
+		static thread_local std::minstd_rand engine(
+			static_cast<std::minstd_rand::result_type>(
+				std::hash<std::thread::id>()(
+					std::this_thread::get_id())));
+
+		return engine;
+	}
+
+	struct counters_type {
+		std::atomic<std::uint64_t> attempts;
+		std::atomic<std::uint64_t> commits;
+		std::atomic<std::uint64_t> contentions;
+		std::atomic<std::uint64_t> aborts;
+		std::atomic<std::uint64_t> retries;
+		std::atomic<std::uint64_t> spins;
+		std::atomic<std::uint64_t> yields;
+		std::atomic<std::uint64_t> sleeps;
+		std::atomic<std::uint64_t> exhausted;
+	};
+
+	pool_base pop;
+	tx_backoff backoff;
+	counters_type counters;
+};
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_TX_RUNNER_HPP */
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Transaction statistics, enabled with LIBPMEMOBJ_CPP_TX_STATS.
+ */
+
+#ifndef PMEMOBJ_TX_STATS_HPP
+#define PMEMOBJ_TX_STATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "libpmemobj++/detail/tx_stats.hpp"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::tx_stats - EXPERIMENTAL statistics of the
+ * transactions run with pmem::obj::transaction.
+ *
+ * The statistics are only collected if LIBPMEMOBJ_CPP_TX_STATS is
+ * defined before any libpmemobj++ header is included, consistently in
+ * the whole program. Otherwise the instrumentation compiles to nothing
+ * and all statistics read as zero.
+ *
+ * Every thread updates its own counters, which can be read with
+ * thread(), or summed over all threads, including the exited ones, with
+ * global(). The latency histograms have 32 buckets: bucket 0 counts
+ * latencies of 0 ns and bucket i latencies in [2^(i-1), 2^i) ns, the
+ * last one also counting all longer ones.
+ */
+struct tx_stats {
+	/** Latency histogram. */
+	using histogram = std::array<uint64_t, detail::tx_histogram_buckets>;
+
+	/** Outermost transactions started. */
+	uint64_t transactions = 0;
+
+	/** Nested transactions started. */
+	uint64_t nested = 0;
+
+	/** Outermost transactions committed. */
+	uint64_t commits = 0;
+
+	/** Outermost transactions aborted. */
+	uint64_t aborts = 0;
+
+	/** Ranges added to the undo log by conditional_add_to_tx. */
+	uint64_t snapshots = 0;
+
+	/** Bytes added to the undo log by conditional_add_to_tx. */
+	uint64_t snapshot_bytes = 0;
+
+	/** Snapshots skipped, as the range was already in the log. */
+	uint64_t snapshot_hits = 0;
+
+	/** Objects and arrays allocated by make_persistent. */
+	uint64_t allocations = 0;
+
+	/** Bytes allocated by make_persistent. */
+	uint64_t allocation_bytes = 0;
+
+	/** Objects and arrays freed by delete_persistent. */
+	uint64_t frees = 0;
+
+	/** Time spent committing transactions, nested ones included. */
+	histogram commit_latency{};
+
+	/** Duration of outermost transactions, from begin to end. */
+	histogram transaction_latency{};
+
+	/**
+	 * Whether the statistics are collected.
+	 */
+	static constexpr bool
+	enabled() noexcept
+	{
+#ifdef LIBPMEMOBJ_CPP_TX_STATS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * Returns the statistics of the calling thread.
+	 */
+	static tx_stats
+	thread()
+	{
+		tx_stats s;
+#ifdef LIBPMEMOBJ_CPP_TX_STATS
+		s.add(detail::tx_stats_of_thread());
+#endif
+		return s;
+	}
+
+	/**
+	 * Returns the statistics summed over all threads.
+	 */
+	static tx_stats
+	global()
+	{
+		tx_stats s;
+#ifdef LIBPMEMOBJ_CPP_TX_STATS
+		auto &r = detail::tx_stats_registry::get();
+		std::lock_guard<std::mutex> lock(r.mtx);
+
+		s.add(r.exited);
+		for (auto t : r.threads)
+			s.add(*t);
+#endif
+		return s;
+	}
+
+	/**
+	 * Zeroes the statistics of the calling thread.
+	 */
+	static void
+	reset_thread()
+	{
+#ifdef LIBPMEMOBJ_CPP_TX_STATS
+		detail::tx_stats_of_thread().reset();
+#endif
+	}
+
+private:
+#ifdef LIBPMEMOBJ_CPP_TX_STATS
+	void
+	add(const detail::tx_thread_stats &t)
+	{
+		auto c = [&](detail::tx_counter i) {
+			return t.counters[i].load(std::memory_order_relaxed);
+		};
+
+		transactions += c(detail::tx_counter_transactions);
+		nested += c(detail::tx_counter_nested);
+		commits += c(detail::tx_counter_commits);
+		aborts += c(detail::tx_counter_aborts);
+		snapshots += c(detail::tx_counter_snapshots);
+		snapshot_bytes += c(detail::tx_counter_snapshot_bytes);
+		snapshot_hits += c(detail::tx_counter_snapshot_hits);
+		allocations += c(detail::tx_counter_allocations);
+		allocation_bytes += c(detail::tx_counter_allocation_bytes);
+		frees += c(detail::tx_counter_frees);
+
+		auto &commit = t.histograms[detail::tx_histogram_commit];
+		auto &tx = t.histograms[detail::tx_histogram_transaction];
+		for (std::size_t b = 0; b < detail::tx_histogram_buckets; ++b) {
+			commit_latency[b] +=
+				commit[b].load(std::memory_order_relaxed);
+			transaction_latency[b] +=
+				tx[b].load(std::memory_order_relaxed);
+		}
+	}
+#endif
+};
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_TX_STATS_HPP */
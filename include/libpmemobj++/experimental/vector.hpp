@@ -0,0 +1,1592 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Vector container with std::vector compatible interface.
+ */
+
+#ifndef PMEMOBJ_VECTOR_HPP
+#define PMEMOBJ_VECTOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/life.hpp"
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/experimental/contiguous_iterator.hpp"
+#include "libpmemobj++/experimental/slice.hpp"
+#include "libpmemobj++/p.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/transaction.hpp"
+#include "libpmemobj.h"
+
+namespace pmem
+{
+
+namespace obj
+{
+
+namespace experimental
+{
+
+/**
+ * pmem::obj::experimental::vector - EXPERIMENTAL persistent container
+ * with std::vector compatible interface.
+ *
+ * The vector must reside in persistent memory, i.e. it has to be created
+ * with make_persistent or be a member of an object which was.
+ *
+ * All methods which modify the vector are performed in a transaction. If
+ * there is an active transaction, they are executed as its nested part,
+ * otherwise a new one is started.
+ *
+ * Live elements are snapshotted in a single range whenever a modification
+ * touches them. Storage between size() and capacity() holds no live
+ * elements, so constructing elements there is not undo logged - it is
+ * only flushed, and an abort restores the old size which makes the memory
+ * unused again. Elements removed within a transaction are snapshotted
+ * before they are destroyed, so they survive being overwritten by a later
+ * growth in the same transaction.
+ *
+ * Methods which allow write access to specific elements add them to an
+ * active transaction, just like experimental::array does.
+ */
+template <typename T>
+class vector {
+public:
+	/* Member types */
+	using value_type = T;
+	using pointer = value_type *;
+	using const_pointer = const value_type *;
+	using reference = value_type &;
+	using const_reference = const value_type &;
+	using iterator = basic_contiguous_iterator<T>;
+	using const_iterator = const_contiguous_iterator<T>;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	/**
+	 * Default constructor. Constructs an empty container.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 */
+	vector() : _data(nullptr), _size(0), _capacity(0)
+	{
+		check_pmem_tx();
+	}
+
+	/**
+	 * Constructs the container with count copies of value.
+	 *
+	 * @param[in] count number of elements to construct.
+	 * @param[in] value value of all constructed elements.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	vector(size_type count, const value_type &value)
+	    : _data(nullptr), _size(0), _capacity(0)
+	{
+		check_pmem_tx();
+
+		_data = alloc(count);
+		_capacity = count;
+		construct(_data.get(), count, value);
+		_size = count;
+	}
+
+	/**
+	 * Constructs the container with count default-inserted elements.
+	 *
+	 * @param[in] count number of elements to construct.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	explicit vector(size_type count)
+	    : _data(nullptr), _size(0), _capacity(0)
+	{
+		check_pmem_tx();
+
+		_data = alloc(count);
+		_capacity = count;
+		construct(_data.get(), count);
+		_size = count;
+	}
+
+	/**
+	 * Constructs the container with the contents of the range
+	 * [first, last).
+	 *
+	 * @param[in] first first iterator of the range.
+	 * @param[in] last last iterator of the range.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 * @throw std::length_error if the range is longer than
+	 *	max_size().
+	 */
+	template <typename InputIt,
+		  typename = typename std::enable_if<
+			  !std::is_integral<InputIt>::value>::type>
+	vector(InputIt first, InputIt last)
+	    : _data(nullptr), _size(0), _capacity(0)
+	{
+		check_pmem_tx();
+
+		auto count = static_cast<size_type>(std::distance(first, last));
+
+		_data = alloc(count);
+		_capacity = count;
+		copy_construct(_data.get(), first, last);
+		_size = count;
+	}
+
+	/**
+	 * Copy constructor.
+	 *
+	 * @param[in] other the vector to be copied.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	vector(const vector &other) : vector(other.cbegin(), other.cend())
+	{
+	}
+
+	/**
+	 * Move constructor. After the move, other is empty.
+	 *
+	 * @param[in] other the vector to be moved from.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 */
+	vector(vector &&other) : _data(nullptr), _size(0), _capacity(0)
+	{
+		check_pmem_tx();
+
+		_data = other._data;
+		_size = other._size;
+		_capacity = other._capacity;
+
+		other._data = nullptr;
+		other._size = 0;
+		other._capacity = 0;
+	}
+
+	/**
+	 * Constructs the container with the contents of the initializer
+	 * list.
+	 *
+	 * @param[in] init initializer list with the content.
+	 *
+	 * @pre must be called in transaction scope.
+	 *
+	 * @throw pmem::pool_error if the vector doesn't reside in
+	 *	persistent memory.
+	 * @throw pmem::transaction_scope_error if called outside of an
+	 *	active transaction.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	vector(std::initializer_list<value_type> init)
+	    : vector(init.begin(), init.end())
+	{
+	}
+
+	/**
+	 * Destructor. Destroys all elements and frees the underlying
+	 * array.
+	 *
+	 * Should be called within a transaction (e.g. by
+	 * delete_persistent), otherwise a new one is started.
+	 */
+	~vector()
+	{
+		try {
+			pool_base pb = get_pool();
+			transaction::exec_tx(pb, [&] { dealloc(); });
+		} catch (...) {
+			std::terminate();
+		}
+	}
+
+	/**
+	 * Copy assignment operator. Replaces the contents with a copy of
+	 * other's contents.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	vector &
+	operator=(const vector &other)
+	{
+		if (this != &other)
+			assign(other.cbegin(), other.cend());
+
+		return *this;
+	}
+
+	/**
+	 * Move assignment operator. Frees the current storage and takes
+	 * over the storage of other, which becomes empty.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	vector &
+	operator=(vector &&other)
+	{
+		if (this == &other)
+			return *this;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			dealloc();
+
+			_data = other._data;
+			_size = other._size;
+			_capacity = other._capacity;
+
+			other._data = nullptr;
+			other._size = 0;
+			other._capacity = 0;
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Replaces the contents with the initializer list.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	vector &
+	operator=(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+
+		return *this;
+	}
+
+	/**
+	 * Replaces the contents with count copies of value.
+	 *
+	 * If the new contents fit in the current capacity, the live part
+	 * of the array is snapshotted as a single range, otherwise a new
+	 * array is allocated and nothing is snapshotted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 * @throw std::length_error if count > max_size().
+	 */
+	void
+	assign(size_type count, const_reference value)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (count > _capacity) {
+				persistent_ptr<T[]> new_data = alloc(count);
+				construct(new_data.get(), count, value);
+
+				replace_storage(new_data, count, count);
+			} else if (points_into(&value)) {
+				value_type tmp(value);
+				reassign(count, tmp);
+			} else {
+				reassign(count, value);
+			}
+		});
+	}
+
+	/**
+	 * Replaces the contents with copies of the range [first, last).
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 * @throw std::length_error if the range is longer than
+	 *	max_size().
+	 */
+	template <typename InputIt,
+		  typename = typename std::enable_if<
+			  !std::is_integral<InputIt>::value>::type>
+	void
+	assign(InputIt first, InputIt last)
+	{
+		auto count = static_cast<size_type>(std::distance(first, last));
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (count > _capacity) {
+				persistent_ptr<T[]> new_data = alloc(count);
+				copy_construct(new_data.get(), first, last);
+
+				replace_storage(new_data, count, count);
+			} else {
+				snapshot_data(0, _size);
+				destroy(0, _size);
+				copy_construct(_data.get(), first, last);
+				flush_data(_size, count);
+				_size = count;
+			}
+		});
+	}
+
+	/**
+	 * Replaces the contents with the initializer list.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	void
+	assign(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	/**
+	 * Access element at specific index and add it to a transaction.
+	 *
+	 * @throw std::out_of_range if index is out of bound.
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference
+	at(size_type n)
+	{
+		if (n >= _size)
+			throw std::out_of_range("vector::at");
+
+		detail::conditional_add_to_tx(_data.get() + n);
+
+		return _data[static_cast<std::ptrdiff_t>(n)];
+	}
+
+	/**
+	 * Access element at specific index.
+	 *
+	 * @throw std::out_of_range if index is out of bound.
+	 */
+	const_reference
+	at(size_type n) const
+	{
+		if (n >= _size)
+			throw std::out_of_range("vector::at");
+
+		return _data[static_cast<std::ptrdiff_t>(n)];
+	}
+
+	/**
+	 * Access element at specific index and add it to a transaction.
+	 * No bounds checking is performed.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference operator[](size_type n)
+	{
+		detail::conditional_add_to_tx(_data.get() + n);
+
+		return _data[static_cast<std::ptrdiff_t>(n)];
+	}
+
+	/**
+	 * Access element at specific index.
+	 * No bounds checking is performed.
+	 */
+	const_reference operator[](size_type n) const
+	{
+		return _data[static_cast<std::ptrdiff_t>(n)];
+	}
+
+	/**
+	 * Access the first element and add this element to a transaction.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference
+	front()
+	{
+		detail::conditional_add_to_tx(_data.get());
+
+		return _data[0];
+	}
+
+	/**
+	 * Access the first element.
+	 */
+	const_reference
+	front() const
+	{
+		return _data[0];
+	}
+
+	/**
+	 * Access the last element and add this element to a transaction.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	reference
+	back()
+	{
+		detail::conditional_add_to_tx(_data.get() + _size - 1);
+
+		return _data[static_cast<std::ptrdiff_t>(_size - 1)];
+	}
+
+	/**
+	 * Access the last element.
+	 */
+	const_reference
+	back() const
+	{
+		return _data[static_cast<std::ptrdiff_t>(_size - 1)];
+	}
+
+	/**
+	 * Returns raw pointer to the underlying data
+	 * and adds all live elements to a transaction.
+	 *
+	 * @throw transaction_error when adding the object to the
+	 *		transaction failed.
+	 */
+	T *
+	data()
+	{
+		snapshot_data(0, _size);
+
+		return _data.get();
+	}
+
+	/**
+	 * Returns const raw pointer to the underlying data.
+	 */
+	const T *
+	data() const noexcept
+	{
+		return _data.get();
+	}
+
+	/**
+	 * Returns const raw pointer to the underlying data.
+	 */
+	const T *
+	cdata() const noexcept
+	{
+		return _data.get();
+	}
+
+	/**
+	 * Returns an iterator to the beginning.
+	 */
+	iterator
+	begin()
+	{
+		return iterator(_data.get());
+	}
+
+	/**
+	 * Returns an iterator to the end.
+	 */
+	iterator
+	end()
+	{
+		return iterator(_data.get() + static_cast<size_type>(_size));
+	}
+
+	/**
+	 * Returns const iterator to the beginning.
+	 */
+	const_iterator
+	begin() const noexcept
+	{
+		return const_iterator(_data.get());
+	}
+
+	/**
+	 * Returns const iterator to the beginning.
+	 */
+	const_iterator
+	cbegin() const noexcept
+	{
+		return const_iterator(_data.get());
+	}
+
+	/**
+	 * Returns a const iterator to the end.
+	 */
+	const_iterator
+	end() const noexcept
+	{
+		return cend();
+	}
+
+	/**
+	 * Returns a const iterator to the end.
+	 */
+	const_iterator
+	cend() const noexcept
+	{
+		return const_iterator(_data.get() +
+				      static_cast<size_type>(_size));
+	}
+
+	/**
+	 * Returns a reverse iterator to the beginning.
+	 */
+	reverse_iterator
+	rbegin()
+	{
+		return reverse_iterator(end());
+	}
+
+	/**
+	 * Returns a reverse iterator to the end.
+	 */
+	reverse_iterator
+	rend()
+	{
+		return reverse_iterator(begin());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the beginning.
+	 */
+	const_reverse_iterator
+	rbegin() const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the beginning.
+	 */
+	const_reverse_iterator
+	crbegin() const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the end.
+	 */
+	const_reverse_iterator
+	rend() const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	/**
+	 * Returns a const reverse iterator to the end.
+	 */
+	const_reverse_iterator
+	crend() const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	/**
+	 * Returns slice and snapshots requested range.
+	 *
+	 * @param[in] start start index of requested range.
+	 * @param[in] n number of elements in range.
+	 * @param[in] snapshot_size number of elements which should be
+	 *	snapshotted in a bulk while traversing this slice.
+	 *	If provided value is larger or equal to n, entire range is
+	 *	added to a transaction. If value is equal to 0 no snapshotting
+	 *	happens.
+	 *
+	 * @return slice from start to start + n.
+	 *
+	 * @throw std::out_of_range if any element of the range would be
+	 *	outside of the vector.
+	 */
+	slice<range_snapshotting_iterator<T>>
+	range(size_type start, size_type n,
+	      size_type snapshot_size = std::numeric_limits<size_type>::max())
+	{
+		if (start + n > _size)
+			throw std::out_of_range("vector::range");
+
+		if (snapshot_size > n)
+			snapshot_size = n;
+
+		T *data = _data.get();
+
+		return {range_snapshotting_iterator<T>(data + start, data,
+						       _size, snapshot_size),
+			range_snapshotting_iterator<T>(data + start + n, data,
+						       _size, snapshot_size)};
+	}
+
+	/**
+	 * Returns const slice.
+	 *
+	 * @param[in] start start index of requested range.
+	 * @param[in] n number of elements in range.
+	 *
+	 * @return slice from start to start + n.
+	 *
+	 * @throw std::out_of_range if any element of the range would be
+	 *	outside of the vector.
+	 */
+	slice<const_iterator>
+	range(size_type start, size_type n) const
+	{
+		return crange(start, n);
+	}
+
+	/**
+	 * Returns const slice.
+	 *
+	 * @param[in] start start index of requested range.
+	 * @param[in] n number of elements in range.
+	 *
+	 * @return slice from start to start + n.
+	 *
+	 * @throw std::out_of_range if any element of the range would be
+	 *	outside of the vector.
+	 */
+	slice<const_iterator>
+	crange(size_type start, size_type n) const
+	{
+		if (start + n > _size)
+			throw std::out_of_range("vector::crange");
+
+		return {const_iterator(_data.get() + start),
+			const_iterator(_data.get() + start + n)};
+	}
+
+	/**
+	 * Checks whether the container is empty.
+	 */
+	bool
+	empty() const noexcept
+	{
+		return _size == 0;
+	}
+
+	/**
+	 * Returns the number of elements.
+	 */
+	size_type
+	size() const noexcept
+	{
+		return _size;
+	}
+
+	/**
+	 * Returns the maximum number of elements the container is able
+	 * to hold.
+	 */
+	constexpr size_type
+	max_size() const noexcept
+	{
+		return PMEMOBJ_MAX_ALLOC_SIZE / sizeof(value_type);
+	}
+
+	/**
+	 * Increases the capacity of the vector to new_cap. Existing
+	 * elements are relocated to the new storage in bulk.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 * @throw std::length_error if new_cap > max_size().
+	 */
+	void
+	reserve(size_type new_cap)
+	{
+		if (new_cap <= _capacity)
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { realloc(new_cap); });
+	}
+
+	/**
+	 * Returns the number of elements that can be held in currently
+	 * allocated storage.
+	 */
+	size_type
+	capacity() const noexcept
+	{
+		return _capacity;
+	}
+
+	/**
+	 * Requests the removal of unused capacity.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	void
+	shrink_to_fit()
+	{
+		if (_capacity == _size)
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (_size == 0)
+				dealloc();
+			else
+				realloc(_size);
+		});
+	}
+
+	/**
+	 * Erases all elements from the container. The capacity is left
+	 * unchanged.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	clear()
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { shrink(0); });
+	}
+
+	/**
+	 * Inserts value before pos.
+	 *
+	 * @return iterator pointing to the inserted value.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	iterator
+	insert(const_iterator pos, const value_type &value)
+	{
+		return insert(pos, 1, value);
+	}
+
+	/**
+	 * Moves value before pos.
+	 *
+	 * @return iterator pointing to the inserted value.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	iterator
+	insert(const_iterator pos, value_type &&value)
+	{
+		return emplace(pos, std::move(value));
+	}
+
+	/**
+	 * Inserts count copies of value before pos.
+	 *
+	 * @return iterator pointing to the first inserted value or pos if
+	 *	count == 0.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	iterator
+	insert(const_iterator pos, size_type count, const value_type &value)
+	{
+		auto idx = index_of(pos);
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (points_into(&value)) {
+				value_type tmp(value);
+				internal_insert(
+					idx, count, [&](T *dest, size_type) {
+						detail::create<T>(dest, tmp);
+					});
+			} else {
+				internal_insert(
+					idx, count, [&](T *dest, size_type) {
+						detail::create<T>(dest, value);
+					});
+			}
+		});
+
+		return iterator(_data.get() + idx);
+	}
+
+	/**
+	 * Inserts elements from range [first, last) before pos.
+	 *
+	 * @return iterator pointing to the first inserted value or pos if
+	 *	first == last.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	template <typename InputIt,
+		  typename = typename std::enable_if<
+			  !std::is_integral<InputIt>::value>::type>
+	iterator
+	insert(const_iterator pos, InputIt first, InputIt last)
+	{
+		auto idx = index_of(pos);
+		auto count = static_cast<size_type>(std::distance(first, last));
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			internal_insert(idx, count, [&](T *dest, size_type) {
+				detail::create<T>(dest, *first);
+				++first;
+			});
+		});
+
+		return iterator(_data.get() + idx);
+	}
+
+	/**
+	 * Inserts elements from the initializer list before pos.
+	 *
+	 * @return iterator pointing to the first inserted value or pos if
+	 *	ilist is empty.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	iterator
+	insert(const_iterator pos, std::initializer_list<value_type> ilist)
+	{
+		return insert(pos, ilist.begin(), ilist.end());
+	}
+
+	/**
+	 * Inserts a new element constructed from args before pos.
+	 *
+	 * @return iterator pointing to the emplaced element.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	template <typename... Args>
+	iterator
+	emplace(const_iterator pos, Args &&... args)
+	{
+		auto idx = index_of(pos);
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			/*
+			 * args may refer to elements which are going to be
+			 * shifted, construct the new element up front.
+			 */
+			value_type tmp(std::forward<Args>(args)...);
+
+			internal_insert(idx, 1, [&](T *dest, size_type) {
+				detail::create<T>(dest, std::move(tmp));
+			});
+		});
+
+		return iterator(_data.get() + idx);
+	}
+
+	/**
+	 * Appends a new element constructed from args to the end of the
+	 * container. Only the size field is added to the transaction,
+	 * unless the vector has to grow.
+	 *
+	 * @return reference to the inserted element.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	template <typename... Args>
+	reference
+	emplace_back(Args &&... args)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (_size == _capacity) {
+				size_type new_cap =
+					get_recommended_capacity(_size + 1);
+				persistent_ptr<T[]> new_data = alloc(new_cap);
+
+				/* args may refer to the current storage */
+				detail::create<T>(new_data.get() + _size,
+						  std::forward<Args>(args)...);
+				relocate(new_data.get(), 0, _size);
+
+				replace_storage(new_data, _size + 1, new_cap);
+			} else {
+				detail::create<T>(_data.get() + _size,
+						  std::forward<Args>(args)...);
+				flush_data(_size, _size + 1);
+				_size = _size + 1;
+			}
+		});
+
+		return _data[static_cast<std::ptrdiff_t>(_size - 1)];
+	}
+
+	/**
+	 * Appends a copy of value to the end of the container.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	void
+	push_back(const value_type &value)
+	{
+		emplace_back(value);
+	}
+
+	/**
+	 * Moves value to the end of the container.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	void
+	push_back(value_type &&value)
+	{
+		emplace_back(std::move(value));
+	}
+
+	/**
+	 * Removes the element at pos.
+	 *
+	 * @return iterator following the removed element.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	iterator
+	erase(const_iterator pos)
+	{
+		return erase(pos, pos + 1);
+	}
+
+	/**
+	 * Removes the elements in range [first, last). The elements
+	 * from first to the end of the vector are snapshotted as one
+	 * range.
+	 *
+	 * @return iterator following the last removed element.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	iterator
+	erase(const_iterator first, const_iterator last)
+	{
+		auto idx = index_of(first);
+		auto count = static_cast<size_type>(last - first);
+
+		if (count == 0)
+			return iterator(_data.get() + idx);
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			T *data = _data.get();
+
+			snapshot_data(idx, _size);
+			std::move(data + idx + count, data + _size,
+				  data + idx);
+			destroy(_size - count, _size);
+			_size = _size - count;
+		});
+
+		return iterator(_data.get() + idx);
+	}
+
+	/**
+	 * Removes the last element of the container.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	pop_back()
+	{
+		if (empty())
+			return;
+
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] { shrink(_size - 1); });
+	}
+
+	/**
+	 * Resizes the container to contain count elements. Additional
+	 * elements are default-inserted.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	void
+	resize(size_type count)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			if (count <= _size) {
+				shrink(count);
+			} else {
+				if (count > _capacity)
+					realloc(get_recommended_capacity(
+						count));
+
+				construct(_data.get() + _size, count - _size);
+				flush_data(_size, count);
+				_size = count;
+			}
+		});
+	}
+
+	/**
+	 * Resizes the container to contain count elements. Additional
+	 * elements are copies of value.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 * @throw pmem::transaction_alloc_error when allocating memory
+	 *	for the underlying array failed.
+	 */
+	void
+	resize(size_type count, const value_type &value)
+	{
+		if (count <= _size) {
+			pool_base pb = get_pool();
+			transaction::exec_tx(pb, [&] { shrink(count); });
+		} else {
+			insert(cend(), count - _size, value);
+		}
+	}
+
+	/**
+	 * Exchanges the contents of the container with other. Only the
+	 * members of both vectors are added to the transaction, no
+	 * elements are copied.
+	 *
+	 * @throw pmem::transaction_error when the transaction failed.
+	 */
+	void
+	swap(vector &other)
+	{
+		pool_base pb = get_pool();
+		transaction::exec_tx(pb, [&] {
+			_data.swap(other._data);
+			_size.swap(other._size);
+			_capacity.swap(other._capacity);
+		});
+	}
+
+private:
+	/*
+	 * Checks that the vector resides in persistent memory and that
+	 * there is an active transaction.
+	 */
+	void
+	check_pmem_tx() const
+	{
+		if (pmemobj_pool_by_ptr(this) == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+			throw transaction_scope_error(
+				"Function called out of transaction scope.");
+	}
+
+	/*
+	 * Returns the pool in which the vector resides.
+	 */
+	pool_base
+	get_pool() const
+	{
+		auto pop = pmemobj_pool_by_ptr(this);
+		if (pop == nullptr)
+			throw pool_error("Invalid pool handle.");
+
+		return pool_base(pop);
+	}
+
+	/*
+	 * Returns index of the element pointed to by pos.
+	 */
+	size_type
+	index_of(const_iterator pos) const noexcept
+	{
+		return static_cast<size_type>(pos - cbegin());
+	}
+
+	/*
+	 * Checks whether ptr points to a live element.
+	 */
+	bool
+	points_into(const value_type *ptr) const noexcept
+	{
+		const T *data = _data.get();
+
+		return !std::less<const T *>()(ptr, data) &&
+			std::less<const T *>()(ptr, data + _size);
+	}
+
+	/*
+	 * Returns the capacity to which the vector should grow to hold at
+	 * least at_least elements - amortizes appends by doubling.
+	 */
+	size_type
+	get_recommended_capacity(size_type at_least) const
+	{
+		if (at_least > max_size())
+			throw std::length_error("vector::reserve");
+
+		size_type doubled = 2 * static_cast<size_type>(_capacity);
+		if (doubled > max_size())
+			doubled = max_size();
+
+		return (std::max)(at_least, doubled);
+	}
+
+	/*
+	 * Transactionally allocates uninitialized storage for count
+	 * elements. No constructors are called.
+	 */
+	persistent_ptr<T[]>
+	alloc(size_type count)
+	{
+		if (count > max_size())
+			throw std::length_error("vector::reserve");
+
+		if (count == 0)
+			return nullptr;
+
+		persistent_ptr<T[]> ptr = pmemobj_tx_alloc(
+			sizeof(value_type) * count, detail::type_num<T>());
+
+		if (ptr == nullptr)
+			throw transaction_alloc_error(
+				"failed to allocate persistent memory array");
+
+		return ptr;
+	}
+
+	/*
+	 * Destroys all elements and transactionally frees the storage.
+	 */
+	void
+	dealloc()
+	{
+		if (_data == nullptr)
+			return;
+
+		shrink(0);
+
+		if (pmemobj_tx_free(*_data.raw_ptr()) != 0)
+			throw transaction_free_error(
+				"failed to delete persistent memory object");
+
+		_data = nullptr;
+		_capacity = 0;
+	}
+
+	/*
+	 * Destroys elements from the old storage, frees it and installs
+	 * new_data, which already holds new_size constructed elements.
+	 */
+	void
+	replace_storage(persistent_ptr<T[]> new_data, size_type new_size,
+			size_type new_capacity)
+	{
+		dealloc();
+
+		_data = new_data;
+		_size = new_size;
+		_capacity = new_capacity;
+	}
+
+	/*
+	 * Moves all elements to a newly allocated storage of new_capacity
+	 * elements.
+	 */
+	void
+	realloc(size_type new_capacity)
+	{
+		assert(new_capacity >= _size);
+
+		size_type size = _size;
+		persistent_ptr<T[]> new_data = alloc(new_capacity);
+
+		relocate(new_data.get(), 0, size);
+		replace_storage(new_data, size, new_capacity);
+	}
+
+	/*
+	 * Moves elements [first, last) of the current storage to an
+	 * uninitialized, freshly allocated dest. Trivially copyable types
+	 * are copied in bulk, other types have the source range
+	 * snapshotted once, as moving may modify it.
+	 */
+	void
+	relocate(T *dest, size_type first, size_type last)
+	{
+		relocate(dest, first, last,
+			 std::integral_constant<
+				 bool,
+				 std::is_trivially_copyable<T>::value>());
+	}
+
+	void
+	relocate(T *dest, size_type first, size_type last, std::true_type)
+	{
+		if (first == last)
+			return;
+
+		pool_base pb = get_pool();
+		pb.memcpy_persist(dest, _data.get() + first,
+				  (last - first) * sizeof(value_type));
+	}
+
+	void
+	relocate(T *dest, size_type first, size_type last, std::false_type)
+	{
+		T *src = _data.get();
+
+		snapshot_data(first, last);
+		for (size_type i = first; i < last; ++i)
+			detail::create<T>(dest++, std::move(src[i]));
+	}
+
+	/*
+	 * Copy constructs elements from [first, last) at uninitialized
+	 * dest.
+	 */
+	template <typename InputIt>
+	void
+	copy_construct(T *dest, InputIt first, InputIt last)
+	{
+		for (; first != last; ++first)
+			detail::create<T>(dest++, *first);
+	}
+
+	/*
+	 * Constructs count elements from args at uninitialized dest.
+	 */
+	template <typename... Args>
+	void
+	construct(T *dest, size_type count, const Args &... args)
+	{
+		for (size_type i = 0; i < count; ++i)
+			detail::create<T>(dest + i, args...);
+	}
+
+	/*
+	 * Calls destructors of elements [first, last). Does not
+	 * snapshot anything.
+	 */
+	void
+	destroy(size_type first, size_type last)
+	{
+		T *data = _data.get();
+
+		for (size_type i = last; i > first; --i)
+			detail::destroy<T>(data[i - 1]);
+	}
+
+	/*
+	 * Removes elements beyond new_size. The removed range is always
+	 * snapshotted, even for trivial elements: the same transaction may
+	 * grow the vector again, and elements constructed beyond size() are
+	 * only flushed, so without the snapshot an abort would restore the
+	 * old size over overwritten elements.
+	 */
+	void
+	shrink(size_type new_size)
+	{
+		assert(new_size <= _size);
+
+		snapshot_data(new_size, _size);
+
+		destroy(new_size, _size);
+		_size = new_size;
+	}
+
+	/*
+	 * Replaces contents with count copies of value, in place.
+	 */
+	void
+	reassign(size_type count, const_reference value)
+	{
+		assert(count <= _capacity);
+
+		snapshot_data(0, _size);
+		destroy(0, _size);
+		construct(_data.get(), count, value);
+		flush_data(_size, count);
+		_size = count;
+	}
+
+	/*
+	 * Adds live elements [first, last) to a transaction as a single
+	 * range.
+	 */
+	void
+	snapshot_data(size_type first, size_type last)
+	{
+		if (first >= last)
+			return;
+
+		detail::conditional_add_to_tx(_data.get() + first,
+					      last - first);
+	}
+
+	/*
+	 * Flushes elements [first, last) constructed in the unused part of
+	 * the array. They are not snapshotted, so the transaction would not
+	 * flush them on commit, but the commit still drains before the new
+	 * size becomes durable.
+	 */
+	void
+	flush_data(size_type first, size_type last)
+	{
+		if (first >= last)
+			return;
+
+		pool_base pb = get_pool();
+		pb.flush(_data.get() + first,
+			 (last - first) * sizeof(value_type));
+	}
+
+	/*
+	 * Opens a gap of count elements at idx and fills it by calling
+	 * create(dest, n) for each position of the gap.
+	 *
+	 * If the elements do not fit, a new storage is allocated, new
+	 * elements are created in it first (so that they may refer to
+	 * the old elements) and then the old ones are relocated around
+	 * them. Otherwise the elements following idx are snapshotted as
+	 * one range and shifted to the uninitialized tail, which is not
+	 * snapshotted.
+	 *
+	 * create must not refer to the elements of this vector.
+	 */
+	template <typename Creator>
+	void
+	internal_insert(size_type idx, size_type count, Creator create)
+	{
+		if (count == 0)
+			return;
+
+		size_type size = _size;
+
+		if (size + count > _capacity) {
+			size_type new_cap =
+				get_recommended_capacity(size + count);
+			persistent_ptr<T[]> new_data = alloc(new_cap);
+			T *dest = new_data.get();
+
+			for (size_type i = 0; i < count; ++i)
+				create(dest + idx + i, i);
+
+			relocate(dest, 0, idx);
+			relocate(dest + idx + count, idx, size);
+
+			replace_storage(new_data, size + count, new_cap);
+			return;
+		}
+
+		T *data = _data.get();
+
+		snapshot_data(idx, size);
+
+		for (size_type i = size; i > idx; --i) {
+			size_type dest = i - 1 + count;
+
+			if (dest >= size)
+				detail::create<T>(data + dest,
+						  std::move(data[i - 1]));
+			else
+				data[dest] = std::move(data[i - 1]);
+		}
+
+		for (size_type i = 0; i < count; ++i) {
+			if (idx + i < size)
+				detail::destroy<T>(data[idx + i]);
+
+			create(data + idx + i, i);
+		}
+
+		flush_data(size, size + count);
+		_size = size + count;
+	}
+
+	/* Underlying array */
+	persistent_ptr<T[]> _data;
+
+	/* Number of live elements */
+	p<size_type> _size;
+
+	/* Number of elements which fit in the underlying array */
+	p<size_type> _capacity;
+};
+
+/**
+ * Non-member equal operator.
+ */
+template <typename T>
+inline bool
+operator==(const vector<T> &lhs, const vector<T> &rhs)
+{
+	return lhs.size() == rhs.size() &&
+		std::equal(lhs.cbegin(), lhs.cend(), rhs.cbegin());
+}
+
+/**
+ * Non-member not-equal operator.
+ */
+template <typename T>
+inline bool
+operator!=(const vector<T> &lhs, const vector<T> &rhs)
+{
+	return !(lhs == rhs);
+}
+
+/**
+ * Non-member less than operator.
+ */
+template <typename T>
+inline bool
+operator<(const vector<T> &lhs, const vector<T> &rhs)
+{
+	return std::lexicographical_compare(lhs.cbegin(), lhs.cend(),
+					    rhs.cbegin(), rhs.cend());
+}
+
+/**
+ * Non-member greater than operator.
+ */
+template <typename T>
+inline bool
+operator>(const vector<T> &lhs, const vector<T> &rhs)
+{
+	return rhs < lhs;
+}
+
+/**
+ * Non-member greater or equal operator.
+ */
+template <typename T>
+inline bool
+operator>=(const vector<T> &lhs, const vector<T> &rhs)
+{
+	return !(lhs < rhs);
+}
+
+/**
+ * Non-member less or equal operator.
+ */
+template <typename T>
+inline bool
+operator<=(const vector<T> &lhs, const vector<T> &rhs)
+{
+	return !(lhs > rhs);
+}
+
+/**
+ * Non-member swap function.
+ */
+template <typename T>
+inline void
+swap(vector<T> &lhs, vector<T> &rhs)
+{
+	lhs.swap(rhs);
+}
+
+} /* namespace experimental */
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* PMEMOBJ_VECTOR_HPP */
@@ -40,6 +40,7 @@
 #ifndef PMEMOBJ_MAKE_PERSISTENT_HPP
 #define PMEMOBJ_MAKE_PERSISTENT_HPP
 
+#include "libpmemobj++/allocation_flag.hpp"
 #include "libpmemobj++/detail/check_persistent_ptr_array.hpp"
 #include "libpmemobj++/detail/common.hpp"
 #include "libpmemobj++/detail/life.hpp"
@@ -59,8 +60,10 @@ namespace obj
  * Transactionally allocate and construct an object of type T.
  *
  * This function can be used to *transactionally* allocate an object.
- * Cannot be used for array types.
+ * Cannot be used for array types. The object is allocated from the
+ * allocation class of T, see alloc_class_traits.
  *
+ * @param[in] flag affects how the object is allocated.
  * @param[in,out] args a list of parameters passed to the constructor.
  *
  * @return persistent_ptr<T> on success
@@ -71,7 +74,7 @@ namespace obj
  */
 template <typename T, typename... Args>
 typename detail::pp_if_not_array<T>::type
-make_persistent(Args &&... args)
+make_persistent(allocation_flag flag, Args &&... args)
 {
 	if (pmemobj_tx_stage() != TX_STAGE_WORK)
 		throw transaction_scope_error(
@@ -79,15 +82,22 @@ make_persistent(Args &&... args)
 			"memory outside of transaction scope");
 
 	persistent_ptr<T> ptr =
-		pmemobj_tx_alloc(sizeof(T), detail::type_num<T>());
+		pmemobj_tx_xalloc(sizeof(T), detail::type_num<T>(),
+				  detail::alloc_class_flags<T>(flag.value));
 
 	if (ptr == nullptr)
 		throw transaction_alloc_error("failed to allocate "
 					      "persistent memory object");
+
+	detail::tx_allocated(ptr.get(), sizeof(T), flag.value);
+	detail::tx_stats_add(detail::tx_counter_allocations);
+	detail::tx_stats_add(detail::tx_counter_allocation_bytes, sizeof(T));
+
 	try {
 		detail::create<T, Args...>(ptr.get(),
 					   std::forward<Args>(args)...);
 	} catch (...) {
+		detail::tx_freeing(*ptr.raw_ptr());
 		pmemobj_tx_free(*ptr.raw_ptr());
 		throw;
 	}
@@ -95,6 +105,29 @@ make_persistent(Args &&... args)
 	return ptr;
 }
 
+/**
+ * Transactionally allocate and construct an object of type T.
+ *
+ * This function can be used to *transactionally* allocate an object.
+ * Cannot be used for array types. The object is allocated from the
+ * allocation class of T, see alloc_class_traits.
+ *
+ * @param[in,out] args a list of parameters passed to the constructor.
+ *
+ * @return persistent_ptr<T> on success
+ *
+ * @throw transaction_scope_error if called outside of an active
+ * transaction
+ * @throw transaction_alloc_error on transactional allocation failure.
+ */
+template <typename T, typename... Args>
+typename detail::pp_if_not_array<T>::type
+make_persistent(Args &&... args)
+{
+	return make_persistent<T>(allocation_flag::none(),
+				  std::forward<Args>(args)...);
+}
+
 /**
  * Transactionally free an object of type T held in a persitent_ptr.
  *
@@ -127,9 +160,13 @@ delete_persistent(typename detail::pp_if_not_array<T>::type ptr)
 	 */
 	detail::destroy<T>(*ptr);
 
+	detail::tx_freeing(*ptr.raw_ptr());
+
 	if (pmemobj_tx_free(*ptr.raw_ptr()) != 0)
 		throw transaction_free_error("failed to delete "
 					     "persistent memory object");
+
+	detail::tx_stats_add(detail::tx_counter_frees);
 }
 
 } /* namespace obj */
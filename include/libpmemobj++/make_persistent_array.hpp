@@ -40,6 +40,7 @@
 #ifndef PMEMOBJ_MAKE_PERSISTENT_ARRAY_HPP
 #define PMEMOBJ_MAKE_PERSISTENT_ARRAY_HPP
 
+#include "libpmemobj++/allocation_flag.hpp"
 #include "libpmemobj++/detail/array_traits.hpp"
 #include "libpmemobj++/detail/check_persistent_ptr_array.hpp"
 #include "libpmemobj++/detail/common.hpp"
@@ -48,11 +49,80 @@
 #include "libpmemobj/tx_base.h"
 
 #include <cassert>
+#include <cstdint>
 #include <limits>
+#include <type_traits>
 
 namespace pmem
 {
 
+namespace detail
+{
+
+/*
+ * Allocate an array of N objects of type I in the active transaction.
+ *
+ * The elements are default constructed, unless I is trivially default
+ * constructible, in which case construction is skipped and the memory
+ * is zeroed by libpmemobj if flags contain POBJ_XALLOC_ZERO.
+ */
+template <typename T, typename I>
+obj::persistent_ptr<T>
+make_persistent_array(std::size_t N, uint64_t flags)
+{
+	if (pmemobj_tx_stage() != TX_STAGE_WORK)
+		throw transaction_scope_error(
+			"refusing to allocate "
+			"memory outside of transaction scope");
+
+	obj::persistent_ptr<T> ptr =
+		pmemobj_tx_xalloc(sizeof(I) * N, detail::type_num<I>(), flags);
+
+	if (ptr == nullptr)
+		throw transaction_alloc_error("failed to allocate "
+					      "persistent memory array");
+
+	detail::tx_allocated(ptr.get(), sizeof(I) * N, flags);
+	detail::tx_stats_add(detail::tx_counter_allocations);
+	detail::tx_stats_add(detail::tx_counter_allocation_bytes,
+			     sizeof(I) * N);
+
+	if (std::is_trivially_default_constructible<I>::value)
+		return ptr;
+
+	I *elems = ptr.get();
+	std::ptrdiff_t i;
+	try {
+		for (i = 0; i < static_cast<std::ptrdiff_t>(N); ++i)
+			detail::create<I>(elems + i);
+	} catch (...) {
+		for (std::ptrdiff_t j = 1; j <= i; ++j)
+			detail::destroy<I>(elems[i - j]);
+		detail::tx_freeing(*ptr.raw_ptr());
+		pmemobj_tx_free(*ptr.raw_ptr());
+		throw;
+	}
+
+	return ptr;
+}
+
+/*
+ * Return the libpmemobj flags of an array allocation. Arrays of trivially
+ * default constructible objects are zeroed, as their value
+ * initialization would, unless flag includes allocation_flag::no_zero().
+ */
+template <typename I>
+constexpr uint64_t
+array_flags(obj::allocation_flag flag)
+{
+	return std::is_trivially_default_constructible<I>::value &&
+			!flag.skip_zero
+		? flag.value | POBJ_XALLOC_ZERO
+		: flag.value;
+}
+
+} /* namespace detail */
+
 namespace obj
 {
 
@@ -60,7 +130,9 @@ namespace obj
  * Transactionally allocate and construct an array of objects of type T.
  *
  * This function can be used to *transactionally* allocate an array.
- * Cannot be used for simple objects.
+ * Cannot be used for simple objects. Arrays of trivially default
+ * constructible objects are zeroed by libpmemobj instead of constructing
+ * each element.
  *
  * @param[in] N the number of array elements.
  *
@@ -73,6 +145,33 @@ namespace obj
 template <typename T>
 typename detail::pp_if_array<T>::type
 make_persistent(std::size_t N)
+{
+	return make_persistent<T>(N, allocation_flag::none());
+}
+
+/**
+ * Transactionally allocate an array of objects of type T with the given
+ * allocation flags.
+ *
+ * This function can be used to *transactionally* allocate an array.
+ * Cannot be used for simple objects. The elements are default
+ * constructed, unless T is trivially default constructible. Such arrays
+ * are zeroed, as without flags, or left uninitialized if flag includes
+ * allocation_flag::no_zero(), which is the fastest way to allocate large
+ * buffers.
+ *
+ * @param[in] N the number of array elements.
+ * @param[in] flag affects how the array is allocated.
+ *
+ * @return persistent_ptr<T[]> on success
+ *
+ * @throw transaction_scope_error if called outside of an active
+ * transaction
+ * @throw transaction_alloc_error on transactional allocation failure.
+ */
+template <typename T>
+typename detail::pp_if_array<T>::type
+make_persistent(std::size_t N, allocation_flag flag)
 {
 	typedef typename detail::pp_array_type<T>::type I;
 
@@ -84,37 +183,17 @@ make_persistent(std::size_t N)
 	assert(N <=
 	       static_cast<std::size_t>(std::numeric_limits<ptrdiff_t>::max()));
 
-	if (pmemobj_tx_stage() != TX_STAGE_WORK)
-		throw transaction_scope_error(
-			"refusing to allocate "
-			"memory outside of transaction scope");
-
-	persistent_ptr<T> ptr =
-		pmemobj_tx_alloc(sizeof(I) * N, detail::type_num<I>());
-
-	if (ptr == nullptr)
-		throw transaction_alloc_error("failed to allocate "
-					      "persistent memory array");
-
-	std::ptrdiff_t i;
-	try {
-		for (i = 0; i < static_cast<std::ptrdiff_t>(N); ++i)
-			detail::create<I>(ptr.get() + i);
-	} catch (...) {
-		for (std::ptrdiff_t j = 1; j <= i; ++j)
-			detail::destroy<I>(ptr[i - j]);
-		pmemobj_tx_free(*ptr.raw_ptr());
-		throw;
-	}
-
-	return ptr;
+	return detail::make_persistent_array<T, I>(
+		N, detail::array_flags<I>(flag));
 }
 
 /**
  * Transactionally allocate and construct an array of objects of type T.
  *
  * This function can be used to *transactionally* allocate an array.
- * Cannot be used for simple objects.
+ * Cannot be used for simple objects. Arrays of trivially default
+ * constructible objects are zeroed by libpmemobj instead of constructing
+ * each element.
  *
  * @return persistent_ptr<T[N]> on success
  *
@@ -125,34 +204,37 @@ make_persistent(std::size_t N)
 template <typename T>
 typename detail::pp_if_size_array<T>::type
 make_persistent()
+{
+	return make_persistent<T>(allocation_flag::none());
+}
+
+/**
+ * Transactionally allocate an array of objects of type T with the given
+ * allocation flags.
+ *
+ * This function can be used to *transactionally* allocate an array.
+ * Cannot be used for simple objects. The elements are default
+ * constructed, unless T is trivially default constructible. Such arrays
+ * are zeroed, as without flags, or left uninitialized if flag includes
+ * allocation_flag::no_zero().
+ *
+ * @param[in] flag affects how the array is allocated.
+ *
+ * @return persistent_ptr<T[N]> on success
+ *
+ * @throw transaction_scope_error if called outside of an active
+ * transaction
+ * @throw transaction_alloc_error on transactional allocation failure.
+ */
+template <typename T>
+typename detail::pp_if_size_array<T>::type
+make_persistent(allocation_flag flag)
 {
 	typedef typename detail::pp_array_type<T>::type I;
 	enum { N = detail::pp_array_elems<T>::elems };
 
-	if (pmemobj_tx_stage() != TX_STAGE_WORK)
-		throw transaction_scope_error(
-			"refusing to allocate "
-			"memory outside of transaction scope");
-
-	persistent_ptr<T> ptr =
-		pmemobj_tx_alloc(sizeof(I) * N, detail::type_num<I>());
-
-	if (ptr == nullptr)
-		throw transaction_alloc_error("failed to allocate "
-					      "persistent memory array");
-
-	std::ptrdiff_t i;
-	try {
-		for (i = 0; i < static_cast<std::ptrdiff_t>(N); ++i)
-			detail::create<I>(ptr.get() + i);
-	} catch (...) {
-		for (std::ptrdiff_t j = 1; j <= i; ++j)
-			detail::destroy<I>(ptr[i - j]);
-		pmemobj_tx_free(*ptr.raw_ptr());
-		throw;
-	}
-
-	return ptr;
+	return detail::make_persistent_array<T, I>(
+		N, detail::array_flags<I>(flag));
 }
 
 /**
@@ -187,9 +269,13 @@ delete_persistent(typename detail::pp_if_array<T>::type ptr, std::size_t N)
 	for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(N); ++i)
 		detail::destroy<I>(ptr[static_cast<std::ptrdiff_t>(N) - 1 - i]);
 
+	detail::tx_freeing(*ptr.raw_ptr());
+
 	if (pmemobj_tx_free(*ptr.raw_ptr()) != 0)
 		throw transaction_free_error("failed to delete "
 					     "persistent memory object");
+
+	detail::tx_stats_add(detail::tx_counter_frees);
 }
 
 /**
@@ -224,9 +310,13 @@ delete_persistent(typename detail::pp_if_size_array<T>::type ptr)
 	for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(N); ++i)
 		detail::destroy<I>(ptr[static_cast<std::ptrdiff_t>(N) - 1 - i]);
 
+	detail::tx_freeing(*ptr.raw_ptr());
+
 	if (pmemobj_tx_free(*ptr.raw_ptr()) != 0)
 		throw transaction_free_error("failed to delete "
 					     "persistent memory object");
+
+	detail::tx_stats_add(detail::tx_counter_frees);
 }
 
 } /* namespace obj */
@@ -40,6 +40,7 @@
 #ifndef PMEMOBJ_MAKE_PERSISTENT_ATOMIC_HPP
 #define PMEMOBJ_MAKE_PERSISTENT_ATOMIC_HPP
 
+#include "libpmemobj++/allocation_flag.hpp"
 #include "libpmemobj++/detail/check_persistent_ptr_array.hpp"
 #include "libpmemobj++/detail/common.hpp"
 #include "libpmemobj++/detail/make_atomic_impl.hpp"
@@ -48,6 +49,7 @@
 #include "libpmemobj/atomic_base.h"
 
 #include <tuple>
+#include <utility>
 
 namespace pmem
 {
@@ -65,6 +67,7 @@ namespace obj
  * @param[in,out] pool the pool from which the object will be allocated.
  * @param[in,out] ptr the persistent pointer to which the allocation
  * will take place.
+ * @param[in] flag affects how the object is allocated.
  * @param[in] args variadic function parameter containing all parameters
  * passed to the objects constructor.
  *
@@ -74,18 +77,44 @@ template <typename T, typename... Args>
 void
 make_persistent_atomic(pool_base &pool,
 		       typename detail::pp_if_not_array<T>::type &ptr,
-		       Args &&... args)
+		       allocation_flag flag, Args &&... args)
 {
 	std::tuple<Args &...> arg_pack{args...};
-	auto ret = pmemobj_alloc(pool.get_handle(), ptr.raw_ptr(), sizeof(T),
-				 detail::type_num<T>(),
-				 &detail::obj_constructor<T, Args...>,
-				 static_cast<void *>(&arg_pack));
+	auto ret = pmemobj_xalloc(pool.get_handle(), ptr.raw_ptr(), sizeof(T),
+				  detail::type_num<T>(),
+				  detail::alloc_class_flags<T>(flag.value),
+				  &detail::obj_constructor<T, Args...>,
+				  static_cast<void *>(&arg_pack));
 
 	if (ret != 0)
 		throw std::bad_alloc();
 }
 
+/**
+ * Atomically allocate and construct an object.
+ *
+ * Constructor parameters are passed through variadic parameters. Do *NOT* use
+ * this inside transactions, as it might lead to undefined behavior in the
+ * presence of transaction aborts.
+ *
+ * @param[in,out] pool the pool from which the object will be allocated.
+ * @param[in,out] ptr the persistent pointer to which the allocation
+ * will take place.
+ * @param[in] args variadic function parameter containing all parameters
+ * passed to the objects constructor.
+ *
+ * @throw std::bad_alloc on allocation failure.
+ */
+template <typename T, typename... Args>
+void
+make_persistent_atomic(pool_base &pool,
+		       typename detail::pp_if_not_array<T>::type &ptr,
+		       Args &&... args)
+{
+	make_persistent_atomic<T>(pool, ptr, allocation_flag::none(),
+				  std::forward<Args>(args)...);
+}
+
 /**
  * Atomically deallocate an object.
  *
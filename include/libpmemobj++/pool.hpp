@@ -42,8 +42,10 @@
 #include <string>
 #include <sys/stat.h>
 
+#include "libpmemobj++/alloc_class.hpp"
 #include "libpmemobj++/detail/pexceptions.hpp"
 #include "libpmemobj++/p.hpp"
+#include "libpmemobj/ctl.h"
 #include "libpmemobj/pool_base.h"
 
 namespace pmem
@@ -385,6 +387,134 @@ public:
 		return pmemobj_memset_persist(this->pop, dest, c, len);
 	}
 
+	/**
+	 * Registers a custom allocation class in the pool.
+	 *
+	 * Allocation classes are not persistent, so they have to be
+	 * registered every time the pool is opened.
+	 *
+	 * @param[in] unit_size the size of the units the class allocates,
+	 *	including the object header.
+	 * @param[in] units_per_block the number of units in a block of
+	 *	memory reserved for the class at once.
+	 * @param[in] header_type the header of the objects allocated from
+	 *	the class. Objects without a header have no type number.
+	 *
+	 * @return the id of the class, e.g. for POBJ_CLASS_ID.
+	 *
+	 * @throw pmem::pool_error if the class could not be registered.
+	 */
+	unsigned
+	register_alloc_class(size_t unit_size, unsigned units_per_block,
+			     pobj_header_type header_type = POBJ_HEADER_COMPACT)
+	{
+		return add_alloc_class("heap.alloc_class.new.desc", unit_size,
+				       units_per_block, header_type);
+	}
+
+	/**
+	 * Registers the allocation class of T, see alloc_class_traits.
+	 *
+	 * The class is registered under the id given by the trait, with
+	 * units fitting one object of T and its header.
+	 *
+	 * @param[in] units_per_block the number of units in a block of
+	 *	memory reserved for the class at once.
+	 * @param[in] header_type the header of the objects allocated from
+	 *	the class. Objects without a header have no type number.
+	 *
+	 * @throw pmem::pool_error if the class could not be registered,
+	 *	e.g. because the id is already taken.
+	 */
+	template <typename T>
+	void
+	register_alloc_class(unsigned units_per_block = 1024,
+			     pobj_header_type header_type = POBJ_HEADER_COMPACT)
+	{
+		static_assert(alloc_class_traits<T>::id != 0,
+			      "alloc_class_traits<T> is not specialized");
+
+		std::string name = "heap.alloc_class." +
+			std::to_string(alloc_class_traits<T>::id) + ".desc";
+
+		size_t unit_size =
+			sizeof(T) + detail::alloc_header_size(header_type);
+
+		add_alloc_class(name.c_str(), unit_size, units_per_block,
+				header_type);
+	}
+
+	/**
+	 * Returns the number of arenas of the pool.
+	 *
+	 * @throw pmem::pool_error if the number could not be read.
+	 */
+	unsigned
+	arena_count()
+	{
+		unsigned n;
+		if (pmemobj_ctl_get(this->pop, "heap.narenas.total", &n))
+			throw pool_error("Failed reading number of arenas");
+
+		return n;
+	}
+
+	/**
+	 * Returns the id of the arena the calling thread allocates from.
+	 *
+	 * @throw pmem::pool_error if the arena could not be read.
+	 */
+	unsigned
+	thread_arena()
+	{
+		unsigned id;
+		if (pmemobj_ctl_get(this->pop, "heap.thread.arena_id", &id))
+			throw pool_error("Failed reading arena of thread");
+
+		return id;
+	}
+
+	/**
+	 * Binds the calling thread to an arena of the pool.
+	 *
+	 * All later allocations of the thread from the pool, including
+	 * those of make_persistent, make_persistent_atomic and
+	 * pmem::obj::allocator, are served by the arena, so threads bound
+	 * to different arenas do not contend for the same allocator locks.
+	 * By default libpmemobj assigns the threads to arenas round-robin.
+	 *
+	 * @param[in] id the id of the arena, from 1 to arena_count().
+	 *
+	 * @throw pmem::pool_error if the thread could not be bound.
+	 */
+	void
+	set_thread_arena(unsigned id)
+	{
+		if (pmemobj_ctl_set(this->pop, "heap.thread.arena_id", &id))
+			throw pool_error("Failed setting arena of thread");
+	}
+
+#ifdef POBJ_ARENA_ID
+	/**
+	 * Creates a new arena in the pool, which is not assigned to any
+	 * thread by default.
+	 *
+	 * @return the id of the arena, for set_thread_arena() or
+	 *	allocation_flag::arena_id().
+	 *
+	 * @throw pmem::pool_error if the arena could not be created.
+	 */
+	unsigned
+	create_arena()
+	{
+		unsigned id;
+		if (pmemobj_ctl_exec(this->pop, "heap.arena.create", &id))
+			throw pool_error("Failed creating arena");
+
+		return id;
+	}
+#endif
+
 	/*
 	 * Gets the C style handle to the pool.
 	 *
@@ -399,6 +529,24 @@ public:
 	}
 
 protected:
+	/*
+	 * Registers an allocation class under the given ctl name.
+	 */
+	unsigned
+	add_alloc_class(const char *name, size_t unit_size,
+			unsigned units_per_block, pobj_header_type header_type)
+	{
+		pobj_alloc_class_desc desc = {};
+		desc.unit_size = unit_size;
+		desc.units_per_block = units_per_block;
+		desc.header_type = header_type;
+
+		if (pmemobj_ctl_set(this->pop, name, &desc) != 0)
+			throw pool_error("Failed registering allocation class");
+
+		return desc.class_id;
+	}
+
 	/* The pool opaque handle */
 	PMEMobjpool *pop;
 
@@ -40,9 +40,18 @@
 
 #include <functional>
 #include <string>
+#include <type_traits>
+#include <vector>
 
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/detail/inline_callback.hpp"
 #include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj++/detail/small_vector.hpp"
+#include "libpmemobj++/detail/snapshot_cache.hpp"
+#include "libpmemobj++/detail/tx_stats.hpp"
+#include "libpmemobj++/detail/write_set.hpp"
 #include "libpmemobj++/pool.hpp"
+#include "libpmemobj/action_base.h"
 #include "libpmemobj/tx_base.h"
 
 namespace pmem
@@ -106,6 +115,8 @@ public:
 		template <typename... L>
 		manual(obj::pool_base &pop, L &... locks)
 		{
+			bool outermost = pmemobj_tx_stage() == TX_STAGE_NONE;
+
 			if (pmemobj_tx_begin(pop.get_handle(), nullptr,
 					     TX_PARAM_NONE) != 0)
 				throw transaction_error(
@@ -118,6 +129,8 @@ public:
 				throw transaction_error("failed to"
 							" add lock");
 			}
+
+			tx_begin(outermost);
 		}
 
 		/**
@@ -133,7 +146,7 @@ public:
 			if (pmemobj_tx_stage() == TX_STAGE_WORK)
 				pmemobj_tx_abort(ECANCELED);
 
-			(void)pmemobj_tx_end();
+			tx_end();
 		}
 
 		/**
@@ -224,7 +237,7 @@ public:
 
 			/* transaction ended normally */
 			if (pmemobj_tx_stage() == TX_STAGE_WORK)
-				pmemobj_tx_commit();
+				tx_commit();
 			/* transaction aborted, throw an exception */
 			else if (pmemobj_tx_stage() == TX_STAGE_ONABORT ||
 				 (pmemobj_tx_stage() == TX_STAGE_FINALLY &&
@@ -293,6 +306,197 @@ public:
 	};
 #endif /* __cpp_lib_uncaught_exceptions */
 
+	/**
+	 * C++ redo log based transaction for small updates.
+	 *
+	 * Writes made with set() are buffered in volatile memory and do not
+	 * modify the pool until commit(), which applies all of them
+	 * atomically with a single redo log, using the pmemobj action API.
+	 * Unlike in the undo log based transactions, nothing is logged and
+	 * persisted before each write, which makes it much cheaper for
+	 * a number of small, scattered updates. The buffered values can be
+	 * read back with get(). If the object is destroyed without commit(),
+	 * the writes are discarded.
+	 *
+	 * Memory is written in aligned 8-byte words. The bytes of a word not
+	 * covered by set() keep the value they had at the first write to the
+	 * word, so they must not be modified concurrently.
+	 *
+	 * Only the writes made with set() are a part of the transaction,
+	 * objects cannot be allocated or freed in it. If committed in an
+	 * active undo log based transaction, the writes are published as
+	 * a part of it.
+	 *
+	 * The class is not thread-safe.
+	 */
+	class redo {
+	public:
+		/**
+		 * Start an empty redo transaction on the pool.
+		 *
+		 * @param[in,out] pop pool object.
+		 */
+		explicit redo(obj::pool_base &pop) : pop(pop.get_handle())
+		{
+		}
+
+		/**
+		 * Buffer a write of value to field.
+		 *
+		 * @param[in,out] field the property to be written.
+		 * @param[in] value the new value.
+		 *
+		 * @throw pool_error if field is not in the pool of the
+		 *	transaction.
+		 */
+		template <typename T>
+		void
+		set(p<T> &field, const T &value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value,
+				      "T has to be trivially copyable");
+
+			write(&field.get_ro(), &value, sizeof(T));
+		}
+
+		/**
+		 * Buffer a write of value to the pointer field.
+		 *
+		 * @param[in,out] field the pointer to be written.
+		 * @param[in] value the new value.
+		 *
+		 * @throw pool_error if field is not in the pool of the
+		 *	transaction.
+		 */
+		template <typename T>
+		void
+		set(persistent_ptr<T> &field, const persistent_ptr<T> &value)
+		{
+			PMEMoid oid = value.raw();
+
+			write(field.raw_ptr(), &oid, sizeof(oid));
+		}
+
+		/**
+		 * Read field as it will be after commit.
+		 *
+		 * @param[in] field the property to be read.
+		 *
+		 * @return the buffered value of field, or its current value
+		 *	if it was not written.
+		 */
+		template <typename T>
+		T
+		get(const p<T> &field) const
+		{
+			static_assert(std::is_trivially_copyable<T>::value,
+				      "T has to be trivially copyable");
+
+			T value;
+			read(&value, &field.get_ro(), sizeof(T));
+
+			return value;
+		}
+
+		/**
+		 * Read the pointer field as it will be after commit.
+		 *
+		 * @param[in] field the pointer to be read.
+		 *
+		 * @return the buffered value of field, or its current value
+		 *	if it was not written.
+		 */
+		template <typename T>
+		persistent_ptr<T>
+		get(const persistent_ptr<T> &field) const
+		{
+			PMEMoid oid;
+			read(&oid, &field.raw(), sizeof(oid));
+
+			return persistent_ptr<T>(oid);
+		}
+
+		/**
+		 * Check whether there are no buffered writes.
+		 */
+		bool
+		empty() const noexcept
+		{
+			return writes.empty();
+		}
+
+		/**
+		 * Atomically apply all buffered writes.
+		 *
+		 * The writes are persistent when the function returns. The
+		 * transaction is empty afterwards and can be reused.
+		 *
+		 * @throw transaction_error if the writes could not be
+		 *	published.
+		 */
+		void
+		commit()
+		{
+			if (writes.empty())
+				return;
+
+#ifdef POBJ_MAX_ACTIONS
+			if (writes.size() > POBJ_MAX_ACTIONS)
+				throw transaction_error(
+					"too many writes in redo transaction");
+#endif
+
+			std::vector<pobj_action> actv(writes.size());
+			writes.set_values(pop, actv.data());
+
+			int ret;
+			if (pmemobj_tx_stage() == TX_STAGE_WORK)
+				ret = pmemobj_tx_publish(actv.data(),
+							 actv.size());
+			else
+				ret = pmemobj_publish(pop, actv.data(),
+						      actv.size());
+
+			if (ret != 0)
+				throw transaction_error(
+					"failed to publish redo transaction");
+
+			writes.clear();
+		}
+
+		redo(const redo &) = delete;
+
+		redo &operator=(const redo &) = delete;
+
+	private:
+		/*
+		 * Buffers a write of size bytes from src to dst.
+		 */
+		void
+		write(const void *dst, const void *src, std::size_t size)
+		{
+			if (pmemobj_pool_by_ptr(dst) != pop)
+				throw pool_error(
+					"Object outside of the transaction's "
+					"pool.");
+
+			writes.write(dst, src, size);
+		}
+
+		/*
+		 * Reads size bytes of src, as they will be after commit.
+		 */
+		void
+		read(void *dst, const void *src, std::size_t size) const
+		{
+			writes.read(dst, src, size);
+		}
+
+		PMEMobjpool *pop;
+
+		detail::write_set writes;
+	};
+
 	/*
 	 * Deleted default constructor.
 	 */
@@ -348,7 +552,7 @@ public:
 			throw transaction_error("wrong stage for"
 						" commit");
 
-		pmemobj_tx_commit();
+		tx_commit();
 	}
 
 	static int
@@ -357,6 +561,87 @@ public:
 		return pmemobj_tx_errno();
 	}
 
+	/**
+	 * Stages at which a callback can be run.
+	 */
+	enum class stage_type {
+		oncommit, /**< after the transaction was committed */
+		onabort,  /**< after the transaction was aborted */
+		finally,  /**< after the transaction ended either way */
+	};
+
+	/**
+	 * Maximum size of a callback passed to register_callback, i.e. of
+	 * the captures of a lambda.
+	 */
+	static constexpr std::size_t max_callback_size = 6 * sizeof(void *);
+
+	/**
+	 * Register a callback to be run when the current outermost
+	 * transaction has ended.
+	 *
+	 * The callbacks of a stage run in the order of registration, the
+	 * oncommit or onabort ones first, followed by the finally ones. They
+	 * run after the transaction is ended and durable, so they can start
+	 * new transactions, e.g. to update volatile state which mirrors the
+	 * pool only once a change is committed. A callback must not throw,
+	 * std::terminate is called otherwise.
+	 *
+	 * The callback is stored by value, not wrapped in std::function,
+	 * so it must be at most max_callback_size bytes large, which is
+	 * checked at compile time. The first few callbacks of each stage are
+	 * kept without allocating memory. Only transactions started by the
+	 * classes and methods of pmem::obj::transaction support callbacks.
+	 *
+	 * @param[in] stg the stage to run the callback at.
+	 * @param[in] cb the callback, a nothrow movable callable taking no
+	 *	arguments.
+	 *
+	 * @throw transaction_scope_error if called outside of a transaction
+	 *	started by pmem::obj::transaction.
+	 */
+	template <typename F>
+	static void
+	register_callback(stage_type stg, F &&cb)
+	{
+		auto &data = callbacks();
+
+		if (pmemobj_tx_stage() != TX_STAGE_WORK || !data.active)
+			throw transaction_scope_error(
+				"register_callback called outside of a "
+				"transaction");
+
+		data.lists[static_cast<std::size_t>(stg)].push_back(
+			callback(std::forward<F>(cb)));
+	}
+
+	/**
+	 * Add a number of objects, e.g. the fields of a struct about to be
+	 * modified, to the active transaction at once.
+	 *
+	 * The objects are sorted by address and the adjacent ones are added
+	 * as a single range, so that modifying N neighbouring fields costs
+	 * one undo log entry instead of N. The later writes to the objects
+	 * through p<> do not add them again. Does nothing outside of
+	 * a transaction, as p<> does.
+	 *
+	 * @param[in] fields the objects to add, which have to be within
+	 *	the pool of the active transaction.
+	 *
+	 * @throw transaction_error if the objects could not be added to
+	 *	the transaction.
+	 */
+	template <typename... Fields>
+	static void
+	snapshot(const Fields &... fields)
+	{
+		static_assert(sizeof...(Fields) > 0, "no fields to snapshot");
+
+		detail::tx_range ranges[] = {detail::make_tx_range(fields)...};
+
+		detail::add_ranges_to_tx(ranges, ranges + sizeof...(Fields));
+	}
+
 	/**
 	 * Execute a closure-like transaction and lock `locks`.
 	 *
@@ -379,8 +664,10 @@ public:
 	 *
 	 * @param[in,out] pool the pool in which the transaction will take
 	 *	place.
-	 * @param[in] tx an std::function<void ()> which will perform
-	 *	operations within this transaction.
+	 * @param[in] tx a callable taking no arguments, e.g. a lambda or
+	 *	an std::function<void ()>, which will perform operations
+	 *	within this transaction. It is invoked directly, so it is
+	 *	neither copied nor wrapped in an std::function.
 	 * @param[in,out] locks locks to be taken for the duration of
 	 *	the transaction.
 	 *
@@ -388,10 +675,12 @@ public:
 	 *	of the transaction.
 	 * @throw manual_tx_abort on manual transaction abort.
 	 */
-	template <typename... Locks>
+	template <typename Func, typename... Locks>
 	static void
-	exec_tx(pool_base &pool, std::function<void()> tx, Locks &... locks)
+	exec_tx(pool_base &pool, Func &&tx, Locks &... locks)
 	{
+		bool outermost = pmemobj_tx_stage() == TX_STAGE_NONE;
+
 		if (pmemobj_tx_begin(pool.get_handle(), nullptr,
 				     TX_PARAM_NONE) != 0)
 			throw transaction_error("failed to start transaction");
@@ -405,10 +694,12 @@ public:
 						" transaction");
 		}
 
+		tx_begin(outermost);
+
 		try {
 			tx();
 		} catch (manual_tx_abort &) {
-			(void)pmemobj_tx_end();
+			tx_end();
 			throw;
 		} catch (...) {
 			/* first exception caught */
@@ -416,26 +707,121 @@ public:
 				pmemobj_tx_abort(ECANCELED);
 
 			/* waterfall tx_end for outer tx */
-			(void)pmemobj_tx_end();
+			tx_end();
 			throw;
 		}
 
 		auto stage = pmemobj_tx_stage();
 
 		if (stage == TX_STAGE_WORK) {
-			pmemobj_tx_commit();
+			tx_commit();
 		} else if (stage == TX_STAGE_ONABORT) {
-			(void)pmemobj_tx_end();
+			tx_end();
 			throw transaction_error("transaction aborted");
 		} else if (stage == TX_STAGE_NONE) {
+			tx_ended(pmemobj_tx_errno());
 			throw transaction_error("transaction ended"
 						"prematurely");
 		}
 
-		(void)pmemobj_tx_end();
+		tx_end();
 	}
 
 private:
+	using callback = detail::inline_callback<max_callback_size>;
+	using callback_list = detail::small_vector<callback, 4>;
+
+	/**
+	 * Callbacks registered in the current outermost transaction of
+	 * a thread.
+	 */
+	struct callback_data {
+		callback_data() : active(false)
+		{
+		}
+
+		callback_list lists[3];
+
+		/* whether the transaction was started by this class */
+		bool active;
+	};
+
+	static callback_data &
+	callbacks() noexcept
+	{
+		static thread_local callback_data data;
+
+		return data;
+	}
+
+	/**
+	 * Set up the per-thread state after a transaction was started.
+	 */
+	static void
+	tx_begin(bool outermost) noexcept
+	{
+		detail::tx_stats_begin(outermost);
+		detail::snapshot_cache::get().tx_begin(outermost);
+
+		if (outermost)
+			callbacks().active = true;
+	}
+
+	/**
+	 * Commit the transaction.
+	 */
+	static void
+	tx_commit() noexcept
+	{
+		auto start = detail::tx_stats_now();
+		pmemobj_tx_commit();
+		detail::tx_stats_commit(start);
+	}
+
+	/**
+	 * End the transaction.
+	 */
+	static void
+	tx_end() noexcept
+	{
+		tx_ended(pmemobj_tx_end());
+	}
+
+	/**
+	 * Drop the snapshot cache and run the callbacks if the outermost
+	 * transaction has ended, with err as its result.
+	 */
+	static void
+	tx_ended(int err) noexcept
+	{
+		detail::snapshot_cache::get().tx_end();
+
+		auto &data = callbacks();
+		if (!data.active || pmemobj_tx_stage() != TX_STAGE_NONE)
+			return;
+
+		detail::tx_stats_end(err);
+
+		auto outcome = err == 0 ? stage_type::oncommit
+					: stage_type::onabort;
+		auto other = err == 0 ? stage_type::onabort
+				      : stage_type::oncommit;
+
+		/* callbacks may start transactions, which reuse data */
+		callback_list run(std::move(
+			data.lists[static_cast<std::size_t>(outcome)]));
+		callback_list fin(std::move(
+			data.lists[static_cast<std::size_t>(
+				stage_type::finally)]));
+		data.lists[static_cast<std::size_t>(other)].clear();
+		data.active = false;
+
+		for (std::size_t i = 0; i < run.size(); ++i)
+			run[i]();
+		for (std::size_t i = 0; i < fin.size(); ++i)
+			fin[i]();
+	}
+
 	/**
 	 * Recursively add locks to the active transaction.
 	 *
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Type numbers of persistent objects.
+ */
+
+#ifndef LIBPMEMOBJ_TYPE_NUM_HPP
+#define LIBPMEMOBJ_TYPE_NUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pmem
+{
+
+namespace detail
+{
+
+constexpr std::uint64_t fnv1a_offset = 14695981039346656037ULL;
+constexpr std::uint64_t fnv1a_prime = 1099511628211ULL;
+
+/*
+ * Add one character to an FNV-1a hash.
+ */
+constexpr std::uint64_t
+fnv1a_step(std::uint64_t h, char c)
+{
+	return (h ^ static_cast<std::uint64_t>(static_cast<unsigned char>(c))) *
+		fnv1a_prime;
+}
+
+/*
+ * FNV-1a hash of n characters. The hash is sequential, but the range is
+ * split in halves, the second one continuing from the hash of the first,
+ * so that the depth of the constexpr recursion grows logarithmically
+ * with the length of the type name.
+ */
+constexpr std::uint64_t
+fnv1a(const char *s, std::size_t n, std::uint64_t h = fnv1a_offset)
+{
+	return n == 0 ? h
+		      : n == 1 ? fnv1a_step(h, s[0])
+			       : fnv1a(s + n / 2, n - n / 2,
+				       fnv1a(s, n / 2, h));
+}
+
+/*
+ * Checks whether the 4-character marker m starts at s[i].
+ */
+constexpr bool
+marker_at(const char *s, const char *m, std::size_t i)
+{
+	return s[i] == m[0] && s[i + 1] == m[1] && s[i + 2] == m[2] &&
+		s[i + 3] == m[3];
+}
+
+constexpr std::size_t find_marker(const char *s, const char *m,
+				  std::size_t first, std::size_t last,
+				  std::size_t npos);
+
+/*
+ * Result of the search in the first half of a range if the marker was
+ * found there, otherwise the result of searching [first, last).
+ */
+constexpr std::size_t
+find_marker_or(std::size_t found, const char *s, const char *m,
+	       std::size_t first, std::size_t last, std::size_t npos)
+{
+	return found != npos ? found : find_marker(s, m, first, last, npos);
+}
+
+/*
+ * Position following the first occurrence of the marker m starting in
+ * [first, last), or npos if there is none. Bisects the range to keep the
+ * recursion depth logarithmic.
+ */
+constexpr std::size_t
+find_marker(const char *s, const char *m, std::size_t first,
+	    std::size_t last, std::size_t npos)
+{
+	return last - first == 1
+		? (marker_at(s, m, first) ? first + 4 : npos)
+		: find_marker_or(find_marker(s, m, first,
+					     first + (last - first) / 2, npos),
+				 s, m, first + (last - first) / 2, last, npos);
+}
+
+/*
+ * Position following the first occurrence of the 4-character marker m
+ * in the first n characters of s, or n if there is none.
+ */
+constexpr std::size_t
+find_after(const char *s, std::size_t n, const char *m)
+{
+	return n < 4 ? n : find_marker(s, m, 0, n - 3, n);
+}
+
+/*
+ * Hash of the characters of s between begin and end.
+ */
+constexpr std::uint64_t
+hash_range(const char *s, std::size_t begin, std::size_t end)
+{
+	return begin < end ? fnv1a(s + begin, end - begin) : fnv1a(s, end);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+
+/*
+ * FNV-1a hash of the name of T, taken from the signature of this
+ * function: "... type_name_hash() [with T = name]" (GCC) or
+ * "... type_name_hash() [T = name]" (clang).
+ */
+template <typename T>
+constexpr unsigned long long
+type_name_hash()
+{
+	return hash_range(__PRETTY_FUNCTION__,
+			  find_after(__PRETTY_FUNCTION__,
+				     sizeof(__PRETTY_FUNCTION__) - 1, "T = "),
+			  sizeof(__PRETTY_FUNCTION__) - 2);
+}
+
+#elif defined(_MSC_VER)
+
+/*
+ * FNV-1a hash of the name of T, taken from the signature of this
+ * function: "... type_name_hash<name>(void)". MSVC spells class types
+ * as "struct name" or "class name", so the hashes differ from the ones
+ * of GCC and clang.
+ */
+template <typename T>
+constexpr unsigned long long
+type_name_hash()
+{
+	return hash_range(__FUNCSIG__,
+			  find_after(__FUNCSIG__, sizeof(__FUNCSIG__) - 1,
+				     "ash<"),
+			  sizeof(__FUNCSIG__) - 8);
+}
+
+#else
+#error "type_name_hash is not supported by this compiler"
+#endif
+
+} /* namespace detail */
+
+namespace obj
+{
+
+/**
+ * Type number under which the objects of type T are allocated.
+ *
+ * The type number is stored with every object allocated by
+ * make_persistent, make_persistent_atomic and pmem::obj::allocator, and
+ * can be used to find the objects of a type, e.g. with
+ * pmemobj_first/pmemobj_next and pmemobj_type_num.
+ *
+ * By default it is the 64-bit FNV-1a hash of the fully qualified name of
+ * T, computed at compile time. It is stable across builds and program
+ * versions, as long as the type is not renamed or moved to another
+ * namespace. GCC and clang agree on it for types spelled the same way by
+ * both, which does not include some types of the standard library;
+ * MSVC spells the type names differently.
+ *
+ * The trait can be specialized to give a type a number which is
+ * independent of its name, for example to rename it or to share pools
+ * between compilers:
+ *
+ * @code
+ * namespace pmem { namespace obj {
+ * template <>
+ * struct type_num_traits<my_type> {
+ *	static constexpr uint64_t value = 42;
+ * };
+ * } }
+ * @endcode
+ *
+ * The specialization has to be visible before the first allocation of
+ * the type.
+ */
+template <typename T>
+struct type_num_traits {
+	/** The type number of T. */
+	static constexpr std::uint64_t value = detail::type_name_hash<T>();
+};
+
+template <typename T>
+constexpr std::uint64_t type_num_traits<T>::value;
+
+} /* namespace obj */
+
+} /* namespace pmem */
+
+#endif /* LIBPMEMOBJ_TYPE_NUM_HPP */
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * action_batch.cpp -- action_batch tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/action_batch.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <stdexcept>
+
+#define LAYOUT "action_batch"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+struct node {
+	node(int value, nvobj::persistent_ptr<node> next)
+	    : value(value), next(next)
+	{
+	}
+
+	nvobj::p<int> value;
+	nvobj::persistent_ptr<node> next;
+};
+
+struct failing {
+	failing()
+	{
+		throw std::runtime_error("failing");
+	}
+};
+
+struct root {
+	nvobj::persistent_ptr<node> head;
+	nvobj::p<int> count;
+	nvobj::p<char> tag;
+};
+
+namespace
+{
+
+/*
+ * count_nodes -- (internal) count the nodes in the pool
+ */
+int
+count_nodes(nvobj::pool<struct root> &pop)
+{
+	int n = 0;
+	for (PMEMoid oid = pmemobj_first(pop.get_handle()); !OID_IS_NULL(oid);
+	     oid = pmemobj_next(oid)) {
+		if (pmemobj_type_num(oid) == pmem::detail::type_num<node>())
+			++n;
+	}
+
+	return n;
+}
+
+/*
+ * push -- (internal) prepend a node to the list in the batch
+ */
+void
+push(pmemobj_exp::action_batch &batch, nvobj::persistent_ptr<root> r,
+     nvobj::persistent_ptr<node> head, int value, int count)
+{
+	auto n = batch.reserve<node>(value, head);
+	batch.set_value(r->head, n);
+	batch.set_value(r->count, count);
+}
+
+/*
+ * test_publish -- (internal) reservations and writes are applied together
+ */
+void
+test_publish(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	{
+		pmemobj_exp::action_batch batch(pop);
+		UT_ASSERT(batch.empty());
+
+		push(batch, r, r->head, 1, 1);
+		UT_ASSERTeq(batch.size(), 4);
+		UT_ASSERT(r->head == nullptr);
+		UT_ASSERTeq(r->count, 0);
+		UT_ASSERTeq(count_nodes(pop), 0);
+
+		batch.publish();
+		UT_ASSERT(batch.empty());
+	}
+
+	UT_ASSERTeq(r->count, 1);
+	UT_ASSERT(r->head != nullptr);
+	UT_ASSERTeq(r->head->value, 1);
+	UT_ASSERT(r->head->next == nullptr);
+	UT_ASSERTeq(count_nodes(pop), 1);
+
+	/* a batch can be reused and combine many objects */
+	pmemobj_exp::action_batch batch(pop);
+	auto head = r->head;
+	for (int i = 2; i <= 5; ++i) {
+		head = batch.reserve<node>(i, head);
+		head->value = head->value * 10;
+	}
+	batch.set_value(r->head, head);
+	batch.set_value(r->count, 5);
+	batch.set_value(r->tag, 'x');
+	batch.publish();
+
+	UT_ASSERTeq(r->count, 5);
+	UT_ASSERTeq(r->tag, 'x');
+	int expected = 50;
+	for (auto n = r->head; n != nullptr; n = n->next) {
+		UT_ASSERTeq(n->value, expected);
+		expected = expected == 20 ? 1 : expected - 10;
+	}
+	UT_ASSERTeq(count_nodes(pop), 5);
+}
+
+/*
+ * test_cancel -- (internal) unpublished batches leave the pool unchanged
+ */
+void
+test_cancel(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	auto head = r->head;
+
+	{
+		pmemobj_exp::action_batch batch(pop);
+		push(batch, r, head, 6, 6);
+		batch.cancel();
+		UT_ASSERT(batch.empty());
+		batch.publish();
+	}
+
+	{
+		pmemobj_exp::action_batch batch(pop);
+		push(batch, r, head, 7, 6);
+	}
+
+	{
+		pmemobj_exp::action_batch batch(pop);
+		push(batch, r, head, 8, 6);
+		try {
+			batch.reserve<failing>();
+			UT_ASSERT(0);
+		} catch (std::runtime_error &) {
+		}
+		UT_ASSERTeq(batch.size(), 4);
+	}
+
+	UT_ASSERT(r->head == head);
+	UT_ASSERTeq(r->count, 5);
+	UT_ASSERTeq(count_nodes(pop), 5);
+
+	int x = 0;
+	nvobj::p<int> &volatile_field = reinterpret_cast<nvobj::p<int> &>(x);
+	try {
+		pmemobj_exp::action_batch batch(pop);
+		batch.set_value(volatile_field, 1);
+		UT_ASSERT(0);
+	} catch (pmem::pool_error &) {
+	}
+}
+
+/*
+ * test_in_tx -- (internal) a batch published in a transaction is rolled
+ * back with it
+ */
+void
+test_in_tx(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	auto head = r->head;
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			pmemobj_exp::action_batch batch(pop);
+			push(batch, r, head, 9, 6);
+			batch.publish();
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+
+	UT_ASSERT(r->head == head);
+	UT_ASSERTeq(r->count, 5);
+	UT_ASSERTeq(count_nodes(pop), 5);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		pmemobj_exp::action_batch batch(pop);
+		push(batch, r, head, 9, 6);
+		batch.publish();
+	});
+
+	UT_ASSERTeq(r->head->value, 9);
+	UT_ASSERTeq(r->count, 6);
+	UT_ASSERTeq(count_nodes(pop), 6);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_publish(pop);
+	test_cancel(pop);
+	test_in_tx(pop);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	UT_ASSERTeq(pop.get_root()->count, 6);
+	UT_ASSERTeq(count_nodes(pop), 6);
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * alloc_class.cpp -- allocation class tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/alloc_class.hpp>
+#include <libpmemobj++/allocator.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/make_persistent_atomic.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <new>
+
+#define LAYOUT "alloc_class"
+
+namespace nvobj = pmem::obj;
+
+struct node {
+	node(int v) : value(v)
+	{
+	}
+
+	nvobj::p<int> value;
+	nvobj::p<char> payload[68];
+};
+
+namespace pmem
+{
+namespace obj
+{
+template <>
+struct alloc_class_traits<node> {
+	static constexpr unsigned id = 200;
+};
+}
+}
+
+struct root {
+	nvobj::persistent_ptr<node> n;
+};
+
+namespace
+{
+
+/*
+ * test_unregistered -- (internal) allocations from a class which is not
+ * registered fail
+ */
+void
+test_unregistered(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			r->n = nvobj::make_persistent<node>(1);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::transaction_alloc_error &) {
+	}
+
+	UT_ASSERT(r->n == nullptr);
+
+	nvobj::persistent_ptr<node> n;
+	try {
+		nvobj::make_persistent_atomic<node>(pop, n, 1);
+		UT_ASSERT(0);
+	} catch (std::bad_alloc &) {
+	}
+}
+
+/*
+ * test_registered -- (internal) every single object allocation path uses
+ * the registered class
+ */
+void
+test_registered(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	pop.register_alloc_class<node>();
+
+	try {
+		pop.register_alloc_class<node>();
+		UT_ASSERT(0);
+	} catch (pmem::pool_error &) {
+	}
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->n = nvobj::make_persistent<node>(1);
+	});
+	UT_ASSERTeq(r->n->value, 1);
+	UT_ASSERTeq(pmemobj_type_num(r->n.raw()),
+		    pmem::detail::type_num<node>());
+
+	nvobj::persistent_ptr<node> n;
+	nvobj::make_persistent_atomic<node>(pop, n, 2);
+	UT_ASSERTeq(n->value, 2);
+	nvobj::delete_persistent_atomic<node>(n);
+
+	nvobj::allocator<node> alloc;
+	nvobj::transaction::exec_tx(pop, [&] {
+		auto one = alloc.allocate(1);
+		auto many = alloc.allocate(10);
+		UT_ASSERT(one != nullptr);
+		UT_ASSERT(many != nullptr);
+		alloc.deallocate(one);
+		alloc.deallocate(many);
+
+		nvobj::delete_persistent<node>(r->n);
+		r->n = nullptr;
+	});
+}
+
+/*
+ * test_new_class -- (internal) classes registered without an id get one
+ */
+void
+test_new_class(nvobj::pool<struct root> &pop)
+{
+	unsigned id = pop.register_alloc_class(128, 512);
+	UT_ASSERTne(id, 0);
+	UT_ASSERTne(id, nvobj::alloc_class_traits<node>::id);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		PMEMoid oid = pmemobj_tx_xalloc(100, 0, POBJ_CLASS_ID(id));
+		UT_ASSERT(!OID_IS_NULL(oid));
+		pmemobj_tx_free(oid);
+	});
+
+	try {
+		pop.register_alloc_class(0, 512);
+		UT_ASSERT(0);
+	} catch (pmem::pool_error &) {
+	}
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_unregistered(pop);
+	test_registered(pop);
+	test_new_class(pop);
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/append_log.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LAYOUT "append_log"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+using log_type = pmemobj_exp::append_log;
+
+struct root {
+	nvobj::persistent_ptr<log_type> log;
+};
+
+namespace
+{
+
+const size_t extent_size = 256;
+
+/*
+ * make_record -- (internal) create a record of the given size, whose
+ * contents depend on its number
+ */
+std::string
+make_record(size_t n, size_t size)
+{
+	std::string r;
+	for (size_t i = 0; i < size; ++i)
+		r += static_cast<char>('a' + (n + i) % 26);
+
+	return r;
+}
+
+/*
+ * check_records -- (internal) compare the log with expected records
+ */
+void
+check_records(const log_type &log, const std::vector<std::string> &ref)
+{
+	auto it = log.begin();
+	for (auto &r : ref) {
+		UT_ASSERT(it != log.end());
+		UT_ASSERTeq((*it).size, r.size());
+		UT_ASSERT(std::string((*it).data, (*it).size) == r);
+		++it;
+	}
+	UT_ASSERT(it == log.end());
+}
+
+/*
+ * append_test -- (internal) append single records and batches, some of
+ * them larger than an extent
+ */
+void
+append_test(nvobj::pool<struct root> &pop, std::vector<std::string> &ref)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->log = nvobj::make_persistent<log_type>(extent_size);
+	});
+
+	log_type &log = *r->log;
+	UT_ASSERT(log.empty());
+	UT_ASSERT(log.begin() == log.end());
+
+	for (size_t i = 0; i < 100; ++i) {
+		ref.push_back(make_record(i, i % 3 == 0 ? i : i % 17));
+		log.append(ref.back().data(), ref.back().size());
+	}
+
+	ref.push_back(make_record(100, extent_size * 3));
+	log.append(ref.back().data(), ref.back().size());
+
+	check_records(log, ref);
+
+	{
+		log_type::batch b(log);
+		for (size_t i = 0; i < 50; ++i) {
+			ref.push_back(make_record(i, i * 5));
+			b.append(ref.back().data(), ref.back().size());
+		}
+
+		check_records(log, std::vector<std::string>(ref.begin(),
+							    ref.end() - 50));
+		b.commit();
+	}
+
+	check_records(log, ref);
+
+	/* a batch which is not committed leaves the log unchanged */
+	uint64_t tail = log.tail();
+	{
+		log_type::batch b(log);
+		for (size_t i = 0; i < 20; ++i)
+			b.append("uncommitted", 11);
+	}
+	UT_ASSERTeq(log.tail(), tail);
+	check_records(log, ref);
+
+	ref.push_back("after");
+	log.append("after", 5);
+	check_records(log, ref);
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] { log.append("x", 1); });
+		UT_ASSERT(0);
+	} catch (pmem::transaction_scope_error &) {
+	}
+
+	check_records(log, ref);
+}
+
+/*
+ * concurrent_test -- (internal) read the log while a thread appends
+ */
+void
+concurrent_test(log_type &log, std::vector<std::string> &ref)
+{
+	const size_t num_records = 500;
+	size_t base = ref.size();
+
+	for (size_t i = 0; i < num_records; ++i)
+		ref.push_back(make_record(base + i, i % 40));
+
+	std::thread writer([&] {
+		for (size_t i = 0; i < num_records; ++i)
+			log.append(ref[base + i].data(), ref[base + i].size());
+	});
+
+	size_t seen = 0;
+	while (seen < ref.size()) {
+		size_t n = 0;
+		for (auto it = log.begin(); it != log.end(); ++it, ++n) {
+			UT_ASSERT(n < ref.size());
+			UT_ASSERT(std::string((*it).data, (*it).size) ==
+				  ref[n]);
+		}
+
+		UT_ASSERT(n >= seen);
+		seen = n;
+	}
+
+	writer.join();
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	std::vector<std::string> ref;
+
+	append_test(pop, ref);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	auto r = pop.get_root();
+
+	check_records(*r->log, ref);
+	concurrent_test(*r->log, ref);
+	check_records(*r->log, ref);
+
+	r->log->clear();
+	UT_ASSERT(r->log->empty());
+	UT_ASSERT(r->log->begin() == r->log->end());
+
+	r->log->append("new", 3);
+	check_records(*r->log, {"new"});
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<log_type>(r->log);
+		r->log = nullptr;
+	});
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * arena.cpp -- arena and allocation flag tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/allocation_flag.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/make_persistent_atomic.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <new>
+#include <thread>
+#include <vector>
+
+#define LAYOUT "arena"
+
+namespace nvobj = pmem::obj;
+
+const int num_threads = 4;
+const int ops_per_thread = 50;
+
+struct foo {
+	foo(int a, int b) : a(a), b(b)
+	{
+	}
+
+	nvobj::p<int> a;
+	nvobj::p<int> b;
+};
+
+struct root {
+	nvobj::persistent_ptr<foo> objs[num_threads][ops_per_thread];
+};
+
+namespace
+{
+
+/*
+ * test_flags -- (internal) allocation flags are passed to libpmemobj
+ */
+void
+test_flags(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->objs[0][0] = nvobj::make_persistent<foo>(
+			nvobj::allocation_flag::none(), 1, 2);
+	});
+	UT_ASSERTeq(r->objs[0][0]->a, 1);
+	UT_ASSERTeq(r->objs[0][0]->b, 2);
+
+	/* no class is registered under this id */
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			r->objs[0][1] = nvobj::make_persistent<foo>(
+				nvobj::allocation_flag::class_id(250), 1, 2);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::transaction_alloc_error &) {
+	}
+
+	nvobj::persistent_ptr<foo> ptr;
+	try {
+		nvobj::make_persistent_atomic<foo>(
+			pop, ptr, nvobj::allocation_flag::class_id(250), 1, 2);
+		UT_ASSERT(0);
+	} catch (std::bad_alloc &) {
+	}
+
+	nvobj::make_persistent_atomic<foo>(
+		pop, ptr, nvobj::allocation_flag::none(), 3, 4);
+	UT_ASSERTeq(ptr->a, 3);
+	nvobj::delete_persistent_atomic<foo>(ptr);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<foo>(r->objs[0][0]);
+		r->objs[0][0] = nullptr;
+	});
+}
+
+#ifdef POBJ_ARENA_ID
+/*
+ * test_arenas -- (internal) threads bound to their own arenas allocate
+ * concurrently
+ */
+void
+test_arenas(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	unsigned count = pop.arena_count();
+	UT_ASSERT(count >= 1);
+
+	unsigned arenas[num_threads];
+	for (int t = 0; t < num_threads; ++t)
+		arenas[t] = pop.create_arena();
+	UT_ASSERTeq(pop.arena_count(), count + num_threads);
+
+	try {
+		pop.set_thread_arena(count + num_threads + 1);
+		UT_ASSERT(0);
+	} catch (pmem::pool_error &) {
+	}
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t) {
+		threads.emplace_back([&, t] {
+			pop.set_thread_arena(arenas[t]);
+			UT_ASSERTeq(pop.thread_arena(), arenas[t]);
+
+			for (int i = 0; i < ops_per_thread; ++i)
+				nvobj::transaction::exec_tx(pop, [&] {
+					r->objs[t][i] =
+						nvobj::make_persistent<foo>(t,
+									    i);
+				});
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	auto flag = nvobj::allocation_flag::arena_id(arenas[0]) |
+		nvobj::allocation_flag::none();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int t = 0; t < num_threads; ++t) {
+			for (int i = 0; i < ops_per_thread; ++i) {
+				UT_ASSERTeq(r->objs[t][i]->a, t);
+				UT_ASSERTeq(r->objs[t][i]->b, i);
+				nvobj::delete_persistent<foo>(r->objs[t][i]);
+				r->objs[t][i] =
+					nvobj::make_persistent<foo>(flag, i, t);
+			}
+		}
+	});
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int t = 0; t < num_threads; ++t) {
+			for (int i = 0; i < ops_per_thread; ++i) {
+				nvobj::delete_persistent<foo>(r->objs[t][i]);
+				r->objs[t][i] = nullptr;
+			}
+		}
+	});
+}
+#endif
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_flags(pop);
+#ifdef POBJ_ARENA_ID
+	test_arenas(pop);
+#endif
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/art_map.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#define LAYOUT "art_map"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+using map_type = pmemobj_exp::art_map<int>;
+
+struct root {
+	nvobj::persistent_ptr<map_type> map;
+};
+
+namespace
+{
+
+/*
+ * check_equal -- (internal) compare the map with a reference std::map
+ */
+void
+check_equal(const map_type &map, const std::map<std::string, int> &ref)
+{
+	UT_ASSERTeq(map.size(), ref.size());
+
+	auto it = ref.begin();
+	map.for_each([&](const char *key, size_t len, const int &value) {
+		UT_ASSERT(it != ref.end());
+		UT_ASSERT(std::string(key, len) == it->first);
+		UT_ASSERTeq(value, it->second);
+		++it;
+	});
+	UT_ASSERT(it == ref.end());
+
+	for (auto &e : ref) {
+		const int *value = map.find(e.first);
+		UT_ASSERT(value != nullptr);
+		UT_ASSERTeq(*value, e.second);
+	}
+}
+
+/*
+ * make_keys -- (internal) generate keys sharing long prefixes, keys which
+ * are prefixes of other keys and keys with all byte values
+ */
+std::vector<std::string>
+make_keys()
+{
+	std::vector<std::string> keys;
+
+	for (int i = 0; i < 300; ++i) {
+		std::string k = "https://example.com/path/to/resource/";
+		k += std::to_string(i);
+		keys.push_back(k);
+		keys.push_back(k + "/index.html");
+	}
+
+	keys.push_back("https://example.com/");
+	keys.push_back("https://example.com/path");
+	keys.push_back("");
+
+	for (int b = 0; b < 256; ++b) {
+		keys.push_back(std::string(1, static_cast<char>(b)));
+		keys.push_back(std::string("k") + static_cast<char>(b) + "v");
+	}
+
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> len(1, 40);
+	std::uniform_int_distribution<int> ch('a', 'd');
+	for (int i = 0; i < 1000; ++i) {
+		std::string k;
+		int l = len(gen);
+		for (int j = 0; j < l; ++j)
+			k += static_cast<char>(ch(gen));
+		keys.push_back(k);
+	}
+
+	std::shuffle(keys.begin(), keys.end(), gen);
+
+	return keys;
+}
+
+/*
+ * modify_test -- (internal) insert and erase keys in random order
+ */
+void
+modify_test(nvobj::pool<struct root> &pop, std::map<std::string, int> &ref)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(
+		pop, [&] { r->map = nvobj::make_persistent<map_type>(); });
+
+	map_type &map = *r->map;
+	UT_ASSERT(map.empty());
+	UT_ASSERT(map.find("a") == nullptr);
+	UT_ASSERTeq(map.erase("a"), 0);
+
+	std::vector<std::string> keys = make_keys();
+
+	int v = 0;
+	for (auto &k : keys) {
+		bool inserted = map.insert(k, v);
+		UT_ASSERTeq(inserted, ref.count(k) == 0);
+		if (inserted)
+			ref[k] = v;
+		v++;
+	}
+
+	check_equal(map, ref);
+
+	UT_ASSERT(!map.insert(keys[0], -1));
+	UT_ASSERT(!map.insert_or_assign(keys[1], -1));
+	ref[keys[1]] = -1;
+	UT_ASSERT(map.insert_or_assign("not/there", 5));
+	ref["not/there"] = 5;
+
+	check_equal(map, ref);
+
+	UT_ASSERTeq(map.count("https://example.com/path/to"), 0);
+	UT_ASSERTeq(map.count("https://example.com/path/to/resource/1x"), 0);
+	UT_ASSERTeq(map.count("https://example.com/path/"), 0);
+
+	/* erase most of the keys, which shrinks and collapses nodes */
+	std::mt19937 gen(2);
+	std::shuffle(keys.begin(), keys.end(), gen);
+
+	for (size_t i = 0; i < keys.size() * 9 / 10; ++i) {
+		UT_ASSERTeq(map.erase(keys[i]), ref.erase(keys[i]));
+		UT_ASSERTeq(map.erase(keys[i]), 0);
+	}
+
+	check_equal(map, ref);
+
+	for (size_t i = 0; i < keys.size() / 2; ++i) {
+		map.insert_or_assign(keys[i], static_cast<int>(i));
+		ref[keys[i]] = static_cast<int>(i);
+	}
+
+	check_equal(map, ref);
+}
+
+/*
+ * tx_test -- (internal) test that aborted modifications are rolled back
+ */
+void
+tx_test(nvobj::pool<struct root> &pop, map_type &map,
+	const std::map<std::string, int> &ref)
+{
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			for (auto &e : ref)
+				map.erase(e.first);
+			map.insert("new key", 1);
+			UT_ASSERTeq(map.size(), 1);
+
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+
+	check_equal(map, ref);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL * 4, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	std::map<std::string, int> ref;
+
+	modify_test(pop, ref);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	auto r = pop.get_root();
+
+	check_equal(*r->map, ref);
+	tx_test(pop, *r->map, ref);
+
+	r->map->clear();
+	UT_ASSERT(r->map->empty());
+	UT_ASSERT(r->map->insert("x", 1));
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<map_type>(r->map);
+		r->map = nullptr;
+	});
+
+	pop.close();
+
+	return 0;
+}
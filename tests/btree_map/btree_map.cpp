@@ -0,0 +1,247 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/btree_map.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+#define LAYOUT "btree_map"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+using map_type = pmemobj_exp::btree_map<int, int>;
+
+struct root {
+	nvobj::persistent_ptr<map_type::storage_type> storage;
+};
+
+namespace
+{
+
+const int num_keys = 5000;
+
+/*
+ * check_equal -- (internal) compare the map with a reference std::map
+ */
+void
+check_equal(const map_type &map, const std::map<int, int> &ref)
+{
+	UT_ASSERTeq(map.size(), ref.size());
+
+	auto it = map.begin();
+	for (auto &e : ref) {
+		UT_ASSERT(it != map.end());
+		UT_ASSERTeq(it->first, e.first);
+		UT_ASSERTeq(it->second, e.second);
+		++it;
+	}
+	UT_ASSERT(it == map.end());
+}
+
+/*
+ * modify_test -- (internal) insert and erase keys in random order
+ */
+void
+modify_test(nvobj::pool<struct root> &pop, std::map<int, int> &ref)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->storage = nvobj::make_persistent<map_type::storage_type>();
+	});
+
+	map_type map(r->storage);
+	UT_ASSERT(map.empty());
+	UT_ASSERT(map.begin() == map.end());
+
+	std::vector<int> keys;
+	for (int i = 0; i < num_keys; ++i)
+		keys.push_back(i * 2);
+
+	std::mt19937 gen(1);
+	std::shuffle(keys.begin(), keys.end(), gen);
+
+	for (int k : keys) {
+		UT_ASSERT(map.insert(k, k + 1));
+		ref[k] = k + 1;
+	}
+
+	UT_ASSERT(!map.insert(keys[0], 0));
+	UT_ASSERT(!map.insert_or_assign(keys[1], 7));
+	ref[keys[1]] = 7;
+
+	check_equal(map, ref);
+
+	std::shuffle(keys.begin(), keys.end(), gen);
+
+	/* erase most of the keys, which frees most of the leaves */
+	for (size_t i = 0; i < keys.size() * 9 / 10; ++i) {
+		UT_ASSERTeq(map.erase(keys[i]), 1);
+		UT_ASSERTeq(map.erase(keys[i]), 0);
+		ref.erase(keys[i]);
+	}
+
+	check_equal(map, ref);
+
+	for (int i = 0; i < num_keys / 2; ++i) {
+		map.insert(i * 4 + 1, i);
+		ref[i * 4 + 1] = i;
+	}
+
+	check_equal(map, ref);
+}
+
+/*
+ * lookup_test -- (internal) test point lookups and bounds
+ */
+void
+lookup_test(const map_type &map, const std::map<int, int> &ref)
+{
+	for (int k = -1; k < num_keys * 2 + 1; ++k) {
+		auto it = map.find(k);
+		auto ref_it = ref.find(k);
+
+		if (ref_it == ref.end()) {
+			UT_ASSERT(it == map.end());
+			UT_ASSERTeq(map.count(k), 0);
+		} else {
+			UT_ASSERT(it != map.end());
+			UT_ASSERTeq(it->second, ref_it->second);
+			UT_ASSERTeq(map.count(k), 1);
+		}
+
+		auto lb = map.lower_bound(k);
+		auto ref_lb = ref.lower_bound(k);
+		if (ref_lb == ref.end())
+			UT_ASSERT(lb == map.end());
+		else
+			UT_ASSERTeq(lb->first, ref_lb->first);
+
+		auto ub = map.upper_bound(k);
+		auto ref_ub = ref.upper_bound(k);
+		if (ref_ub == ref.end())
+			UT_ASSERT(ub == map.end());
+		else
+			UT_ASSERTeq(ub->first, ref_ub->first);
+	}
+
+	/* range scan */
+	int sum = 0, ref_sum = 0;
+	for (auto it = map.lower_bound(100); it != map.lower_bound(3000); ++it)
+		sum += it->second;
+	for (auto it = ref.lower_bound(100); it != ref.lower_bound(3000); ++it)
+		ref_sum += it->second;
+	UT_ASSERTeq(sum, ref_sum);
+}
+
+/*
+ * tx_test -- (internal) test that modifications are refused within
+ * a transaction
+ */
+void
+tx_test(nvobj::pool<struct root> &pop, map_type &map)
+{
+	auto size = map.size();
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] { map.insert(-5, 0); });
+		UT_ASSERT(0);
+	} catch (pmem::transaction_scope_error &) {
+	}
+
+	UT_ASSERTeq(map.size(), size);
+	UT_ASSERTeq(map.count(-5), 0);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	std::map<int, int> ref;
+
+	modify_test(pop, ref);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	auto r = pop.get_root();
+
+	{
+		/* inner nodes are rebuilt from the leaves */
+		map_type map(r->storage);
+
+		check_equal(map, ref);
+		lookup_test(map, ref);
+		tx_test(pop, map);
+
+		map.clear();
+		UT_ASSERT(map.empty());
+		UT_ASSERT(map.insert(1, 1));
+		UT_ASSERTeq(map.count(1), 1);
+	}
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<map_type::storage_type>(r->storage);
+		r->storage = nullptr;
+	});
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/concurrent_hash_map.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <thread>
+#include <vector>
+
+#define LAYOUT "concurrent_hash_map"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+using map_type = pmemobj_exp::concurrent_hash_map<int, int>;
+
+struct root {
+	nvobj::persistent_ptr<map_type> map;
+};
+
+namespace
+{
+
+const int num_threads = 8;
+const int num_ops = 2000;
+
+/*
+ * parallel_exec -- (internal) run f(thread_id) in num_threads threads
+ */
+template <typename F>
+void
+parallel_exec(F f)
+{
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < num_threads; ++i)
+		threads.emplace_back(f, i);
+
+	for (auto &t : threads)
+		t.join();
+}
+
+/*
+ * check_contents -- (internal) check that all keys inserted by
+ * insert_test are present with values updated by update_test
+ */
+void
+check_contents(map_type &map, int increment)
+{
+	UT_ASSERTeq(map.size(), num_threads * num_ops);
+
+	for (int i = 0; i < num_threads * num_ops; ++i) {
+		int value;
+		UT_ASSERT(map.find(i, value));
+		UT_ASSERTeq(value, i + increment);
+	}
+}
+
+/*
+ * insert_test -- (internal) concurrently insert, look up and update
+ * disjoint sets of keys, growing the map through several rehashes
+ */
+void
+insert_test(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(
+		pop, [&] { r->map = nvobj::make_persistent<map_type>(); });
+
+	map_type &map = *r->map;
+	auto initial_buckets = map.bucket_count();
+
+	parallel_exec([&](int id) {
+		for (int i = id * num_ops; i < (id + 1) * num_ops; ++i) {
+			UT_ASSERT(map.insert(i, i));
+			UT_ASSERT(!map.insert(i, 0));
+		}
+
+		for (int i = id * num_ops; i < (id + 1) * num_ops; ++i)
+			UT_ASSERTeq(map.count(i), 1);
+	});
+
+	UT_ASSERT(map.bucket_count() > initial_buckets);
+	check_contents(map, 0);
+
+	parallel_exec([&](int id) {
+		for (int i = id; i < num_threads * num_ops; i += num_threads)
+			UT_ASSERT(map.update(i, [](int &v) { v++; }));
+	});
+
+	check_contents(map, 1);
+}
+
+/*
+ * erase_test -- (internal) concurrently erase and reinsert keys
+ */
+void
+erase_test(nvobj::pool<struct root> &pop)
+{
+	map_type &map = *pop.get_root()->map;
+
+	parallel_exec([&](int id) {
+		for (int i = id * num_ops; i < (id + 1) * num_ops; i += 2) {
+			UT_ASSERT(map.erase(i));
+			UT_ASSERT(!map.erase(i));
+			UT_ASSERTeq(map.count(i), 0);
+		}
+	});
+
+	UT_ASSERTeq(map.size(), num_threads * num_ops / 2);
+
+	parallel_exec([&](int id) {
+		for (int i = id * num_ops; i < (id + 1) * num_ops; i += 2)
+			UT_ASSERT(!map.insert_or_assign(i + 1, i + 2));
+	});
+
+	for (int i = 1; i < num_threads * num_ops; i += 2) {
+		int value;
+		UT_ASSERT(map.find(i, value));
+		UT_ASSERTeq(value, i + 1);
+	}
+}
+
+/*
+ * tx_test -- (internal) test modifications within an outer transaction
+ */
+void
+tx_test(nvobj::pool<struct root> &pop)
+{
+	map_type &map = *pop.get_root()->map;
+	auto size = map.size();
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			UT_ASSERT(map.insert(-1, 1));
+			UT_ASSERT(map.erase(1));
+			UT_ASSERT(map.insert_or_assign(3, 0) == false);
+
+			int value;
+			UT_ASSERT(map.find(-1, value));
+			UT_ASSERTeq(value, 1);
+			UT_ASSERTeq(map.count(1), 0);
+
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+
+	UT_ASSERTeq(map.size(), size);
+	UT_ASSERTeq(map.count(-1), 0);
+	UT_ASSERTeq(map.count(1), 1);
+
+	int value;
+	UT_ASSERT(map.find(3, value));
+	UT_ASSERTeq(value, 4);
+}
+
+/*
+ * reopen_test -- (internal) test that the map and its locks are usable
+ * after the pool is reopened
+ */
+void
+reopen_test(nvobj::pool<struct root> &pop)
+{
+	map_type &map = *pop.get_root()->map;
+
+	parallel_exec([&](int id) {
+		for (int i = id; i < num_threads * num_ops; i += num_threads)
+			map.insert_or_assign(i, i);
+	});
+
+	UT_ASSERTeq(map.size(), num_threads * num_ops);
+
+	map.clear();
+	UT_ASSERT(map.empty());
+	UT_ASSERTeq(map.count(0), 0);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<map_type>(pop.get_root()->map);
+		pop.get_root()->map = nullptr;
+	});
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL * 4, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	insert_test(pop);
+	erase_test(pop);
+	tx_test(pop);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	reopen_test(pop);
+
+	pop.close();
+
+	return 0;
+}
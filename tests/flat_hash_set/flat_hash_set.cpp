@@ -0,0 +1,239 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * flat_hash_set.cpp -- flat_hash_set tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/flat_hash_set.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <set>
+
+#define LAYOUT "flat_hash_set"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+/* puts all keys into a few probe sequences */
+struct bad_hash {
+	size_t
+	operator()(uint64_t k) const
+	{
+		return k % 3;
+	}
+};
+
+using set_type = pmemobj_exp::flat_hash_set<uint64_t>;
+using collision_set_type = pmemobj_exp::flat_hash_set<uint64_t, bad_hash>;
+
+struct root {
+	nvobj::persistent_ptr<set_type> set;
+	nvobj::persistent_ptr<collision_set_type> cset;
+};
+
+namespace
+{
+
+/*
+ * check_set -- (internal) compare the set with a reference set
+ */
+template <typename Set>
+void
+check_set(const Set &set, const std::set<uint64_t> &ref)
+{
+	UT_ASSERTeq(set.size(), ref.size());
+
+	for (auto k : ref) {
+		UT_ASSERTeq(set.count(k), 1);
+		UT_ASSERT(set.find(k) != set.end());
+		UT_ASSERTeq(*set.find(k), k);
+	}
+
+	std::set<uint64_t> keys;
+	for (auto k : set)
+		UT_ASSERT(keys.insert(k).second);
+
+	UT_ASSERT(keys == ref);
+}
+
+/*
+ * insert_erase_test -- (internal) insert keys, growing the set, then
+ * erase some of them and insert again over the deleted slots
+ */
+template <typename Set>
+void
+insert_erase_test(nvobj::pool_base &pop, Set &set, std::set<uint64_t> &ref)
+{
+	UT_ASSERT(set.empty());
+	UT_ASSERTeq(set.capacity(), Set::group_size);
+	UT_ASSERT(set.begin() == set.end());
+
+	for (uint64_t i = 0; i < 1000; ++i) {
+		UT_ASSERT(set.insert(i * 7));
+		ref.insert(i * 7);
+	}
+
+	UT_ASSERT(!set.insert(7));
+	UT_ASSERT(set.capacity() >= 1000);
+	UT_ASSERTeq(set.count(1), 0);
+	UT_ASSERT(set.find(1) == set.end());
+	check_set(set, ref);
+
+	for (uint64_t i = 0; i < 1000; i += 2) {
+		UT_ASSERTeq(set.erase(i * 7), 1);
+		ref.erase(i * 7);
+	}
+
+	UT_ASSERTeq(set.erase(0), 0);
+	check_set(set, ref);
+
+	/* the capacity is stable, as the deleted slots are reused */
+	auto capacity = set.capacity();
+	for (uint64_t r = 0; r < 10; ++r) {
+		for (uint64_t i = 0; i < 400; ++i) {
+			UT_ASSERT(set.insert(100000 + i));
+			ref.insert(100000 + i);
+		}
+		for (uint64_t i = 0; i < 400; ++i) {
+			UT_ASSERTeq(set.erase(100000 + i), 1);
+			ref.erase(100000 + i);
+		}
+	}
+	UT_ASSERTeq(set.capacity(), capacity);
+	check_set(set, ref);
+
+	/* an aborted transaction rolls back inserts, erases and growth */
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			for (uint64_t i = 0; i < 2000; ++i)
+				set.insert(200000 + i);
+			set.erase(7);
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+
+	UT_ASSERTeq(set.capacity(), capacity);
+	check_set(set, ref);
+
+	/* keys inserted over slots erased in the same transaction */
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			for (auto k : ref)
+				set.erase(k);
+			for (uint64_t i = 0; i < ref.size(); ++i)
+				set.insert(300000 + i);
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+
+	UT_ASSERTeq(set.capacity(), capacity);
+	check_set(set, ref);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL * 2, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	auto r = pop.get_root();
+
+	try {
+		r->set = nvobj::make_persistent<set_type>();
+		UT_ASSERT(0);
+	} catch (pmem::transaction_scope_error &) {
+	}
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->set = nvobj::make_persistent<set_type>();
+		r->cset = nvobj::make_persistent<collision_set_type>();
+	});
+
+	std::set<uint64_t> ref, cref;
+	insert_erase_test(pop, *r->set, ref);
+	insert_erase_test(pop, *r->cset, cref);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	r = pop.get_root();
+	check_set(*r->set, ref);
+	check_set(*r->cset, cref);
+
+	r->set->reserve(5000);
+	UT_ASSERT(r->set->capacity() >= 5000);
+	check_set(*r->set, ref);
+
+	r->set->clear();
+	UT_ASSERT(r->set->empty());
+	UT_ASSERT(r->set->begin() == r->set->end());
+	UT_ASSERT(r->set->insert(42));
+	check_set(*r->set, {42});
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<set_type>(r->set);
+		nvobj::delete_persistent<collision_set_type>(r->cset);
+		r->set = nullptr;
+		r->cset = nullptr;
+	});
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * group_commit.cpp -- group_commit tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/group_commit.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define LAYOUT "group_commit"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+const int num_threads = 8;
+const int ops_per_thread = 500;
+
+struct root {
+	nvobj::p<int> counters[num_threads];
+	nvobj::p<int> total;
+	nvobj::p<int> failed;
+};
+
+namespace
+{
+
+/*
+ * test_futures -- (internal) transactions of many threads are all
+ * committed, each thread waiting for its own futures
+ */
+void
+test_futures(nvobj::pool<struct root> &pop, pmemobj_exp::group_commit &gc)
+{
+	auto r = pop.get_root();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t) {
+		threads.emplace_back([&, t] {
+			std::vector<std::future<void>> futures;
+			for (int i = 0; i < ops_per_thread; ++i)
+				futures.push_back(gc.submit([&, t] {
+					r->counters[t] = r->counters[t] + 1;
+					r->total = r->total + 1;
+				}));
+
+			for (auto &f : futures)
+				f.get();
+
+			UT_ASSERTeq(r->counters[t], ops_per_thread);
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	UT_ASSERTeq(r->total, num_threads * ops_per_thread);
+}
+
+/*
+ * test_failure -- (internal) a failing transaction is reported to its
+ * submitter only and leaves no changes
+ */
+void
+test_failure(nvobj::pool<struct root> &pop, pmemobj_exp::group_commit &gc)
+{
+	auto r = pop.get_root();
+	int total = r->total;
+
+	std::vector<std::future<void>> futures;
+	for (int i = 0; i < 100; ++i) {
+		if (i % 10 == 5) {
+			futures.push_back(gc.submit([&] {
+				r->failed = r->failed + 1;
+				throw std::runtime_error("failed");
+			}));
+		} else {
+			futures.push_back(
+				gc.submit([&] { r->total = r->total + 1; }));
+		}
+	}
+
+	for (int i = 0; i < 100; ++i) {
+		try {
+			futures[static_cast<size_t>(i)].get();
+			UT_ASSERT(i % 10 != 5);
+		} catch (std::runtime_error &) {
+			UT_ASSERT(i % 10 == 5);
+		}
+	}
+
+	UT_ASSERTeq(r->total, total + 90);
+	UT_ASSERTeq(r->failed, 0);
+
+	try {
+		gc.submit([&] { nvobj::transaction::abort(EINVAL); }).get();
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+}
+
+/*
+ * test_callbacks -- (internal) callbacks are called for every transaction
+ */
+void
+test_callbacks(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	int total = r->total;
+
+	std::atomic<int> committed(0), aborted(0);
+	{
+		pmemobj_exp::group_commit gc(pop, 4);
+		for (int i = 0; i < 50; ++i)
+			gc.submit(
+				[&, i] {
+					if (i == 7)
+						throw std::runtime_error("7");
+					r->total = r->total + 1;
+				},
+				[&](std::exception_ptr err) {
+					if (err)
+						++aborted;
+					else
+						++committed;
+				});
+	}
+
+	UT_ASSERTeq(committed.load(), 49);
+	UT_ASSERTeq(aborted.load(), 1);
+	UT_ASSERTeq(r->total, total + 49);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	{
+		pmemobj_exp::group_commit gc(pop);
+		test_futures(pop, gc);
+		test_failure(pop, gc);
+	}
+
+	test_callbacks(pop);
+
+	pop.close();
+
+	return 0;
+}
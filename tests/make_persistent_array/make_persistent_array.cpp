@@ -166,6 +166,87 @@ test_make_N_d(nvobj::pool_base &pop)
 	}
 }
 
+struct trivial {
+	nvobj::p<int> a;
+	nvobj::p<char> b[3];
+};
+
+/*
+ * test_trivial -- (internal) test arrays of trivially default
+ * constructible objects and allocation flags
+ */
+void
+test_trivial(nvobj::pool_base &pop)
+{
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			/* value initialized, as before */
+			auto pint = nvobj::make_persistent<int[]>(1000);
+			for (int i = 0; i < 1000; ++i)
+				UT_ASSERTeq(pint[i], 0);
+			nvobj::delete_persistent<int[]>(pint, 1000);
+
+			auto ptriv = nvobj::make_persistent<trivial[][2]>(5);
+			for (int i = 0; i < 5; ++i)
+				for (int j = 0; j < 2; j++)
+					UT_ASSERTeq(ptriv[i][j].a, 0);
+			nvobj::delete_persistent<trivial[][2]>(ptriv, 5);
+
+			auto pN = nvobj::make_persistent<nvobj::p<int>[10]>();
+			for (int i = 0; i < 10; ++i)
+				UT_ASSERTeq(pN[i], 0);
+			nvobj::delete_persistent<nvobj::p<int>[10]>(pN);
+
+			auto pzero = nvobj::make_persistent<char[]>(
+				1 << 16,
+				nvobj::allocation_flag::zero() |
+					nvobj::allocation_flag::no_flush());
+			for (int i = 0; i < 1 << 16; ++i)
+				UT_ASSERTeq(pzero[i], 0);
+			nvobj::delete_persistent<char[]>(pzero, 1 << 16);
+
+			/* other flags do not change the initialization */
+			auto pnone = nvobj::make_persistent<int[]>(
+				1000, nvobj::allocation_flag::none());
+			for (int i = 0; i < 1000; ++i)
+				UT_ASSERTeq(pnone[i], 0);
+			nvobj::delete_persistent<int[]>(pnone, 1000);
+
+			auto pnoneN = nvobj::make_persistent<trivial[4]>(
+				nvobj::allocation_flag::class_id(0));
+			for (int i = 0; i < 4; ++i)
+				UT_ASSERTeq(pnoneN[i].a, 0);
+			nvobj::delete_persistent<trivial[4]>(pnoneN);
+
+			/* uninitialized, only has to be writable */
+			auto praw = nvobj::make_persistent<char[]>(
+				1 << 16, nvobj::allocation_flag::no_zero());
+			for (int i = 0; i < 1 << 16; ++i)
+				praw[i] = static_cast<char>(i);
+			nvobj::delete_persistent<char[]>(praw, 1 << 16);
+
+			auto prawN = nvobj::make_persistent<trivial[4]>(
+				nvobj::allocation_flag::no_zero());
+			nvobj::delete_persistent<trivial[4]>(prawN);
+
+			/* other types are constructed whatever the flags */
+			auto pfoo = nvobj::make_persistent<foo[]>(
+				5, nvobj::allocation_flag::no_zero());
+			for (int i = 0; i < 5; ++i)
+				pfoo[i].check_foo();
+			nvobj::delete_persistent<foo[]>(pfoo, 5);
+
+			auto pfooN = nvobj::make_persistent<foo[5]>(
+				nvobj::allocation_flag::zero());
+			for (int i = 0; i < 5; ++i)
+				pfooN[i].check_foo();
+			nvobj::delete_persistent<foo[5]>(pfooN);
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+}
+
 /*
  * test_abort_revert -- (internal) test destruction behavior and revert
  */
@@ -238,6 +319,7 @@ main(int argc, char *argv[])
 
 	test_make_one_d(pop);
 	test_make_N_d(pop);
+	test_trivial(pop);
 	test_abort_revert(pop);
 
 	pop.close();
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/mpmc_queue.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define LAYOUT "mpmc_queue"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+using queue_type = pmemobj_exp::mpmc_queue<uint64_t, 64>;
+
+struct root {
+	nvobj::persistent_ptr<queue_type> queue;
+};
+
+namespace
+{
+
+const int num_threads = 4;
+const uint64_t num_ops = 10000;
+
+/*
+ * single_thread_test -- (internal) test FIFO order and bounds
+ */
+void
+single_thread_test(queue_type &queue)
+{
+	uint64_t value;
+
+	UT_ASSERT(queue.empty());
+	UT_ASSERT(!queue.try_pop(value));
+
+	for (uint64_t i = 0; i < queue.capacity(); ++i)
+		UT_ASSERT(queue.try_push(i));
+
+	UT_ASSERT(!queue.try_push(0));
+	UT_ASSERTeq(queue.size(), queue.capacity());
+
+	for (uint64_t i = 0; i < queue.capacity(); ++i) {
+		UT_ASSERT(queue.try_pop(value));
+		UT_ASSERTeq(value, i);
+	}
+
+	UT_ASSERT(!queue.try_pop(value));
+}
+
+/*
+ * concurrent_test -- (internal) run producers and consumers concurrently
+ * and check that every value is received exactly once
+ */
+void
+concurrent_test(queue_type &queue)
+{
+	std::vector<std::atomic<int>> received(num_threads * num_ops);
+	for (auto &r : received)
+		r.store(0);
+
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < num_threads; ++t) {
+		threads.emplace_back([&, t] {
+			for (uint64_t i = 0; i < num_ops; ++i) {
+				uint64_t value =
+					static_cast<uint64_t>(t) * num_ops + i;
+				while (!queue.try_push(value))
+					std::this_thread::yield();
+			}
+		});
+
+		threads.emplace_back([&] {
+			uint64_t value;
+			for (uint64_t i = 0; i < num_ops; ++i) {
+				while (!queue.try_pop(value))
+					std::this_thread::yield();
+				received[value]++;
+			}
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	for (auto &r : received)
+		UT_ASSERTeq(r.load(), 1);
+
+	UT_ASSERT(queue.empty());
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(
+		pop, [&] { r->queue = nvobj::make_persistent<queue_type>(); });
+
+	single_thread_test(*r->queue);
+	concurrent_test(*r->queue);
+
+	/* leave a wrapped around sequence of values in the queue */
+	for (uint64_t i = 0; i < 40; ++i)
+		UT_ASSERT(r->queue->try_push(i));
+
+	uint64_t value;
+	for (uint64_t i = 0; i < 10; ++i)
+		UT_ASSERT(r->queue->try_pop(value));
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	r = pop.get_root();
+	r->queue->recover();
+
+	UT_ASSERTeq(r->queue->size(), 30);
+	for (uint64_t i = 10; i < 40; ++i) {
+		UT_ASSERT(r->queue->try_pop(value));
+		UT_ASSERTeq(value, i);
+	}
+
+	single_thread_test(*r->queue);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<queue_type>(r->queue);
+		r->queue = nullptr;
+	});
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/segment_vector.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#define LAYOUT "segment_vector"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+struct element {
+	element() : val(0)
+	{
+	}
+
+	element(int v) : val(v)
+	{
+	}
+
+	nvobj::p<int> val;
+};
+
+using vector_int = pmemobj_exp::segment_vector<int>;
+using vector_elem = pmemobj_exp::segment_vector<element>;
+
+struct root {
+	nvobj::persistent_ptr<vector_int> v_int;
+	nvobj::persistent_ptr<vector_elem> v_elem;
+};
+
+namespace
+{
+
+const int num_elements = 5000;
+
+/*
+ * stable_test -- (internal) test that growing never moves elements
+ */
+void
+stable_test(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(
+		pop, [&] { r->v_int = nvobj::make_persistent<vector_int>(); });
+
+	vector_int &v = *r->v_int;
+	UT_ASSERT(v.empty());
+	UT_ASSERTeq(v.capacity(), 0);
+	UT_ASSERT(v.begin() == v.end());
+
+	std::vector<const int *> addresses;
+	for (int i = 0; i < num_elements; ++i) {
+		v.push_back(i);
+		addresses.push_back(&v.back());
+	}
+
+	UT_ASSERTeq(v.size(), static_cast<size_t>(num_elements));
+	UT_ASSERT(v.capacity() >= v.size());
+	UT_ASSERT(v.capacity() < 2 * v.size() + vector_int::first_segment_size);
+
+	const vector_int &cv = v;
+	for (int i = 0; i < num_elements; ++i) {
+		UT_ASSERTeq(cv[static_cast<size_t>(i)], i);
+		UT_ASSERT(&cv[static_cast<size_t>(i)] ==
+			  addresses[static_cast<size_t>(i)]);
+	}
+
+	int expected = 0;
+	for (auto it = cv.cbegin(); it != cv.cend(); ++it)
+		UT_ASSERTeq(*it, expected++);
+	UT_ASSERTeq(cv.cend() - cv.cbegin(), num_elements);
+	UT_ASSERTeq(*(cv.cbegin() + 100), 100);
+	UT_ASSERTeq(*cv.crbegin(), num_elements - 1);
+
+	try {
+		v.at(static_cast<size_t>(num_elements));
+		UT_ASSERT(0);
+	} catch (std::out_of_range &) {
+	}
+
+	/* write access through iterators */
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (auto &e : v)
+			e *= 2;
+	});
+	UT_ASSERTeq(cv[10], 20);
+
+	std::sort(v.begin(), v.end(), [](int a, int b) { return a > b; });
+	UT_ASSERTeq(cv.front(), (num_elements - 1) * 2);
+	std::sort(v.begin(), v.end());
+
+	/* an aborted append which allocates a segment is rolled back */
+	v.resize(v.capacity());
+	size_t size = v.size();
+	size_t segments = v.segment_count();
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			v.push_back(-1);
+			UT_ASSERTeq(v.segment_count(), segments + 1);
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+	UT_ASSERTeq(v.size(), size);
+	UT_ASSERTeq(v.segment_count(), segments);
+	UT_ASSERTeq(cv[size - 1], 0);
+
+	v.resize(100);
+	UT_ASSERTeq(v.size(), 100);
+	UT_ASSERTeq(v.segment_count(), segments);
+	v.shrink_to_fit();
+	UT_ASSERT(v.capacity() >= 100);
+	UT_ASSERT(v.capacity() < 200 + vector_int::first_segment_size);
+	UT_ASSERT(&cv[99] == addresses[99]);
+
+	v.pop_back();
+	UT_ASSERTeq(v.size(), 99);
+	UT_ASSERTeq(cv.back(), 98 * 2);
+
+	/* removed elements overwritten by a later growth are rolled back */
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			v.pop_back();
+			v.push_back(42);
+			v.resize(10);
+			v.resize(99);
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+	UT_ASSERTeq(v.size(), 99);
+	for (size_t i = 0; i < v.size(); ++i)
+		UT_ASSERTeq(cv[i], static_cast<int>(i) * 2);
+
+	v.clear();
+	UT_ASSERT(v.empty());
+	v.shrink_to_fit();
+	UT_ASSERTeq(v.capacity(), 0);
+}
+
+/*
+ * elem_test -- (internal) test a vector of non-trivial elements
+ */
+void
+elem_test(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->v_elem = nvobj::make_persistent<vector_elem>(
+			static_cast<size_t>(40), element(7));
+	});
+
+	vector_elem &v = *r->v_elem;
+	UT_ASSERTeq(v.size(), 40);
+	UT_ASSERTeq(v.segment_count(), 2);
+
+	v.resize(100);
+	v.emplace_back(5);
+	UT_ASSERTeq(v.size(), 101);
+	UT_ASSERTeq(v[39].val, 7);
+	UT_ASSERTeq(v[40].val, 0);
+	UT_ASSERTeq(v[100].val, 5);
+
+	v.resize(200, element(3));
+	UT_ASSERTeq(v.at(199).val, 3);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	stable_test(pop);
+	elem_test(pop);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	auto r = pop.get_root();
+
+	UT_ASSERTeq(r->v_elem->size(), 200);
+	UT_ASSERTeq((*r->v_elem)[100].val, 5);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<vector_int>(r->v_int);
+		nvobj::delete_persistent<vector_elem>(r->v_elem);
+		r->v_int = nullptr;
+		r->v_elem = nullptr;
+	});
+
+	pop.close();
+
+	return 0;
+}
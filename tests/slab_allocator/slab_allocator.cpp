@@ -0,0 +1,278 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * slab_allocator.cpp -- slab_allocator tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/allocator.hpp>
+#include <libpmemobj++/experimental/slab_allocator.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <set>
+#include <stdexcept>
+
+#define LAYOUT "slab_allocator"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+const int num_objs = 200;
+const std::size_t slots = 64;
+
+struct node {
+	node(int v) : value(v)
+	{
+		for (auto &c : payload)
+			c = static_cast<char>(v);
+	}
+
+	nvobj::p<int> value;
+	nvobj::p<char> payload[68];
+};
+
+using policy = pmemobj_exp::slab_allocator<node, slots>;
+using node_allocator = nvobj::allocator<node, policy>;
+
+struct root {
+	pmemobj_exp::slab<node, slots> nodes;
+	nvobj::persistent_ptr<node> ptrs[num_objs];
+};
+
+namespace
+{
+
+/*
+ * test_alloc -- (internal) objects are allocated from chunks of the slab
+ * and freed slots are reused
+ */
+void
+test_alloc(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	node_allocator alloc{policy(r->nodes)};
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int i = 0; i < num_objs; ++i) {
+			r->ptrs[i] = alloc.allocate(1);
+			alloc.construct(r->ptrs[i], i);
+		}
+	});
+
+	UT_ASSERTeq(r->nodes.size(), num_objs);
+	UT_ASSERTeq(r->nodes.capacity(), 4 * slots);
+
+	std::set<node *> addresses;
+	for (int i = 0; i < num_objs; ++i) {
+		UT_ASSERTeq(r->ptrs[i]->value, i);
+		UT_ASSERT(pmemobj_pool_by_ptr(r->ptrs[i].get()) ==
+			  pop.get_handle());
+		addresses.insert(r->ptrs[i].get());
+	}
+	UT_ASSERTeq(addresses.size(), num_objs);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int i = 0; i < num_objs; i += 2) {
+			alloc.destroy(r->ptrs[i]);
+			alloc.deallocate(r->ptrs[i]);
+			r->ptrs[i] = nullptr;
+		}
+	});
+
+	UT_ASSERTeq(r->nodes.size(), num_objs / 2);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int i = 0; i < num_objs; i += 2) {
+			r->ptrs[i] = alloc.allocate(1);
+			alloc.construct(r->ptrs[i], -i);
+		}
+	});
+
+	UT_ASSERTeq(r->nodes.size(), num_objs);
+	UT_ASSERTeq(r->nodes.capacity(), 4 * slots);
+	for (int i = 0; i < num_objs; ++i)
+		UT_ASSERTeq(r->ptrs[i]->value, i % 2 ? i : -i);
+}
+
+/*
+ * test_abort -- (internal) allocations and frees of an aborted
+ * transaction are rolled back, including slots reused after a free
+ */
+void
+test_abort(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	node_allocator alloc{policy(r->nodes)};
+
+	auto size = r->nodes.size();
+	auto capacity = r->nodes.capacity();
+	auto first = r->ptrs[1];
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			alloc.destroy(r->ptrs[1]);
+			alloc.deallocate(r->ptrs[1]);
+
+			for (std::size_t i = 0; i < 2 * slots; ++i) {
+				auto ptr = alloc.allocate(1);
+				alloc.construct(ptr, 1000);
+			}
+
+			throw std::runtime_error("error");
+		});
+		UT_ASSERT(0);
+	} catch (std::runtime_error &) {
+	}
+
+	UT_ASSERTeq(r->nodes.size(), size);
+	UT_ASSERTeq(r->nodes.capacity(), capacity);
+	UT_ASSERT(r->ptrs[1] == first);
+	UT_ASSERTeq(r->ptrs[1]->value, 1);
+	UT_ASSERTeq(r->ptrs[1]->payload[67], 1);
+
+	try {
+		alloc.allocate(1);
+		UT_ASSERT(0);
+	} catch (pmem::transaction_scope_error &) {
+	}
+}
+
+/*
+ * test_policy -- (internal) policies not bound to a slab and arrays use
+ * libpmemobj allocations
+ */
+void
+test_policy(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	node_allocator bound{policy(r->nodes)};
+	node_allocator bound2{policy(r->nodes)};
+	node_allocator unbound;
+
+	UT_ASSERT(bound == bound2);
+	UT_ASSERT(bound != unbound);
+
+	auto size = r->nodes.size();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		auto one = unbound.allocate(1);
+		auto many = bound.allocate(3);
+		UT_ASSERTeq(r->nodes.size(), size);
+		UT_ASSERTeq(pmemobj_type_num(one.raw()),
+			    pmem::detail::type_num<node>());
+		UT_ASSERTeq(pmemobj_type_num(many.raw()),
+			    pmem::detail::type_num<node>());
+		unbound.deallocate(one);
+		bound.deallocate(many, 3);
+	});
+}
+
+/*
+ * test_reopen -- (internal) objects constructed in reused slots were
+ * made durable by their transactions
+ */
+void
+test_reopen(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	UT_ASSERTeq(r->nodes.size(), num_objs);
+	for (int i = 0; i < num_objs; ++i) {
+		int v = i % 2 ? i : -i;
+		UT_ASSERTeq(r->ptrs[i]->value, v);
+		UT_ASSERTeq(r->ptrs[i]->payload[0], static_cast<char>(v));
+		UT_ASSERTeq(r->ptrs[i]->payload[67], static_cast<char>(v));
+	}
+}
+
+/*
+ * test_free_all -- (internal) free all objects
+ */
+void
+test_free_all(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	node_allocator alloc{policy(r->nodes)};
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int i = 0; i < num_objs; ++i) {
+			alloc.destroy(r->ptrs[i]);
+			alloc.deallocate(r->ptrs[i]);
+			r->ptrs[i] = nullptr;
+		}
+	});
+
+	UT_ASSERTeq(r->nodes.size(), 0);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_alloc(pop);
+	test_abort(pop);
+	test_policy(pop);
+
+	pop.close();
+
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	test_reopen(pop);
+	test_free_all(pop);
+
+	pop.close();
+
+	return 0;
+}
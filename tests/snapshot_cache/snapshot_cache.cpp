@@ -0,0 +1,296 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * snapshot_cache.cpp -- snapshot_cache tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/allocator.hpp>
+#include <libpmemobj++/detail/common.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#define LAYOUT "snapshot_cache"
+
+namespace nvobj = pmem::obj;
+
+using pmem::detail::snapshot_cache;
+
+struct root {
+	nvobj::p<int> a;
+	nvobj::p<int> b;
+	nvobj::persistent_ptr<nvobj::p<int>[]> arr;
+};
+
+namespace
+{
+
+const std::ptrdiff_t arr_size = 64;
+
+/*
+ * check -- (internal) check the values of the root object
+ */
+void
+check(nvobj::persistent_ptr<root> r, int a, int b, int arr)
+{
+	UT_ASSERTeq(r->a, a);
+	UT_ASSERTeq(r->b, b);
+	for (std::ptrdiff_t i = 0; i < arr_size; ++i)
+		UT_ASSERTeq(r->arr[i], arr + static_cast<int>(i));
+}
+
+/*
+ * set -- (internal) write all fields many times
+ */
+void
+set(nvobj::persistent_ptr<root> r, int a, int b, int arr)
+{
+	for (int n = 0; n < 10; ++n) {
+		r->a = a - n;
+		r->b = b - n;
+		for (std::ptrdiff_t i = arr_size - 1; i >= 0; --i)
+			r->arr[i] = arr + static_cast<int>(i) - n;
+	}
+
+	r->a = a;
+	r->b = b;
+	for (std::ptrdiff_t i = 0; i < arr_size; ++i)
+		r->arr[i] = arr + static_cast<int>(i);
+}
+
+/*
+ * test_ranges -- (internal) adjacent and overlapping ranges are merged
+ */
+void
+test_ranges(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	auto &cache = snapshot_cache::get();
+	auto *arr = &r->arr[0];
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		UT_ASSERT(!cache.contains(arr, sizeof(int)));
+
+		pmem::detail::conditional_add_to_tx(arr + 2, 2);
+		pmem::detail::conditional_add_to_tx(arr + 6, 2);
+		UT_ASSERT(cache.contains(arr + 2, 2 * sizeof(int)));
+		UT_ASSERT(cache.contains(arr + 7, sizeof(int)));
+		UT_ASSERT(!cache.contains(arr + 2, 6 * sizeof(int)));
+		UT_ASSERT(!cache.contains(arr + 4, sizeof(int)));
+
+		pmem::detail::conditional_add_to_tx(arr + 4, 2);
+		UT_ASSERT(cache.contains(arr + 2, 6 * sizeof(int)));
+		UT_ASSERT(!cache.contains(arr + 1, 2 * sizeof(int)));
+
+		pmem::detail::conditional_add_to_tx(arr, 10);
+		UT_ASSERT(cache.contains(arr, 10 * sizeof(int)));
+		UT_ASSERT(!cache.contains(arr, 11 * sizeof(int)));
+	});
+
+	/* the cache is dropped with the transaction */
+	UT_ASSERT(!cache.contains(arr, sizeof(int)));
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		UT_ASSERT(!cache.contains(arr, sizeof(int)));
+	});
+}
+
+/*
+ * test_abort -- (internal) aborts roll back all writes, also when the
+ * same objects were written in a previous transaction
+ */
+void
+test_abort(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(pop, [&] { set(r, 1, 2, 3); });
+	check(r, 1, 2, 3);
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			set(r, 10, 20, 30);
+			nvobj::transaction::exec_tx(
+				pop, [&] { set(r, 100, 200, 300); });
+			set(r, 11, 21, 31);
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+	check(r, 1, 2, 3);
+
+	{
+		nvobj::transaction::manual tx(pop);
+		set(r, 4, 5, 6);
+		nvobj::transaction::commit();
+	}
+	check(r, 4, 5, 6);
+
+	{
+		nvobj::transaction::manual tx(pop);
+		set(r, 7, 8, 9);
+	}
+	check(r, 4, 5, 6);
+
+	/* transactions started with the C API are not cached */
+	UT_ASSERTeq(pmemobj_tx_begin(pop.get_handle(), nullptr, TX_PARAM_NONE),
+		    0);
+	set(r, 40, 50, 60);
+	UT_ASSERT(!snapshot_cache::get().contains(&r->a, sizeof(int)));
+	pmemobj_tx_abort(EINVAL);
+	(void)pmemobj_tx_end();
+	check(r, 4, 5, 6);
+
+	UT_ASSERTeq(pmemobj_tx_begin(pop.get_handle(), nullptr, TX_PARAM_NONE),
+		    0);
+	try {
+		nvobj::transaction::exec_tx(pop, [&] { set(r, 41, 51, 61); });
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+	set(r, 42, 52, 62);
+	pmemobj_tx_abort(EINVAL);
+	(void)pmemobj_tx_end();
+	check(r, 4, 5, 6);
+}
+
+/*
+ * test_allocated -- (internal) memory allocated in the transaction is not
+ * snapshotted, until it is freed
+ */
+void
+test_allocated(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	auto &cache = snapshot_cache::get();
+
+	nvobj::persistent_ptr<root> obj;
+	nvobj::persistent_ptr<nvobj::p<int>[]> arr;
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		obj = nvobj::make_persistent<root>();
+		arr = nvobj::make_persistent<nvobj::p<int>[]>(
+			static_cast<std::size_t>(arr_size));
+		UT_ASSERT(cache.contains(obj.get(), sizeof(root)));
+		UT_ASSERT(cache.contains(&arr[0], sizeof(int) * arr_size));
+
+		obj->a = 1;
+		obj->b = 2;
+		obj->arr = arr;
+		for (std::ptrdiff_t i = 0; i < arr_size; ++i)
+			arr[i] = 3 + static_cast<int>(i);
+
+		nvobj::allocator<int> alloc;
+		auto ints = alloc.allocate(10);
+		UT_ASSERT(cache.contains(ints.get(), sizeof(int) * 10));
+		alloc.deallocate(ints, 10);
+		UT_ASSERT(!cache.contains(ints.get(), sizeof(int)));
+
+		r->a = 7;
+		nvobj::delete_persistent<nvobj::p<int>[]>(
+			arr, static_cast<std::size_t>(arr_size));
+		UT_ASSERT(!cache.contains(&arr[0], sizeof(int)));
+
+		/* other snapshotted ranges are kept */
+		UT_ASSERT(cache.contains(&r->a, sizeof(int)));
+
+		arr = nvobj::make_persistent<nvobj::p<int>[]>(
+			static_cast<std::size_t>(arr_size));
+		obj->arr = arr;
+		for (std::ptrdiff_t i = 0; i < arr_size; ++i)
+			arr[i] = 3 + static_cast<int>(i);
+
+		r->a = 4;
+	});
+
+	check(obj, 1, 2, 3);
+	UT_ASSERTeq(r->a, 4);
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			auto tmp = nvobj::make_persistent<root>();
+			tmp->a = 5;
+			obj->a = 6;
+			nvobj::delete_persistent<root>(tmp);
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+	check(obj, 1, 2, 3);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::delete_persistent<nvobj::p<int>[]>(
+			obj->arr, static_cast<std::size_t>(arr_size));
+		nvobj::delete_persistent<root>(obj);
+	});
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	auto r = pop.get_root();
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->arr = nvobj::make_persistent<nvobj::p<int>[]>(
+			static_cast<std::size_t>(arr_size));
+	});
+
+	test_ranges(pop);
+	test_abort(pop);
+	test_allocated(pop);
+
+	pop.close();
+
+	return 0;
+}
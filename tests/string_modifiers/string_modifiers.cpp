@@ -0,0 +1,297 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/string.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <string>
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+using S = pmemobj_exp::string;
+
+struct root {
+	nvobj::persistent_ptr<S> s;
+	nvobj::persistent_ptr<S> other;
+};
+
+/*
+ * test_ctor -- (internal) test constructors of short and long strings
+ */
+static void
+test_ctor(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	try {
+		S s;
+		UT_ASSERT(0);
+	} catch (pmem::pool_error &) {
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	try {
+		std::string long_str(100, 'x');
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			r->s = nvobj::make_persistent<S>("abc");
+			r->other = nvobj::make_persistent<S>(long_str);
+		});
+
+		UT_ASSERT(*r->s == "abc");
+		UT_ASSERTeq(r->s->capacity(), S::sso_capacity);
+		UT_ASSERT(*r->other == long_str);
+		UT_ASSERTeq(r->other->capacity(), 100);
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			auto moved = nvobj::make_persistent<S>(
+				std::move(*r->other));
+
+			UT_ASSERT(r->other->empty());
+			UT_ASSERT(*moved == long_str);
+
+			nvobj::delete_persistent<S>(r->other);
+			r->other = moved;
+		});
+
+		*r->s = *r->other;
+		UT_ASSERT(*r->s == long_str);
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<S>(r->s);
+			nvobj::delete_persistent<S>(r->other);
+			r->s = nullptr;
+			r->other = nullptr;
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+}
+
+/*
+ * test_modifiers -- (internal) test append, erase and transitions between
+ * the internal buffer and allocated storage
+ */
+static void
+test_modifiers(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	try {
+		nvobj::transaction::exec_tx(
+			pop, [&] { r->s = nvobj::make_persistent<S>(); });
+
+		S &s = *r->s;
+		std::string expected;
+
+		for (int i = 0; i < 100; ++i) {
+			s.push_back(static_cast<char>('a' + i % 26));
+			expected.push_back(static_cast<char>('a' + i % 26));
+
+			UT_ASSERT(s == expected);
+			UT_ASSERT(s.c_str()[s.size()] == '\0');
+		}
+
+		UT_ASSERT(s.capacity() > S::sso_capacity);
+
+		/* appending itself, triggering reallocation */
+		s.shrink_to_fit();
+		UT_ASSERTeq(s.capacity(), 100);
+		s.append(s.c_str() + 10, 20);
+		expected.append(expected.c_str() + 10, 20);
+		UT_ASSERT(s == expected);
+
+		s.erase(5, 100);
+		expected.erase(5, 100);
+		UT_ASSERT(s == expected);
+
+		s += "xyz";
+		expected += "xyz";
+		UT_ASSERT(s == expected);
+
+		s.shrink_to_fit();
+		UT_ASSERTeq(s.capacity(), S::sso_capacity);
+		UT_ASSERT(s == expected);
+
+		s.assign(s.c_str() + 1, 4);
+		expected.assign(expected.c_str() + 1, 4);
+		UT_ASSERT(s == expected);
+
+		s.resize(40, 'q');
+		expected.resize(40, 'q');
+		UT_ASSERT(s == expected);
+
+		s.resize(2);
+		expected.resize(2);
+		UT_ASSERT(s == expected);
+
+		s[1] = 'z';
+		UT_ASSERT(s.back() == 'z');
+
+		try {
+			s.at(2);
+			UT_ASSERT(0);
+		} catch (std::out_of_range &) {
+		}
+
+		s.clear();
+		UT_ASSERT(s.empty());
+		UT_ASSERT(s == "");
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<S>(r->s);
+			r->s = nullptr;
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+}
+
+/*
+ * test_abort -- (internal) test that aborted modifications are rolled back
+ */
+static void
+test_abort(nvobj::pool<struct root> &pop, const char *init)
+{
+	auto r = pop.get_root();
+
+	try {
+		nvobj::transaction::exec_tx(
+			pop, [&] { r->s = nvobj::make_persistent<S>(init); });
+
+		S &s = *r->s;
+		auto capacity = s.capacity();
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				s.append("0123456789");
+				s.erase(0, 1);
+				s[0] = '!';
+				s.append(100, 'x');
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		UT_ASSERT(s == init);
+		UT_ASSERTeq(s.capacity(), capacity);
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				s.push_back('a');
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		UT_ASSERT(s == init);
+		UT_ASSERT(s.c_str()[s.size()] == '\0');
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				s = "short";
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		UT_ASSERT(s == init);
+
+		/* shorten and append over the dropped characters */
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				s.erase(2);
+				s.append("XY");
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		UT_ASSERT(s == init);
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				s = "a";
+				s.append("XYZ");
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		UT_ASSERT(s == init);
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				r->other = nvobj::make_persistent<S>(
+					std::move(s));
+				s.append("XYZ");
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		UT_ASSERT(s == init);
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<S>(r->s);
+			r->s = nullptr;
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	auto path = argv[1];
+	auto pop = nvobj::pool<root>::create(
+		path, "StringTest", PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+
+	test_ctor(pop);
+	test_modifiers(pop);
+	test_abort(pop, "init");
+	test_abort(pop, "a string which does not fit in the internal buffer");
+
+	pop.close();
+
+	return 0;
+}
@@ -43,6 +43,9 @@
 #include "libpmemobj++/pool.hpp"
 #include "libpmemobj++/shared_mutex.hpp"
 
+#include <string>
+#include <vector>
+
 namespace
 {
 int counter = 0;
@@ -86,6 +89,7 @@ struct root {
 	nvobj::persistent_ptr<foo> pfoo;
 	nvobj::persistent_ptr<nvobj::p<int>> parr;
 	nvobj::mutex mtx;
+	nvobj::p<int> fields[4];
 };
 
 void
@@ -721,6 +725,150 @@ test_tx_automatic_destructor_throw(nvobj::pool<root> &pop)
 	UT_ASSERT(rootp->pfoo == nullptr);
 	UT_ASSERT(rootp->parr == nullptr);
 }
+
+/*
+ * test_tx_callbacks -- test callbacks run at the end of the outermost
+ * transaction
+ */
+void
+test_tx_callbacks(nvobj::pool<root> &pop)
+{
+	using stage = nvobj::transaction::stage_type;
+
+	std::vector<std::string> log;
+	auto record = [&](const char *s) {
+		return [&log, s] { log.push_back(s); };
+	};
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::transaction::register_callback(stage::finally,
+						      record("finally"));
+		nvobj::transaction::register_callback(stage::oncommit,
+						      record("commit1"));
+		nvobj::transaction::register_callback(stage::onabort,
+						      record("abort"));
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::transaction::register_callback(
+				stage::oncommit, record("commit2"));
+		});
+
+		/* nothing runs before the outermost transaction ends */
+		UT_ASSERT(log.empty());
+
+		for (int i = 0; i < 10; ++i)
+			nvobj::transaction::register_callback(
+				stage::oncommit, record("commit3"));
+	});
+
+	UT_ASSERTeq(log.size(), 13);
+	UT_ASSERT(log[0] == "commit1");
+	UT_ASSERT(log[1] == "commit2");
+	UT_ASSERT(log[2] == "commit3" && log[11] == "commit3");
+	UT_ASSERT(log[12] == "finally");
+	log.clear();
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::transaction::register_callback(
+				stage::oncommit, record("commit"));
+			nvobj::transaction::register_callback(stage::onabort,
+							      record("abort"));
+			nvobj::transaction::register_callback(
+				stage::finally, record("finally"));
+			throw std::runtime_error("error");
+		});
+		UT_ASSERT(0);
+	} catch (std::runtime_error &) {
+	}
+
+	UT_ASSERTeq(log.size(), 2);
+	UT_ASSERT(log[0] == "abort");
+	UT_ASSERT(log[1] == "finally");
+	log.clear();
+
+	{
+		nvobj::transaction::manual tx(pop);
+		nvobj::transaction::register_callback(stage::oncommit, [&] {
+			/* callbacks can start transactions */
+			nvobj::transaction::exec_tx(pop, [&] {
+				nvobj::transaction::register_callback(
+					stage::oncommit, record("inner"));
+			});
+			log.push_back("outer");
+		});
+		nvobj::transaction::commit();
+	}
+
+	UT_ASSERTeq(log.size(), 2);
+	UT_ASSERT(log[0] == "inner");
+	UT_ASSERT(log[1] == "outer");
+	log.clear();
+
+	/*
+	 * captures up to max_callback_size bytes, more than std::function
+	 * keeps without allocating, are stored inline
+	 */
+	std::string tag("large capture ");
+	const char *suffix = "kept";
+	auto large = [&log, tag, suffix] { log.push_back(tag + suffix); };
+	static_assert(sizeof(large) <=
+			      nvobj::transaction::max_callback_size,
+		      "callback fits");
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int i = 0; i < 6; ++i)
+			nvobj::transaction::register_callback(stage::oncommit,
+							      large);
+	});
+
+	UT_ASSERTeq(log.size(), 6);
+	UT_ASSERT(log[0] == "large capture kept");
+	UT_ASSERT(log[5] == "large capture kept");
+
+	try {
+		nvobj::transaction::register_callback(stage::finally, [] {});
+		UT_ASSERT(0);
+	} catch (pmem::transaction_scope_error &) {
+	}
+}
+
+/*
+ * test_tx_snapshot -- test fields snapshotted at once are restored on abort
+ */
+void
+test_tx_snapshot(nvobj::pool<root> &pop)
+{
+	auto rootp = pop.get_root();
+	auto &f = rootp->fields;
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		for (int i = 0; i < 4; ++i)
+			f[i] = i;
+	});
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::transaction::snapshot(f[3], f[0], f[1], f[0]);
+
+			for (int i = 0; i < 4; ++i)
+				f[i] = 10 + i;
+
+			nvobj::transaction::snapshot(f[2]);
+			f[2] = 20;
+
+			throw std::runtime_error("error");
+		});
+		UT_ASSERT(0);
+	} catch (std::runtime_error &) {
+	}
+
+	for (int i = 0; i < 4; ++i)
+		UT_ASSERTeq(f[i], i);
+
+	/* outside of a transaction it does nothing */
+	nvobj::transaction::snapshot(f[0], f[1]);
+}
 }
 
 int
@@ -753,5 +901,7 @@ main(int argc, char *argv[])
 	test_tx_throw_no_abort_scope<nvobj::transaction::automatic>(pop);
 	test_tx_no_throw_abort_scope<nvobj::transaction::automatic>(pop);
 	test_tx_automatic_destructor_throw(pop);
+	test_tx_callbacks(pop);
+	test_tx_snapshot(pop);
 	pop.close();
 }
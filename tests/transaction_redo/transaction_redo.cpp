@@ -0,0 +1,247 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * transaction_redo.cpp -- transaction::redo tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <cstdint>
+
+#define LAYOUT "transaction_redo"
+
+namespace nvobj = pmem::obj;
+
+struct node {
+	nvobj::p<int> value;
+	nvobj::persistent_ptr<node> next;
+};
+
+struct packed {
+	nvobj::p<char> c[16];
+	nvobj::p<uint16_t> s[8];
+};
+
+struct root {
+	nvobj::p<int> a;
+	nvobj::p<uint64_t> b;
+	nvobj::persistent_ptr<node> head;
+	nvobj::persistent_ptr<packed> bytes;
+};
+
+namespace
+{
+
+/*
+ * test_commit -- (internal) writes are visible through get() before
+ * commit and in the pool only after it
+ */
+void
+test_commit(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::persistent_ptr<node> n1, n2;
+	nvobj::transaction::exec_tx(pop, [&] {
+		n1 = nvobj::make_persistent<node>();
+		n2 = nvobj::make_persistent<node>();
+	});
+
+	nvobj::transaction::redo tx(pop);
+	UT_ASSERT(tx.empty());
+
+	tx.set(r->a, 1);
+	tx.set(r->b, uint64_t(2));
+	tx.set(r->head, n1);
+	tx.set(n1->value, 10);
+	tx.set(n1->next, n2);
+	tx.set(n2->value, 20);
+	tx.set(r->a, 3);
+
+	UT_ASSERT(!tx.empty());
+	UT_ASSERTeq(tx.get(r->a), 3);
+	UT_ASSERTeq(tx.get(r->b), 2);
+	UT_ASSERT(tx.get(r->head) == n1);
+	UT_ASSERT(tx.get(n1->next) == n2);
+
+	UT_ASSERTeq(r->a, 0);
+	UT_ASSERTeq(r->b, 0);
+	UT_ASSERT(r->head == nullptr);
+	UT_ASSERTeq(n1->value, 0);
+
+	tx.commit();
+	UT_ASSERT(tx.empty());
+
+	UT_ASSERTeq(r->a, 3);
+	UT_ASSERTeq(r->b, 2);
+	UT_ASSERT(r->head == n1);
+	UT_ASSERTeq(r->head->value, 10);
+	UT_ASSERT(r->head->next == n2);
+	UT_ASSERTeq(r->head->next->value, 20);
+	UT_ASSERT(n2->next == nullptr);
+
+	/* the transaction can be reused */
+	tx.set(r->a, 4);
+	tx.commit();
+	UT_ASSERTeq(r->a, 4);
+}
+
+/*
+ * test_discard -- (internal) writes are dropped without commit
+ */
+void
+test_discard(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	{
+		nvobj::transaction::redo tx(pop);
+		tx.set(r->a, 100);
+		tx.set(r->head, nvobj::persistent_ptr<node>());
+		UT_ASSERT(tx.get(r->head) == nullptr);
+	}
+
+	UT_ASSERTeq(r->a, 4);
+	UT_ASSERT(r->head != nullptr);
+}
+
+/*
+ * test_partial_words -- (internal) writes smaller than a word keep the
+ * neighbouring bytes
+ */
+void
+test_partial_words(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->bytes = nvobj::make_persistent<packed>();
+		for (int i = 0; i < 16; ++i)
+			r->bytes->c[i] = static_cast<char>('a' + i);
+	});
+
+	nvobj::transaction::redo tx(pop);
+	for (int i = 1; i < 16; i += 3)
+		tx.set(r->bytes->c[i], static_cast<char>('A' + i));
+	for (int i = 0; i < 8; ++i)
+		tx.set(r->bytes->s[i], static_cast<uint16_t>(1000 + i));
+
+	for (int i = 0; i < 16; ++i)
+		UT_ASSERTeq(tx.get(r->bytes->c[i]),
+			    static_cast<char>((i % 3 == 1 ? 'A' : 'a') + i));
+	tx.commit();
+
+	for (int i = 0; i < 16; ++i)
+		UT_ASSERTeq(r->bytes->c[i],
+			    static_cast<char>((i % 3 == 1 ? 'A' : 'a') + i));
+	for (int i = 0; i < 8; ++i)
+		UT_ASSERTeq(r->bytes->s[i], 1000 + i);
+}
+
+/*
+ * test_in_tx -- (internal) a redo transaction committed in an undo log
+ * based one is rolled back with it
+ */
+void
+test_in_tx(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::transaction::redo tx(pop);
+			tx.set(r->a, 5);
+			tx.commit();
+			r->b = 6;
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+
+	UT_ASSERTeq(r->a, 4);
+	UT_ASSERTeq(r->b, 2);
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::transaction::redo tx(pop);
+		tx.set(r->a, 5);
+		tx.commit();
+		r->b = 6;
+	});
+
+	UT_ASSERTeq(r->a, 5);
+	UT_ASSERTeq(r->b, 6);
+
+	int x = 0;
+	nvobj::p<int> &volatile_field = reinterpret_cast<nvobj::p<int> &>(x);
+	try {
+		nvobj::transaction::redo tx(pop);
+		tx.set(volatile_field, 1);
+		UT_ASSERT(0);
+	} catch (pmem::pool_error &) {
+	}
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_commit(pop);
+	test_discard(pop);
+	test_partial_words(pop);
+	test_in_tx(pop);
+
+	pop.close();
+
+	return 0;
+}
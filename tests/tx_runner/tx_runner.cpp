@@ -0,0 +1,282 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tx_runner.cpp -- tx_runner tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/tx_runner.hpp>
+#include <libpmemobj++/mutex.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define LAYOUT "tx_runner"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+const int num_threads = 8;
+const int ops_per_thread = 200;
+
+struct root {
+	nvobj::mutex mtx1;
+	nvobj::mutex mtx2;
+	nvobj::p<int> counter;
+	nvobj::p<int> other;
+};
+
+namespace
+{
+
+pmemobj_exp::tx_backoff
+fast_backoff()
+{
+	pmemobj_exp::tx_backoff b;
+	b.spin_retries = 2;
+	b.yield_retries = 2;
+	b.min_sleep = std::chrono::microseconds(1);
+	b.max_sleep = std::chrono::microseconds(100);
+	b.max_retries = 1000000;
+
+	return b;
+}
+
+/*
+ * test_contention -- (internal) transactions of many threads contending
+ * for the same locks are all committed
+ */
+void
+test_contention(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	pmemobj_exp::tx_runner runner(pop, fast_backoff());
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < ops_per_thread; ++i)
+				runner.exec(
+					[&] {
+						r->counter = r->counter + 1;
+						r->other = r->counter;
+					},
+					r->mtx1, r->mtx2);
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	UT_ASSERTeq(r->counter, num_threads * ops_per_thread);
+	UT_ASSERTeq(r->other, num_threads * ops_per_thread);
+
+	auto s = runner.stats();
+	UT_ASSERTeq(s.commits, uint64_t(num_threads * ops_per_thread));
+	UT_ASSERTeq(s.attempts, s.commits + s.retries);
+	UT_ASSERTeq(s.retries, s.contentions);
+	UT_ASSERTeq(s.aborts, 0u);
+	UT_ASSERTeq(s.retries, s.spins + s.yields + s.sleeps);
+	UT_ASSERTeq(s.exhausted, 0u);
+
+	runner.reset_stats();
+	UT_ASSERTeq(runner.stats().attempts, 0u);
+}
+
+/*
+ * test_backoff -- (internal) a lock held by another thread is retried
+ * with each kind of backoff until the budget is exhausted
+ */
+void
+test_backoff(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	pmemobj_exp::tx_backoff b = fast_backoff();
+	b.max_retries = 6;
+	pmemobj_exp::tx_runner runner(pop, b);
+
+	r->mtx2.lock();
+
+	bool exhausted = false;
+	bool ran = false;
+	std::thread t([&] {
+		try {
+			runner.exec([&] { ran = true; }, r->mtx1, r->mtx2);
+		} catch (pmem::transaction_error &) {
+			exhausted = true;
+		}
+	});
+	t.join();
+
+	r->mtx2.unlock();
+
+	UT_ASSERT(exhausted);
+	UT_ASSERT(!ran);
+
+	/* the first lock was released when the second was taken */
+	UT_ASSERT(r->mtx1.try_lock());
+	r->mtx1.unlock();
+
+	auto s = runner.stats();
+	UT_ASSERTeq(s.attempts, 7u);
+	UT_ASSERTeq(s.contentions, 7u);
+	UT_ASSERTeq(s.retries, 6u);
+	UT_ASSERTeq(s.spins, 2u);
+	UT_ASSERTeq(s.yields, 2u);
+	UT_ASSERTeq(s.sleeps, 2u);
+	UT_ASSERTeq(s.exhausted, 1u);
+	UT_ASSERTeq(s.commits, 0u);
+}
+
+/*
+ * test_errors -- (internal) errors of the transaction, transaction_error
+ * included, are not retried, and the locks are released
+ */
+void
+test_errors(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	pmemobj_exp::tx_runner runner(pop, fast_backoff());
+
+	int counter = r->counter;
+	int calls = 0;
+	try {
+		runner.exec(
+			[&] {
+				++calls;
+				r->counter = r->counter + 1;
+				throw pmem::transaction_error("error");
+			},
+			r->mtx1);
+		UT_ASSERT(0);
+	} catch (pmem::transaction_error &) {
+	}
+
+	UT_ASSERTeq(calls, 1);
+	UT_ASSERTeq(r->counter, counter);
+	UT_ASSERT(r->mtx1.try_lock());
+	r->mtx1.unlock();
+
+	auto s = runner.stats();
+	UT_ASSERTeq(s.aborts, 1u);
+	UT_ASSERTeq(s.retries, 0u);
+	UT_ASSERTeq(s.commits, 0u);
+
+	runner.exec([&] { r->counter = r->counter + 1; }, r->mtx1);
+	UT_ASSERTeq(r->counter, counter + 1);
+	UT_ASSERTeq(runner.stats().commits, 1u);
+
+	calls = 0;
+	try {
+		runner.exec(
+			[&] {
+				++calls;
+				r->counter = r->counter + 1;
+				throw std::runtime_error("error");
+			},
+			r->mtx1);
+		UT_ASSERT(0);
+	} catch (std::runtime_error &) {
+	}
+
+	UT_ASSERTeq(calls, 1);
+	UT_ASSERTeq(r->counter, counter + 1);
+	UT_ASSERT(r->mtx1.try_lock());
+	r->mtx1.unlock();
+	UT_ASSERTeq(runner.stats().aborts, 2u);
+	UT_ASSERTeq(runner.stats().retries, 0u);
+}
+
+/*
+ * test_nested -- (internal) a transaction run inside of another one is
+ * part of the outer transaction
+ */
+void
+test_nested(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	pmemobj_exp::tx_runner runner(pop);
+
+	int counter = r->counter;
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			runner.exec([&] { r->counter = r->counter + 1; },
+				    r->mtx1);
+			UT_ASSERTeq(r->counter, counter + 1);
+			throw std::runtime_error("error");
+		});
+		UT_ASSERT(0);
+	} catch (std::runtime_error &) {
+	}
+
+	UT_ASSERTeq(r->counter, counter);
+	UT_ASSERT(r->mtx1.try_lock());
+	r->mtx1.unlock();
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_contention(pop);
+	test_backoff(pop);
+	test_errors(pop);
+	test_nested(pop);
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tx_stats.cpp -- tx_stats tests
+ */
+
+#define LIBPMEMOBJ_CPP_TX_STATS
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/tx_stats.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <numeric>
+#include <thread>
+
+#define LAYOUT "tx_stats"
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+using stats = pmemobj_exp::tx_stats;
+
+struct root {
+	nvobj::p<uint64_t> a;
+	nvobj::p<uint64_t> b;
+	nvobj::persistent_ptr<nvobj::p<uint64_t>[]> arr;
+};
+
+namespace
+{
+
+uint64_t
+total(const stats::histogram &h)
+{
+	return std::accumulate(h.begin(), h.end(), uint64_t(0));
+}
+
+/*
+ * test_thread -- (internal) counters of the calling thread
+ */
+void
+test_thread(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	UT_ASSERT(stats::enabled());
+	stats::reset_thread();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->a = 1;
+		r->a = 2;
+		r->b = 3;
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			r->arr = nvobj::make_persistent<nvobj::p<uint64_t>[]>(
+				10);
+			r->arr[0] = 1;
+		});
+	});
+
+	auto s = stats::thread();
+	UT_ASSERTeq(s.transactions, 1);
+	UT_ASSERTeq(s.nested, 1);
+	UT_ASSERTeq(s.commits, 1);
+	UT_ASSERTeq(s.aborts, 0);
+	UT_ASSERTeq(s.allocations, 1);
+	UT_ASSERTeq(s.allocation_bytes, 10 * sizeof(uint64_t));
+	UT_ASSERTeq(s.frees, 0);
+
+	/* a, b and the arr pointer; the array is not snapshotted */
+	UT_ASSERTeq(s.snapshots, 3);
+	UT_ASSERTeq(s.snapshot_bytes, 2 * sizeof(uint64_t) + 16);
+	UT_ASSERTeq(s.snapshot_hits, 2);
+	UT_ASSERTeq(total(s.commit_latency), 2);
+	UT_ASSERTeq(total(s.transaction_latency), 1);
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<nvobj::p<uint64_t>[]>(r->arr,
+								       10);
+			nvobj::transaction::abort(EINVAL);
+		});
+		UT_ASSERT(0);
+	} catch (pmem::manual_tx_abort &) {
+	}
+
+	{
+		nvobj::transaction::manual tx(pop);
+		r->a = 4;
+		nvobj::transaction::commit();
+	}
+
+	s = stats::thread();
+	UT_ASSERTeq(s.transactions, 3);
+	UT_ASSERTeq(s.commits, 2);
+	UT_ASSERTeq(s.aborts, 1);
+	UT_ASSERTeq(s.frees, 1);
+	UT_ASSERTeq(total(s.commit_latency), 3);
+	UT_ASSERTeq(total(s.transaction_latency), 3);
+
+	stats::reset_thread();
+	s = stats::thread();
+	UT_ASSERTeq(s.transactions, 0);
+	UT_ASSERTeq(total(s.transaction_latency), 0);
+}
+
+/*
+ * test_snapshot -- (internal) adjacent fields are snapshotted at once
+ */
+void
+test_snapshot(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	stats::reset_thread();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		nvobj::transaction::snapshot(r->b, r->a);
+		r->a = 1;
+		r->b = 2;
+	});
+
+	auto s = stats::thread();
+	UT_ASSERTeq(s.snapshots, 1);
+	UT_ASSERTeq(s.snapshot_bytes, 2 * sizeof(uint64_t));
+	UT_ASSERTeq(s.snapshot_hits, 2);
+}
+
+/*
+ * test_no_flush -- (internal) memory allocated without flushing is
+ * snapshotted when written, as libpmemobj does not flush it on commit
+ */
+void
+test_no_flush(nvobj::pool<struct root> &pop)
+{
+	stats::reset_thread();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		auto arr = nvobj::make_persistent<nvobj::p<uint64_t>[]>(
+			10, nvobj::allocation_flag::no_flush());
+		arr[0] = 1;
+		nvobj::delete_persistent<nvobj::p<uint64_t>[]>(arr, 10);
+	});
+
+	auto s = stats::thread();
+	UT_ASSERTeq(s.snapshots, 1);
+	UT_ASSERTeq(s.snapshot_bytes, sizeof(uint64_t));
+}
+
+/*
+ * test_global -- (internal) statistics of exited threads are kept
+ */
+void
+test_global(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+	auto before = stats::global();
+
+	std::thread t([&] {
+		for (int i = 0; i < 10; ++i)
+			nvobj::transaction::exec_tx(pop, [&] { r->b = 5; });
+
+		UT_ASSERTeq(stats::thread().transactions, 10);
+	});
+	t.join();
+
+	auto after = stats::global();
+	UT_ASSERTeq(after.transactions - before.transactions, 10);
+	UT_ASSERTeq(after.commits - before.commits, 10);
+	UT_ASSERTeq(after.snapshots - before.snapshots, 10);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_thread(pop);
+	test_snapshot(pop);
+	test_no_flush(pop);
+	test_global(pop);
+
+	pop.close();
+
+	return 0;
+}
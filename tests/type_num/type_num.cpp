@@ -0,0 +1,223 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * type_num.cpp -- type_num_traits tests
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/allocator.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/make_persistent_atomic.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <libpmemobj++/type_num.hpp>
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#define LAYOUT "type_num"
+
+namespace nvobj = pmem::obj;
+
+namespace type_num_test
+{
+
+struct foo {
+	nvobj::p<int> a;
+};
+
+template <typename T>
+struct bar {
+	nvobj::p<T> a;
+};
+
+struct renamed {
+	nvobj::p<int> a;
+};
+
+/* types whose names are thousands of characters long */
+template <typename T>
+using level = std::map<std::tuple<std::string, std::vector<T>>,
+		       std::map<std::tuple<T, std::string>, std::vector<T>>>;
+
+template <typename T>
+using nested = level<level<T>>;
+
+} /* namespace type_num_test */
+
+namespace pmem
+{
+namespace obj
+{
+template <>
+struct type_num_traits<type_num_test::renamed> {
+	static constexpr uint64_t value = 42;
+};
+}
+}
+
+struct root {
+	nvobj::persistent_ptr<type_num_test::foo> foo;
+	nvobj::persistent_ptr<type_num_test::bar<int>[]> bars;
+	nvobj::persistent_ptr<type_num_test::renamed> renamed;
+};
+
+namespace
+{
+
+/*
+ * fnv1a -- (internal) reference FNV-1a hash computed at runtime
+ */
+uint64_t
+fnv1a(const char *s)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < strlen(s); ++i)
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+
+	return h;
+}
+
+/*
+ * test_values -- (internal) type numbers are the hashes of the type names
+ * and are known at compile time
+ */
+void
+test_values()
+{
+	static_assert(nvobj::type_num_traits<type_num_test::foo>::value !=
+			      nvobj::type_num_traits<
+				      type_num_test::bar<int>>::value,
+		      "different types have different type numbers");
+	static_assert(nvobj::type_num_traits<type_num_test::renamed>::value ==
+			      42,
+		      "specialization is used");
+
+	UT_ASSERTeq(nvobj::type_num_traits<type_num_test::foo>::value,
+		    fnv1a("type_num_test::foo"));
+	UT_ASSERTeq(nvobj::type_num_traits<type_num_test::bar<int>>::value,
+		    fnv1a("type_num_test::bar<int>"));
+	UT_ASSERTeq(nvobj::type_num_traits<int>::value, fnv1a("int"));
+}
+
+/*
+ * test_long_name -- (internal) type numbers of types with long names are
+ * computed at compile time and depend on the whole name
+ */
+void
+test_long_name()
+{
+	static_assert(nvobj::type_num_traits<
+				      type_num_test::nested<int>>::value !=
+			      nvobj::type_num_traits<
+				      type_num_test::nested<long>>::value,
+		      "the end of a long name is hashed");
+	static_assert(nvobj::type_num_traits<
+				      type_num_test::nested<int>>::value !=
+			      nvobj::type_num_traits<
+				      type_num_test::level<int>>::value,
+		      "different types have different type numbers");
+}
+
+/*
+ * test_alloc -- (internal) every allocation path uses the type numbers
+ */
+void
+test_alloc(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	nvobj::transaction::exec_tx(pop, [&] {
+		r->foo = nvobj::make_persistent<type_num_test::foo>();
+		r->bars = nvobj::make_persistent<type_num_test::bar<int>[]>(3);
+		r->renamed = nvobj::make_persistent<type_num_test::renamed>();
+	});
+
+	UT_ASSERTeq(pmemobj_type_num(r->foo.raw()),
+		    nvobj::type_num_traits<type_num_test::foo>::value);
+	UT_ASSERTeq(pmemobj_type_num(r->bars.raw()),
+		    nvobj::type_num_traits<type_num_test::bar<int>>::value);
+	UT_ASSERTeq(pmemobj_type_num(r->renamed.raw()), 42);
+
+	nvobj::persistent_ptr<type_num_test::foo> atomic;
+	nvobj::make_persistent_atomic<type_num_test::foo>(pop, atomic);
+	UT_ASSERTeq(pmemobj_type_num(atomic.raw()),
+		    nvobj::type_num_traits<type_num_test::foo>::value);
+	nvobj::delete_persistent_atomic<type_num_test::foo>(atomic);
+
+	nvobj::allocator<type_num_test::renamed> alloc;
+	nvobj::transaction::exec_tx(pop, [&] {
+		auto ptr = alloc.allocate(1);
+		UT_ASSERTeq(pmemobj_type_num(ptr.raw()), 42);
+		alloc.deallocate(ptr);
+
+		nvobj::delete_persistent<type_num_test::foo>(r->foo);
+		nvobj::delete_persistent<type_num_test::bar<int>[]>(r->bars,
+								     3);
+		nvobj::delete_persistent<type_num_test::renamed>(r->renamed);
+	});
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<struct root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (pmem::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_values();
+	test_long_name();
+	test_alloc(pop);
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "unittest.hpp"
+
+#include <libpmemobj++/experimental/vector.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+namespace nvobj = pmem::obj;
+namespace pmemobj_exp = pmem::obj::experimental;
+
+struct element {
+	element() : val(0)
+	{
+	}
+
+	element(int v) : val(v)
+	{
+	}
+
+	element(const element &o) : val(o.val)
+	{
+	}
+
+	element &
+	operator=(const element &o)
+	{
+		val = o.val;
+		return *this;
+	}
+
+	bool
+	operator==(const element &o) const
+	{
+		return val == o.val;
+	}
+
+	nvobj::p<int> val;
+};
+
+using vector_int = pmemobj_exp::vector<int>;
+using vector_elem = pmemobj_exp::vector<element>;
+
+struct root {
+	nvobj::persistent_ptr<vector_int> v_int;
+	nvobj::persistent_ptr<vector_elem> v_elem;
+};
+
+template <typename V>
+static void
+check_sequence(const V &v, std::initializer_list<int> expected)
+{
+	UT_ASSERTeq(v.size(), expected.size());
+
+	size_t i = 0;
+	for (auto e : expected)
+		UT_ASSERT(v[i++] == e);
+}
+
+/*
+ * test_ctor -- (internal) test constructors and assignment
+ */
+static void
+test_ctor(nvobj::pool<struct root> &pop)
+{
+	auto r = pop.get_root();
+
+	try {
+		vector_int v;
+		UT_ASSERT(0);
+	} catch (pmem::pool_error &) {
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			r->v_int = nvobj::make_persistent<vector_int>(
+				std::initializer_list<int>{1, 2, 3});
+		});
+
+		check_sequence(*r->v_int, {1, 2, 3});
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<vector_int>(r->v_int);
+			r->v_int = nvobj::make_persistent<vector_int>(3U, 7);
+		});
+
+		check_sequence(*r->v_int, {7, 7, 7});
+
+		*r->v_int = {4, 5};
+		check_sequence(*r->v_int, {4, 5});
+
+		r->v_int->assign(5, 1);
+		check_sequence(*r->v_int, {1, 1, 1, 1, 1});
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<vector_int>(r->v_int);
+			r->v_int = nullptr;
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+}
+
+/*
+ * test_modifiers -- (internal) test push_back, insert, erase and
+ * reallocation
+ */
+template <typename V>
+static void
+test_modifiers(nvobj::pool<struct root> &pop, nvobj::persistent_ptr<V> &ptr)
+{
+	try {
+		nvobj::transaction::exec_tx(
+			pop, [&] { ptr = nvobj::make_persistent<V>(); });
+
+		V &v = *ptr;
+
+		for (int i = 0; i < 10; ++i)
+			v.push_back(i);
+
+		UT_ASSERTeq(v.size(), 10);
+		UT_ASSERT(v.capacity() >= 10);
+		check_sequence(v, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+
+		/* element of itself, triggering reallocation */
+		v.shrink_to_fit();
+		UT_ASSERTeq(v.capacity(), 10);
+		v.push_back(v[0]);
+		check_sequence(v, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0});
+
+		v.erase(v.cbegin() + 1, v.cbegin() + 9);
+		check_sequence(v, {0, 9, 0});
+
+		v.insert(v.cbegin() + 1, 2, v[1]);
+		check_sequence(v, {0, 9, 9, 9, 0});
+
+		v.insert(v.cbegin(), {5, 6});
+		check_sequence(v, {5, 6, 0, 9, 9, 9, 0});
+
+		v.shrink_to_fit();
+		v.insert(v.cend() - 1, 3, 8);
+		check_sequence(v, {5, 6, 0, 9, 9, 9, 8, 8, 8, 0});
+
+		v.emplace(v.cbegin() + 2, 1);
+		v.pop_back();
+		check_sequence(v, {5, 6, 1, 0, 9, 9, 9, 8, 8, 8});
+
+		v.resize(3);
+		v.resize(5, 4);
+		check_sequence(v, {5, 6, 1, 4, 4});
+
+		v.resize(6);
+		check_sequence(v, {5, 6, 1, 4, 4, 0});
+
+		try {
+			v.at(6);
+			UT_ASSERT(0);
+		} catch (std::out_of_range &) {
+		}
+
+		v.clear();
+		UT_ASSERT(v.empty());
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<V>(ptr);
+			ptr = nullptr;
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+}
+
+/*
+ * test_abort -- (internal) test that aborted modifications are
+ * rolled back
+ */
+template <typename V>
+static void
+test_abort(nvobj::pool<struct root> &pop, nvobj::persistent_ptr<V> &ptr)
+{
+	try {
+		nvobj::transaction::exec_tx(
+			pop, [&] { ptr = nvobj::make_persistent<V>(); });
+
+		V &v = *ptr;
+		for (int i = 1; i <= 4; ++i)
+			v.push_back(i);
+		auto capacity = v.capacity();
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				v.push_back(5);
+				v.erase(v.cbegin());
+				v.insert(v.cbegin() + 1, 9);
+				v[0] = 10;
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		UT_ASSERTeq(v.capacity(), capacity);
+		check_sequence(v, {1, 2, 3, 4});
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				v.erase(v.cbegin() + 1);
+				v.push_back(7);
+				v.clear();
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		check_sequence(v, {1, 2, 3, 4});
+
+		/* shrink and grow again over the removed elements */
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				v.pop_back();
+				v.push_back(42);
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		check_sequence(v, {1, 2, 3, 4});
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				v.resize(1);
+				v.resize(4);
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		check_sequence(v, {1, 2, 3, 4});
+
+		try {
+			nvobj::transaction::exec_tx(pop, [&] {
+				auto slice = v.range(1, 2);
+				for (auto &e : slice)
+					e = 0;
+				nvobj::transaction::abort(EINVAL);
+			});
+		} catch (pmem::manual_tx_abort &) {
+		}
+
+		check_sequence(v, {1, 2, 3, 4});
+
+		nvobj::transaction::exec_tx(pop, [&] {
+			nvobj::delete_persistent<V>(ptr);
+			ptr = nullptr;
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	auto path = argv[1];
+	auto pop = nvobj::pool<root>::create(
+		path, "VectorTest", PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+
+	auto r = pop.get_root();
+
+	test_ctor(pop);
+	test_modifiers(pop, r->v_int);
+	test_modifiers(pop, r->v_elem);
+	test_abort(pop, r->v_int);
+	test_abort(pop, r->v_elem);
+
+	pop.close();
+
+	return 0;
+}